@@ -147,7 +147,8 @@ MRI_DIR  = $(BUILD_DIR)/../mri
 
 # Include path which points to external library headers and to subdirectories of this project which contain headers.
 SUBDIRS = $(wildcard $(SRC)/* $(SRC)/*/* $(SRC)/*/*/* $(SRC)/*/*/*/* $(SRC)/*/*/*/*/* $(SRC)/*/*/*/*/*/*)
-PROJINCS = $(sort $(dir $(SUBDIRS)))
+# src/testframework is only built with rake, and its simulator mocks must not shadow the mbed headers
+PROJINCS = $(filter-out $(SRC)/testframework/%,$(sort $(dir $(SUBDIRS))))
 INCDIRS += $(SRC) $(PROJINCS) $(MRI_DIR) $(MBED_DIR) $(MBED_DIR)/$(DEVICE)
 
 # DEFINEs to be used when building C/C++ code
@@ -13,6 +13,14 @@ import threading
 import time
 import signal
 import sys
+import re
+import struct
+import collections
+
+try:
+    input= raw_input  # python 2
+except NameError:
+    pass
  
 errorflg= False
 intrflg= False
@@ -32,6 +40,10 @@ parser.add_argument('device',
         help='Smoothie Serial Device')
 parser.add_argument('-q','--quiet',action='store_true', default=False,
         help='suppress output text')
+parser.add_argument('-b','--binary',action='store_true', default=False,
+        help='stream in binary frames, moves are sent as compact frames instead of text')
+parser.add_argument('-c','--count',action='store_true', default=False,
+        help='character counting, keeps as many lines in the receive buffer as fit instead of waiting for each ok')
 args = parser.parse_args()
 
 f = args.gcode_file
@@ -47,6 +59,255 @@ s.flushInput()  # Flush startup text in serial input
 
 print("Streaming " + args.gcode_file.name + " to " + args.device)
 
+# binary mode, see src/modules/communication/BinaryProtocol.h for the frames
+MOVE, LINE, END = 1, 2, 3
+DELTAS, RAPID = 0x80, 0x40
+
+def crc16(data):
+    crc= 0xFFFF
+    for c in bytearray(data):
+        crc ^= c << 8
+        for i in range(8):
+            crc= ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+def frame(seq, type, payload):
+    f= bytearray([len(payload), seq, type]) + payload
+    return bytearray([0xA5]) + f + bytearray(struct.pack('<H', crc16(f)))
+
+def varint(v):
+    u= ((v << 1) ^ (v >> 31)) & 0xFFFFFFFF
+    b= bytearray()
+    while u >= 0x80:
+        b.append((u & 0x7F) | 0x80)
+        u >>= 7
+    b.append(u)
+    return b
+
+last= [0, 0, 0, 0]  # XYZE word values in microns as Smoothie has them, None when it has one that is not whole microns
+
+def encode(l):
+    """a MOVE payload for a plain G0/G1, None if it has to go as a LINE"""
+    words= re.findall(r'([A-Z])\s*([-+]?[0-9]*\.?[0-9]+)', l.upper())
+    if len(words) < 1 or words[0][0] != 'G' or float(words[0][1]) not in (0, 1) or '.' in words[0][1]:
+        return None
+    rest= dict(words[1:])
+    if len(rest) != len(words) - 1 or any(w not in 'XYZEFS' for w in rest):
+        return None
+
+    flags= RAPID if float(words[0][1]) == 0 else 0
+    um= {}
+    for i, a in enumerate('XYZE'):
+        if a in rest:
+            flags |= 1 << i
+            v= float(rest[a])
+            um[i]= int(round(v * 1000)) if abs(v * 1000 - round(v * 1000)) < 1e-6 else None
+    if um and all(um[i] is not None and last[i] is not None for i in um):
+        flags |= DELTAS
+    p= bytearray([flags])
+    for i, a in enumerate('XYZE'):
+        if i in um:
+            p += varint(um[i] - last[i]) if flags & DELTAS else struct.pack('<f', float(rest[a]))
+            last[i]= um[i]
+    for i, a in enumerate('FS'):
+        if a in rest:
+            flags |= 1 << (4 + i)
+            p += struct.pack('<f', float(rest[a]))
+    p[0]= flags
+    return p
+
+def stream_binary():
+    global errorflg, intrflg
+    s.write(b'binary\n')
+    while True:
+        rep= s.readline().decode('ascii', 'replace')
+        if rep.startswith('ok binary'):
+            window= int(rep.split()[2])
+            break
+
+    lock= threading.Condition()
+    sent= collections.deque()  # (seq, frame) not acked yet
+    resend= [False]
+
+    def in_flight():
+        return sum(len(f) for q, f in sent)
+
+    def binary_read_thread():
+        global errorflg
+        while True:
+            rep= s.readline().decode('ascii', 'replace').strip()
+            with lock:
+                if rep.startswith('ack ') or rep.startswith('nak '):
+                    # everything before it is done
+                    seq= int(rep.split()[1])
+                    if rep.startswith('nak '): seq= (seq - 1) & 0xFF
+                    while sent and ((seq - sent[0][0]) & 0xFF) < 128:
+                        sent.popleft()
+                    if rep.startswith('nak '):
+                        if verbose: print("Incoming: " + rep)
+                        resend[0]= True
+                elif rep.startswith('ok') or rep == '':
+                    pass
+                else:
+                    print("Incoming: " + rep)
+                    if "error" in rep or "!!" in rep or "ALARM" in rep or "ERROR" in rep:
+                        errorflg= True
+                lock.notify()
+            if errorflg:
+                break
+
+    t = threading.Thread(target=binary_read_thread)
+    t.daemon = True
+    t.start()
+
+    def send(type, payload):
+        with lock:
+            f= frame(send.seq, type, payload)
+            while not errorflg and (resend[0] or in_flight() + len(f) > window):
+                if resend[0]:
+                    # go back to the first one it threw away
+                    resend[0]= False
+                    for q, b in sent:
+                        s.write(bytes(b))
+                lock.wait(1)
+            if errorflg:
+                return
+            sent.append((send.seq, f))
+            s.write(bytes(f))
+            send.seq= (send.seq + 1) & 0xFF
+    send.seq= 0
+
+    linecnt= 0
+    try:
+        for line in f:
+            if errorflg :
+                break
+            l= re.sub(r'\(.*?\)|;.*', '', line).strip()
+            if not l:
+                continue
+            p= encode(l)
+            if p is None:
+                if len(l) > 120:
+                    print("Line too long for a frame: " + l)
+                    errorflg= True
+                    break
+                send(LINE, bytearray(l.encode('ascii')))
+            else:
+                send(MOVE, p)
+            linecnt+=1
+            if verbose: print("SND " + str(linecnt) + ": " + l)
+        if not errorflg and not intrflg:
+            send(END, bytearray())
+
+    except KeyboardInterrupt:
+        print("Interrupted...")
+        intrflg= True
+
+    if intrflg :
+        print("Sending Abort...")
+        s.write(b'\x18') # send halt
+
+    if errorflg :
+        print("Target halted due to errors")
+    elif not intrflg:
+        print("Waiting for complete...")
+        with lock:
+            while sent and not errorflg:
+                lock.wait(1)
+        input("  Press <Enter> to exit")
+
+
+def stream_counting():
+    global errorflg, intrflg
+    # the free receive buffer comes with the status, ? is taken out before the buffer so it does not use any itself
+    s.write(b'?')
+    while True:
+        rep= s.readline().decode('ascii', 'replace')
+        m= re.search(r'\|Bf:(\d+),(\d+)', rep)
+        if m:
+            rx_size= int(m.group(2))
+            break
+        if rep.startswith('<'):
+            print("The status does not have Bf:, the firmware does not report its receive buffer")
+            return
+    if verbose: print("Receive buffer " + str(rx_size))
+
+    lock= threading.Condition()
+    sent= collections.deque()  # bytes of each line not replied to yet, oldest first
+
+    def counting_read_thread():
+        global errorflg
+        while True:
+            rep= s.readline().decode('ascii', 'replace').strip()
+            with lock:
+                if rep.startswith('ok') or rep.lower().startswith('error'):
+                    # one reply for each line, in order
+                    if sent: sent.popleft()
+                if not rep.startswith('ok') and rep != '':
+                    print("Incoming: " + rep)
+                    if "error" in rep.lower() or "!!" in rep or "ALARM" in rep:
+                        errorflg= True
+                lock.notify()
+            if errorflg:
+                break
+
+    t = threading.Thread(target=counting_read_thread)
+    t.daemon = True
+    t.start()
+
+    linecnt= 0
+    try:
+        for line in f:
+            if errorflg :
+                break
+            l= re.sub(r'\(.*?\)|;.*', '', line).strip()
+            if not l:
+                continue
+            b= l.encode('ascii') + b'\n'
+            if len(b) > rx_size:
+                print("Line too long for the receive buffer: " + l)
+                errorflg= True
+                break
+            with lock:
+                while not errorflg and sum(sent) + len(b) > rx_size:
+                    lock.wait(1)
+                if errorflg:
+                    break
+                sent.append(len(b))
+            s.write(b)
+            linecnt+=1
+            if verbose: print("SND " + str(linecnt) + ": " + l + " - " + str(len(sent)))
+
+    except KeyboardInterrupt:
+        print("Interrupted...")
+        intrflg= True
+
+    if intrflg :
+        print("Sending Abort...")
+        s.write(b'\x18') # send halt
+
+    if errorflg :
+        print("Target halted due to errors")
+    elif not intrflg:
+        print("Waiting for complete...")
+        with lock:
+            while sent and not errorflg:
+                lock.wait(1)
+        input("  Press <Enter> to exit")
+
+if args.count:
+    stream_counting()
+    f.close()
+    s.close()
+    sys.exit(0)
+
+if args.binary:
+    stream_binary()
+    f.close()
+    s.close()
+    sys.exit(0)
+
 okcnt= 0
 
 def read_thread():
@@ -107,7 +368,7 @@ else :
         time.sleep(1)
 
     # Wait here until finished to close serial port and file.
-    raw_input("  Press <Enter> to exit")
+    input("  Press <Enter> to exit")
 
 
 # Close file and serial port
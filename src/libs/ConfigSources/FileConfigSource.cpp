@@ -142,10 +142,10 @@ bool FileConfigSource::write( string setting, string value )
     // search each line for a match
     while(!feof(lp)) {
         string line;
-        fpos_t bol, eol;
-        fgetpos( lp, &bol ); // get start of line
+        long bol, eol;
+        bol = ftell(lp); // get start of line
         if(readLine(line, 0, lp)) {
-            fgetpos( lp, &eol ); // get end of line
+            eol = ftell(lp); // get end of line
             if(!process_line_from_ascii_config(line, setting_checksums).empty()) {
                 // found it
                 unsigned int free_space = eol - bol - 4; // length of line
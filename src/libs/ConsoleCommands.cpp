@@ -0,0 +1,68 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConsoleCommands.h"
+
+#include "SerialMessage.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <string.h>
+
+using std::string;
+
+void ConsoleCommands::add(const char *name, Module *module, ModuleCommand method)
+{
+    insert(command_t{name, module, method, nullptr});
+}
+
+void ConsoleCommands::add(const char *name, ConsoleFunction function)
+{
+    insert(command_t{name, nullptr, nullptr, function});
+}
+
+void ConsoleCommands::insert(const command_t& c)
+{
+    auto i= std::upper_bound(commands.begin(), commands.end(), c, [](const command_t& a, const command_t& b) { return strcmp(a.name, b.name) < 0; });
+    commands.insert(i, c);
+}
+
+void ConsoleCommands::remove(Module *module)
+{
+    commands.erase(std::remove_if(commands.begin(), commands.end(), [module](const command_t& c) { return c.module == module; }), commands.end());
+}
+
+bool ConsoleCommands::call(SerialMessage *message) const
+{
+    const string& line= message->message;
+    if(line.empty() || !islower(line[0])) return false;
+
+    // the command is up to the first space as shift_parameter() would have it
+    size_t len= line.find(' ');
+    if(len == string::npos) len= line.size();
+    const char *word= line.c_str();
+
+    // the name compared with just the command, a longer name comes after it
+    auto cmp= [word, len](const char *name) {
+        int r= strncmp(name, word, len);
+        return r != 0 ? r : (name[len] == '\0' ? 0 : 1);
+    };
+    auto first= std::partition_point(commands.begin(), commands.end(), [&cmp](const command_t& c) { return cmp(c.name) < 0; });
+    if(first == commands.end() || cmp(first->name) != 0) return false;
+
+    // the rest of the line after the space, each handler gets its own copy
+    const string parameters= len < line.size() ? line.substr(len + 1) : string();
+    StreamOutput *stream= message->stream;
+    for (auto c = first; c != commands.end() && cmp(c->name) == 0; ++c) {
+        if(c->module != nullptr) {
+            (c->module->*c->method)(parameters, stream);
+        } else {
+            c->function(parameters, stream);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,43 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "Module.h"
+
+#include <vector>
+
+struct SerialMessage;
+
+/*
+ * The console commands the modules handle, like play or fire.
+ *
+ * A console line that starts with a lowercase word that has been registered goes to the handlers for it with the
+ * rest of the line, nothing else sees it. Any other line, gcodes included, still goes to the modules that registered
+ * for ON_CONSOLE_LINE_RECEIVED, which leaves GcodeDispatch and SimpleShell to deal with the gcodes, the $ commands and
+ * the ones no one knows about.
+ */
+class ConsoleCommands {
+    public:
+        void add(const char *name, Module *module, ModuleCommand method);
+        void add(const char *name, ConsoleFunction function);
+        void remove(Module *module);
+
+        // calls the handlers for the command the line starts with, false if there are none
+        bool call(SerialMessage *message) const;
+
+    private:
+        struct command_t {
+            const char *name;                               // has to stay around, it is not copied
+            Module *module;
+            ModuleCommand method;
+            ConsoleFunction function;                       // when there is no module
+        };
+        void insert(const command_t& c);
+
+        std::vector<command_t> commands;                    // sorted by name, the ones with the same name in the order they registered
+};
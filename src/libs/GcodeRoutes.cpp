@@ -0,0 +1,92 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GcodeRoutes.h"
+
+#include "Module.h"
+#include "Gcode.h"
+
+#include <algorithm>
+
+void GcodeRoutes::add(Module *module)
+{
+    insert(module, all);
+}
+
+void GcodeRoutes::add(Module *module, char letter, uint16_t first, uint16_t last)
+{
+    for (uint32_t c = first; c <= last; ++c) {
+        insert(module, key(letter, c));
+    }
+}
+
+void GcodeRoutes::insert(Module *module, uint16_t code)
+{
+    auto m= std::find(modules.begin(), modules.end(), module);
+    if(m == modules.end()) m= modules.insert(m, module);
+    route_t r{code, (uint16_t)(m - modules.begin()), module};
+
+    auto i= std::lower_bound(routes.begin(), routes.end(), r, [](const route_t& a, const route_t& b) {
+        return a.code < b.code || (a.code == b.code && a.order < b.order);
+    });
+    if(i != routes.end() && i->code == code && i->module == module) return; // already has it
+    routes.insert(i, r);
+}
+
+void GcodeRoutes::remove(Module *module)
+{
+    auto m= std::find(modules.begin(), modules.end(), module);
+    if(m == modules.end()) return;
+    uint16_t order= m - modules.begin();
+    modules.erase(m);
+
+    routes.erase(std::remove_if(routes.begin(), routes.end(), [module](const route_t& r) { return r.module == module; }), routes.end());
+    // the ones after it move up, which keeps each code in order
+    for (auto& r : routes) {
+        if(r.order > order) --r.order;
+    }
+}
+
+bool GcodeRoutes::has(Module *module) const
+{
+    return std::find(modules.begin(), modules.end(), module) != modules.end();
+}
+
+const GcodeRoutes::route_t *GcodeRoutes::lower_bound(uint16_t code) const
+{
+    auto i= std::lower_bound(routes.begin(), routes.end(), code, [](const route_t& a, uint16_t c) { return a.code < c; });
+    return routes.data() + (i - routes.begin());
+}
+
+void GcodeRoutes::call(Gcode *gcode) const
+{
+    if(routes.empty()) return;
+    const route_t *end= routes.data() + routes.size();
+
+    // up to three runs sorted by order, the ones for G, for M and the ones that see everything, merged
+    uint16_t code[3];
+    int n= 0;
+    if(gcode->has_g) code[n++]= key('G', gcode->g);
+    if(gcode->has_m) code[n++]= key('M', gcode->m);
+    code[n++]= all;
+    const route_t *run[3];
+    for (int i = 0; i < n; ++i) run[i]= lower_bound(code[i]);
+
+    int last= -1;
+    for (;;) {
+        int next= -1;
+        for (int i = 0; i < n; ++i) {
+            if(run[i] < end && run[i]->code == code[i] && (next < 0 || run[i]->order < run[next]->order)) next= i;
+        }
+        if(next < 0) return;
+
+        const route_t *r= run[next]++;
+        if(r->order == last) continue; // a module that sees everything and registered for this code as well
+        last= r->order;
+        r->module->on_gcode_received(gcode);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+class Module;
+class Gcode;
+
+/*
+ * Which modules ON_GCODE_RECEIVED goes to.
+ *
+ * A module that registers for the event the old way sees every gcode. One that registers for just the G or M codes
+ * it handles with Module::register_for_gcode() only sees those, so a G1 is not passed round every temperature control,
+ * switch and extruder. The routes are a table sorted by code, call() looks the code up and calls the modules for it
+ * and the ones that see everything, in the order they registered just as the broadcast did.
+ */
+class GcodeRoutes {
+    public:
+        // the module sees every gcode
+        void add(Module *module);
+        // the module sees the G or M codes first to last
+        void add(Module *module, char letter, uint16_t first, uint16_t last);
+        void remove(Module *module);
+        bool has(Module *module) const;
+
+        // calls on_gcode_received() of each module for this gcode
+        void call(Gcode *gcode) const;
+
+    private:
+        struct route_t {
+            uint16_t code;                                   // key() of the code, or all
+            uint16_t order;                                  // when the module first registered
+            Module *module;
+        };
+        static const uint16_t all= 0xFFFF;
+        static uint16_t key(char letter, uint16_t code) { return letter == 'M' ? (0x4000 | code) : code; }
+
+        void insert(Module *module, uint16_t code);
+        const route_t *lower_bound(uint16_t code) const;
+
+        std::vector<Module*> modules;                        // in the order they registered
+        std::vector<route_t> routes;                         // sorted by code then order, the ones that see everything are last
+};
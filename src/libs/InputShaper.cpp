@@ -0,0 +1,160 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "InputShaper.h"
+
+#include <math.h>
+
+#define PI 3.14159265358979323846F // force to be float, do not use M_PI
+
+InputShaper::InputShaper()
+{
+    configure(NONE, 0, 0, 1);
+    reset(0, 0);
+}
+
+// The impulses for each type, K is how much the vibration decays in half a damped period.
+// ZV cancels the vibration at exactly the frequency, ZVD and MZV are less sensitive to the frequency being a little out,
+// EI allows 5% vibration at the frequency to be even less sensitive
+bool InputShaper::configure(TYPE type, float frequency, float damping, float tick_frequency)
+{
+    if(type != NONE && (frequency <= 0.0F || damping < 0.0F || damping >= 1.0F)) return false;
+
+    float df = sqrtf(1.0F - damping * damping);
+    float td = type != NONE ? tick_frequency / (frequency * df) : 0; // damped period in ticks
+    float k = expf(-damping * PI / df);
+
+    switch(type) {
+        case NONE:
+            n_impulses= 1;
+            amplitude[0]= 1; delay[0]= 0;
+            break;
+
+        case ZV:
+            n_impulses= 2;
+            amplitude[0]= 1; delay[0]= 0;
+            amplitude[1]= k; delay[1]= 0.5F * td;
+            break;
+
+        case ZVD:
+            n_impulses= 3;
+            amplitude[0]= 1;         delay[0]= 0;
+            amplitude[1]= 2 * k;     delay[1]= 0.5F * td;
+            amplitude[2]= k * k;     delay[2]= td;
+            break;
+
+        case MZV: {
+            n_impulses= 3;
+            float km = expf(-0.75F * damping * PI / df);
+            float a1 = 1.0F - 1.0F / sqrtf(2.0F);
+            amplitude[0]= a1;                          delay[0]= 0;
+            amplitude[1]= (sqrtf(2.0F) - 1.0F) * km;   delay[1]= 0.375F * td;
+            amplitude[2]= a1 * km * km;                delay[2]= 0.75F * td;
+        } break;
+
+        case EI: {
+            const float v_tol = 0.05F; // allowed vibration at the shaper frequency
+            n_impulses= 3;
+            amplitude[0]= 0.25F * (1.0F + v_tol);              delay[0]= 0;
+            amplitude[1]= 0.5F * (1.0F - v_tol) * k;           delay[1]= 0.5F * td;
+            amplitude[2]= 0.25F * (1.0F + v_tol) * k * k;      delay[2]= td;
+        } break;
+    }
+
+    // the history has to go back the whole duration, limit it to 100ms
+    uint32_t d= ceilf(delay[n_impulses - 1]);
+    if(d > tick_frequency / 10) return false;
+
+    float sum= 0;
+    for (int i = 0; i < n_impulses; ++i) sum += amplitude[i];
+    for (int i = 0; i < n_impulses; ++i) amplitude[i] /= sum;
+
+    this->type= type;
+    this->frequency= frequency;
+    this->damping= damping;
+    this->duration= d;
+    return true;
+}
+
+void InputShaper::reset(uint32_t tick, int32_t position)
+{
+    now= tick;
+    history[0].tick= tick;
+    history[0].position= position;
+    newest= 0;
+    count= 1;
+    last_change= now - duration;
+}
+
+// the commanded position the given number of ticks ago relative to the newest one, the motion between samples is linear
+float InputShaper::offset_at(float delay) const
+{
+    int32_t current= history[newest].position;
+    uint16_t i= newest;
+    uint16_t newer= newest;
+    for (uint16_t n = 0; n < count; ++n) {
+        float age= now - history[i].tick;
+        if(age >= delay) {
+            if(i == newer) return 0;
+            float newer_age= now - history[newer].tick;
+            float p= history[i].position + (history[newer].position - history[i].position) * (age - delay) / (age - newer_age);
+            return p - current;
+        }
+        newer= i;
+        i= (i == 0) ? history_size - 1 : i - 1;
+    }
+
+    // older than the history, the motor was still at the oldest position
+    return history[newer].position - current;
+}
+
+int32_t InputShaper::shape(uint32_t tick, int32_t position)
+{
+    now= tick;
+
+    sample_t &n= history[newest];
+    if(position != n.position) last_change= tick;
+
+    uint16_t prev= (newest == 0) ? history_size - 1 : newest - 1;
+    if(count >= 2 && position == n.position && history[prev].position == position) {
+        // a run of equal positions only needs its first and last samples
+        n.tick= tick;
+
+    } else {
+        newest= (newest + 1) % history_size;
+        history[newest].tick= tick;
+        history[newest].position= position;
+        if(count < history_size) ++count;
+    }
+
+    float offset= 0;
+    for (int i = 0; i < n_impulses; ++i) {
+        offset += amplitude[i] * offset_at(delay[i]);
+    }
+
+    return position + lroundf(offset);
+}
+
+InputShaper::TYPE InputShaper::type_from_name(const std::string &name)
+{
+    if(name == "zv") return ZV;
+    if(name == "zvd") return ZVD;
+    if(name == "mzv") return MZV;
+    if(name == "ei") return EI;
+    return NONE;
+}
+
+const char *InputShaper::type_name(TYPE type)
+{
+    switch(type) {
+        case ZV: return "zv";
+        case ZVD: return "zvd";
+        case MZV: return "mzv";
+        case EI: return "ei";
+        default: return "none";
+    }
+}
@@ -0,0 +1,67 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/*
+ * Input shaper for one motor.
+ *
+ * The shaped position is a weighted sum of the commanded position at a few delays (the impulses),
+ * chosen so the vibration each impulse excites at the shaper frequency cancels out. The commanded
+ * position is kept as a short history of (tick, position) samples and interpolated between them.
+ */
+class InputShaper {
+    public:
+        enum TYPE { NONE, ZV, ZVD, MZV, EI };
+
+        InputShaper();
+
+        // returns false if the parameters can not be used, frequency in Hz, damping ratio 0 to <1
+        bool configure(TYPE type, float frequency, float damping, float tick_frequency);
+        // forget the history, the motor is at rest at the given position since the given tick
+        void reset(uint32_t tick, int32_t position);
+
+        // add the commanded position at the given tick and return the shaped position for that tick
+        int32_t shape(uint32_t tick, int32_t position);
+        // true when the shaped position has caught up with the commanded position
+        bool is_settled() const { return now - last_change >= duration; }
+
+        TYPE get_type() const { return type; }
+        float get_frequency() const { return frequency; }
+        float get_damping() const { return damping; }
+
+        static TYPE type_from_name(const std::string &name);
+        static const char *type_name(TYPE type);
+
+    private:
+        float offset_at(float delay) const;
+
+        static const int max_impulses= 3;
+        static const int history_size= 256;
+
+        using sample_t= struct {
+            uint32_t tick;
+            int32_t position;
+        };
+
+        TYPE type;
+        float frequency;
+        float damping;
+        float amplitude[max_impulses];
+        float delay[max_impulses];       // in ticks
+        uint32_t duration;               // longest delay in ticks, rounded up
+        uint8_t n_impulses;
+
+        sample_t history[history_size];
+        uint16_t newest;
+        uint16_t count;
+        uint32_t now;
+        uint32_t last_change;
+};
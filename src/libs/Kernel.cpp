@@ -17,6 +17,9 @@
 #include "ConfigValue.h"
 
 #include "libs/StepTicker.h"
+#include "libs/RealtimeCommands.h"
+#include "libs/GcodeRoutes.h"
+#include "libs/ConsoleCommands.h"
 #include "libs/PublicData.h"
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
@@ -46,6 +49,12 @@
 
 #define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
 #define microseconds_per_step_pulse_checksum        CHECKSUM("microseconds_per_step_pulse")
+#define step_segments_enable_checksum               CHECKSUM("step_segments_enable")
+#define step_segment_time_ms_checksum               CHECKSUM("step_segment_time_ms")
+#define step_multiplier_max_checksum                CHECKSUM("step_multiplier_max")
+#define step_multiplier_threshold_checksum          CHECKSUM("step_multiplier_threshold")
+#define step_events_enable_checksum                 CHECKSUM("step_events_enable")
+#define feed_override_ramp_time_checksum            CHECKSUM("feed_override_ramp_time")
 #define disable_leds_checksum                       CHECKSUM("leds_disable")
 #define grbl_mode_checksum                          CHECKSUM("grbl_mode")
 #define feed_hold_enable_checksum                   CHECKSUM("enable_feed_hold")
@@ -62,6 +71,12 @@ Kernel::Kernel()
 
     instance = this; // setup the Singleton instance of the kernel
 
+    // the serial interrupts can get realtime commands before the rest is set up
+    this->step_ticker = nullptr;
+    this->realtime = new RealtimeCommands();
+    this->gcode_routes = new GcodeRoutes();
+    this->console_commands = new ConsoleCommands();
+
     // serial first at fixed baud rate (DEFAULT_SERIAL_BAUD_RATE) so config can report errors to serial
     // Set to UART0, this will be changed to use the same UART as MRI if it's enabled
     this->serial = new SerialConsole(USBTX, USBRX, DEFAULT_SERIAL_BAUD_RATE);
@@ -160,6 +175,25 @@ Kernel::Kernel()
     this->step_ticker->set_frequency( this->base_stepping_frequency );
     this->step_ticker->set_unstep_time( microseconds_per_step_pulse );
 
+    // optionally prepare constant rate segments outside of the step interrupt
+    if(this->config->value(step_segments_enable_checksum)->by_default(false)->as_bool()) {
+        this->step_ticker->enable_segments(this->config->value(step_segment_time_ms_checksum)->by_default(1.0F)->as_number());
+    }
+
+    // optionally only interrupt on the ticks that have something to do
+    if(this->config->value(step_events_enable_checksum)->by_default(false)->as_bool()) {
+        this->step_ticker->enable_events();
+    }
+
+    // how long the feed override takes to go from 0 to 100%
+    this->step_ticker->set_speed_ramp(this->config->value(feed_override_ramp_time_checksum)->by_default(0.2F)->as_number());
+
+    // optionally issue 2 or 4 steps per tick for blocks faster than the threshold (steps/sec)
+    uint8_t step_multiplier_max = this->config->value(step_multiplier_max_checksum)->by_default(1)->as_int();
+    if(step_multiplier_max > 1) {
+        this->step_ticker->enable_multistep(step_multiplier_max, this->config->value(step_multiplier_threshold_checksum)->by_default((float)this->base_stepping_frequency)->as_number());
+    }
+
     // Core modules
     this->add_module( this->conveyor       = new Conveyor()      );
     this->add_module( this->gcode_dispatch = new GcodeDispatch() );
@@ -170,8 +204,8 @@ Kernel::Kernel()
     this->configurator = new Configurator();
 }
 
-// return a GRBL-like query string for serial ?
-std::string Kernel::get_query_string()
+// return a GRBL-like query string for serial ?, with the room left in the stream's receive buffer if it has one
+std::string Kernel::get_query_string(StreamOutput *stream)
 {
     std::string str;
     bool homing;
@@ -227,7 +261,7 @@ std::string Kernel::get_query_string()
         // current feedrate and requested fr and override
         float fr= robot->from_millimeters(conveyor->get_current_feedrate()*60.0F);
         float frr= robot->from_millimeters(robot->get_feed_rate());
-        float fro= 6000.0F / robot->get_seconds_per_minute();
+        float fro= robot->get_feed_override();
         n = snprintf(buf, sizeof(buf), "|F:%1.1f,%1.1f,%1.1f", fr, frr,fro);
         if(n > sizeof(buf)) n= sizeof(buf);
         str.append(buf, n);
@@ -276,12 +310,21 @@ std::string Kernel::get_query_string()
 
         // requested framerate, and override
         float fr= robot->from_millimeters(robot->get_feed_rate());
-        float fro= 6000.0F / robot->get_seconds_per_minute();
+        float fro= robot->get_feed_override();
         n = snprintf(buf, sizeof(buf), "|F:%1.1f,%1.1f", fr, fro);
         if(n > sizeof(buf)) n= sizeof(buf);
         str.append(buf, n);
     }
 
+    // free planner blocks and receive buffer bytes
+    int rx= stream != nullptr ? stream->rx_free() : -1;
+    if(rx >= 0) {
+        char buf[32];
+        size_t n = snprintf(buf, sizeof(buf), "|Bf:%u,%d", conveyor->get_queue_free(), rx);
+        if(n > sizeof(buf)) n= sizeof(buf);
+        str.append(buf, n);
+    }
+
     // if not grbl mode get temperatures
     if(!is_grbl_mode()) {
         struct pad_temperature temp;
@@ -302,6 +345,13 @@ std::string Kernel::get_query_string()
     return str;
 }
 
+// the step ticker brings the current move to a stop, the robot stops queuing more until it is released
+void Kernel::set_feed_hold(bool f)
+{
+    feed_hold= f;
+    if(step_ticker != nullptr) step_ticker->set_feed_hold(f);
+}
+
 // Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
 void Kernel::add_module(Module* module)
 {
@@ -312,21 +362,47 @@ void Kernel::add_module(Module* module)
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod)
 {
     this->hooks[id_event].push_back(mod);
+    if(id_event == ON_GCODE_RECEIVED) this->gcode_routes->add(mod);
+}
+
+void Kernel::register_for_gcode(char letter, uint16_t first, uint16_t last, Module *mod)
+{
+    if(!this->gcode_routes->has(mod)) this->hooks[ON_GCODE_RECEIVED].push_back(mod);
+    this->gcode_routes->add(mod, letter, first, last);
+}
+
+void Kernel::register_for_command(const char *name, Module *mod, ModuleCommand method)
+{
+    this->console_commands->add(name, mod, method);
+}
+
+void Kernel::register_for_command(const char *name, ConsoleFunction function)
+{
+    this->console_commands->add(name, function);
 }
 
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument)
 {
+    // a console command goes to just the handlers for it
+    if(id_event == ON_CONSOLE_LINE_RECEIVED && this->console_commands->call(static_cast<SerialMessage*>(argument))) return;
+
     bool was_idle = true;
     if(id_event == ON_HALT) {
         this->halted = (argument == nullptr);
-        if(!this->halted && this->feed_hold) this->feed_hold= false; // also clear feed hold
+        if(!this->halted && this->feed_hold) set_feed_hold(false); // also clear feed hold
         was_idle = conveyor->is_idle(); // see if we were doing anything like printing
     }
 
-    // send to all registered modules
-    for (auto m : hooks[id_event]) {
-        (m->*kernel_callback_functions[id_event])(argument);
+    if(id_event == ON_GCODE_RECEIVED) {
+        // only to the modules that handle this code
+        this->gcode_routes->call(static_cast<Gcode*>(argument));
+
+    } else {
+        // send to all registered modules
+        for (auto m : hooks[id_event]) {
+            (m->*kernel_callback_functions[id_event])(argument);
+        }
     }
 
     if(id_event == ON_HALT) {
@@ -350,6 +426,8 @@ bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 
 void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
 {
+    if(id_event == ON_GCODE_RECEIVED) this->gcode_routes->remove(mod);
+    if(id_event == ON_CONSOLE_LINE_RECEIVED) this->console_commands->remove(mod);
     for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
         if(*i == mod) {
             hooks[id_event].erase(i);
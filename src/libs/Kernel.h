@@ -28,6 +28,9 @@ class GcodeDispatch;
 class Robot;
 class Planner;
 class StepTicker;
+class RealtimeCommands;
+class GcodeRoutes;
+class ConsoleCommands;
 class Adc;
 class PublicData;
 class SimpleShell;
@@ -42,6 +45,11 @@ class Kernel {
         void add_module(Module* module);
         void register_for_event(_EVENT_ENUM id_event, Module *module);
         void call_event(_EVENT_ENUM id_event, void * argument= nullptr);
+        // ON_GCODE_RECEIVED for just these G or M codes
+        void register_for_gcode(char letter, uint16_t first, uint16_t last, Module *module);
+        // console lines starting with this command go to it rather than to ON_CONSOLE_LINE_RECEIVED
+        void register_for_command(const char *name, Module *module, ModuleCommand method);
+        void register_for_command(const char *name, ConsoleFunction function);
 
         bool kernel_has_event(_EVENT_ENUM id_event, Module *module);
         void unregister_for_event(_EVENT_ENUM id_event, Module *module);
@@ -51,11 +59,11 @@ class Kernel {
         bool is_grbl_mode() const { return grbl_mode; }
         bool is_ok_per_line() const { return ok_per_line; }
 
-        void set_feed_hold(bool f) { feed_hold= f; }
+        void set_feed_hold(bool f);
         bool get_feed_hold() const { return feed_hold; }
         bool is_feed_hold_enabled() const { return enable_feed_hold; }
 
-        std::string get_query_string();
+        std::string get_query_string(StreamOutput *stream= nullptr);
 
         // These modules are available to all other modules
         SerialConsole*    serial;
@@ -70,6 +78,7 @@ class Kernel {
 
         SlowTicker*       slow_ticker;
         StepTicker*       step_ticker;
+        RealtimeCommands* realtime;
         Adc*              adc;
         std::string       current_path;
         uint32_t          base_stepping_frequency;
@@ -77,6 +86,9 @@ class Kernel {
     private:
         // When a module asks to be called for a specific event ( a hook ), this is where that request is remembered
         std::array<std::vector<Module*>, NUMBER_OF_DEFINED_EVENTS> hooks;
+        // ON_GCODE_RECEIVED goes through here instead
+        GcodeRoutes* gcode_routes;
+        ConsoleCommands* console_commands;
         struct {
             bool use_leds:1;
             bool halted:1;
@@ -32,3 +32,11 @@ void Module::register_for_event(_EVENT_ENUM event_id){
     // You add things to Smoothie by making a new class that inherits the Module class. See http://smoothieware.org/moduleexample for a crude introduction
     THEKERNEL->register_for_event(event_id, this);
 }
+
+void Module::register_for_gcode(char letter, unsigned short first, unsigned short last){
+    THEKERNEL->register_for_gcode(letter, first, last, this);
+}
+
+void Module::add_command(const char *name, ModuleCommand method){
+    THEKERNEL->register_for_command(name, this, method);
+}
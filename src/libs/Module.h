@@ -8,6 +8,8 @@
 #ifndef MODULE_H
 #define MODULE_H
 
+#include <string>
+
 // See : http://smoothieware.org/listofevents
 // When adding a new event the virtual method needs to be defined in class Module and the method pointer need to be defined in
 // Module.cpp:16 in the same order
@@ -25,7 +27,11 @@ enum _EVENT_ENUM {
 };
 
 class Module;
+class StreamOutput;
 typedef void (Module::*ModuleCallback)(void *argument);
+// console command handlers, called with the rest of the line
+typedef void (Module::*ModuleCommand)(std::string parameters, StreamOutput *stream);
+typedef void (*ConsoleFunction)(std::string parameters, StreamOutput *stream);
 extern const ModuleCallback kernel_callback_functions[NUMBER_OF_DEFINED_EVENTS];
 
 // Module base class
@@ -38,6 +44,11 @@ public:
     virtual void on_module_loaded() {};
 
     void register_for_event(_EVENT_ENUM event_id);
+    // on_gcode_received only gets called for these G or M codes rather than for every gcode
+    void register_for_gcode(char letter, unsigned short code) { register_for_gcode(letter, code, code); }
+    void register_for_gcode(char letter, unsigned short first, unsigned short last);
+    // method gets called for console lines that start with this command, it does not see them in on_console_line_received
+    template<class T> void register_for_command(const char *name, void (T::*method)(std::string, StreamOutput*)) { add_command(name, static_cast<ModuleCommand>(method)); }
 
     // event callbacks, not every module will implement all of these
     // there should be one for each _EVENT_ENUM
@@ -51,6 +62,8 @@ public:
     virtual void on_halt(void *) {};
     virtual void on_enable(void *) {};
 
+private:
+    void add_command(const char *name, ModuleCommand method);
 };
 
 #endif
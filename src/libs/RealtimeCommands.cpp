@@ -0,0 +1,91 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RealtimeCommands.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+
+#include <algorithm>
+
+RealtimeCommands::RealtimeCommands() : pending(0)
+{
+    feed_override= 100;
+    rapid_override= 100;
+    spindle_override= 100;
+    resume_held= false;
+    jogging= false;
+}
+
+// runs in the receive interrupts
+bool RealtimeCommands::receive(uint8_t c)
+{
+    // ! and ~ are printable and the top half turns up in UTF-8 text, so only when asked for
+    if(!THEKERNEL->is_grbl_mode() && !THEKERNEL->is_feed_hold_enabled()) return false;
+
+    switch(c) {
+        case FEED_HOLD:
+        case CYCLE_START:
+            if(c == FEED_HOLD) {
+                THEKERNEL->set_feed_hold(true);
+            } else if(resume_held) {
+                set(RESUME);
+            } else {
+                THEKERNEL->set_feed_hold(false);
+            }
+            return true;
+
+        case SAFETY_DOOR: THEKERNEL->set_feed_hold(true); return true; // there is no door handling, it stops like a hold
+
+        case JOG_CANCEL:
+            // it stops as a hold would, then the robot flushes the rest
+            if(jogging) {
+                THEKERNEL->set_feed_hold(true);
+                set(CANCEL_JOG);
+            }
+            return true;
+
+        case FEED_OVR_RESET: change_feed(100 - feed_override); return true;
+        case FEED_OVR_COARSE_PLUS: change_feed(10); return true;
+        case FEED_OVR_COARSE_MINUS: change_feed(-10); return true;
+        case FEED_OVR_FINE_PLUS: change_feed(1); return true;
+        case FEED_OVR_FINE_MINUS: change_feed(-1); return true;
+
+        case RAPID_OVR_RESET: rapid_override= 100; set(RAPID_OVERRIDE); return true;
+        case RAPID_OVR_MEDIUM: rapid_override= 50; set(RAPID_OVERRIDE); return true;
+        case RAPID_OVR_LOW: rapid_override= 25; set(RAPID_OVERRIDE); return true;
+
+        case SPINDLE_OVR_RESET: change_spindle(100 - spindle_override); return true;
+        case SPINDLE_OVR_COARSE_PLUS: change_spindle(10); return true;
+        case SPINDLE_OVR_COARSE_MINUS: change_spindle(-10); return true;
+        case SPINDLE_OVR_FINE_PLUS: change_spindle(1); return true;
+        case SPINDLE_OVR_FINE_MINUS: change_spindle(-1); return true;
+
+        case SPINDLE_OVR_STOP:
+            // only means something while held
+            if(THEKERNEL->get_feed_hold()) set(SPINDLE_STOP);
+            return true;
+    }
+
+    // anything else is part of a line
+    return false;
+}
+
+// 10% to 200% as grbl does, slowing down happens now as the step ticker does it, the robot plans anything over 100%
+void RealtimeCommands::change_feed(int by)
+{
+    int f= std::min(200, std::max(10, feed_override + by));
+    feed_override= f;
+    if(THEKERNEL->step_ticker != nullptr) THEKERNEL->step_ticker->set_speed_factor(std::min(f, 100) / 100.0F);
+    set(FEED_OVERRIDE);
+}
+
+void RealtimeCommands::change_spindle(int by)
+{
+    spindle_override= std::min(200, std::max(10, spindle_override + by));
+    set(SPINDLE_OVERRIDE);
+}
@@ -0,0 +1,88 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Grbl 1.1 compatible realtime commands.
+ *
+ * The serial and USB receive interrupts hand every byte to receive() before it goes in the line buffer, the
+ * realtime ones are taken out there. They are only looked for in grbl mode or with enable_feed_hold set, otherwise
+ * every byte goes to the line. What can be done from the interrupt is done straight away (feed hold, cycle
+ * start and slowing the feed go to the step ticker), the rest is left as a flag for the module that deals with
+ * it to take from on_idle, which still gets called while the main loop is blocked waiting for room in the queue.
+ * ? and ^X stay with the streams as the reply goes back to the one that asked.
+ */
+class RealtimeCommands {
+    public:
+        enum CODE : uint8_t {
+            FEED_HOLD=                '!',
+            CYCLE_START=              '~',
+            SAFETY_DOOR=              0x84,
+            JOG_CANCEL=               0x85,
+            FEED_OVR_RESET=           0x90,
+            FEED_OVR_COARSE_PLUS=     0x91,
+            FEED_OVR_COARSE_MINUS=    0x92,
+            FEED_OVR_FINE_PLUS=       0x93,
+            FEED_OVR_FINE_MINUS=      0x94,
+            RAPID_OVR_RESET=          0x95,
+            RAPID_OVR_MEDIUM=         0x96,
+            RAPID_OVR_LOW=            0x97,
+            SPINDLE_OVR_RESET=        0x99,
+            SPINDLE_OVR_COARSE_PLUS=  0x9A,
+            SPINDLE_OVR_COARSE_MINUS= 0x9B,
+            SPINDLE_OVR_FINE_PLUS=    0x9C,
+            SPINDLE_OVR_FINE_MINUS=   0x9D,
+            SPINDLE_OVR_STOP=         0x9E,
+        };
+
+        // left for the main loop
+        enum FLAG : uint32_t {
+            FEED_OVERRIDE=      1<<0,   // the robot has to catch up with get_feed_override()
+            RAPID_OVERRIDE=     1<<1,   // the robot has to use get_rapid_override() for the next seeks
+            SPINDLE_OVERRIDE=   1<<2,   // the spindle has to change to get_spindle_override() of its set speed
+            SPINDLE_STOP=       1<<3,   // toggle the spindle while in a feed hold
+            RESUME=             1<<4,   // a cycle start while the resume is held back
+            CANCEL_JOG=         1<<5,   // the jog has been feed held, the robot throws it away once it has stopped
+        };
+
+        RealtimeCommands();
+
+        // from the receive interrupts, true if c was a realtime command and is not part of a line
+        bool receive(uint8_t c);
+        // true if the flag was set, it is cleared
+        bool take(FLAG f) { return (pending.fetch_and(~(uint32_t)f) & f) != 0; }
+
+        // percentages
+        uint16_t get_feed_override() const { return feed_override; }
+        void set_feed_override(uint16_t p) { feed_override= p; }
+        uint16_t get_rapid_override() const { return rapid_override; }
+        uint16_t get_spindle_override() const { return spindle_override; }
+
+        // a module that has to do something before the motion carries on (starting a spindle stopped in the hold)
+        // holds the resume back, a cycle start then sets RESUME for it and it releases the feed hold itself
+        void hold_resume(bool f) { resume_held= f; }
+
+        // the robot has $J= jogs queued, only then does the jog cancel do anything
+        void set_jogging(bool f) { jogging= f; }
+        bool is_jogging() const { return jogging; }
+
+    private:
+        void set(FLAG f) { pending.fetch_or(f); }
+        void change_feed(int by);
+        void change_spindle(int by);
+
+        std::atomic<uint32_t> pending;
+        volatile uint16_t feed_override;
+        volatile uint16_t rapid_override;
+        volatile uint16_t spindle_override;
+        volatile bool resume_held;
+        volatile bool jogging;
+};
@@ -18,6 +18,8 @@
 
 #include "system_LPC17xx.h" // mbed.h lib
 #include <math.h>
+#include <stdlib.h>
+#include <algorithm>
 #include <mri.h>
 
 #ifdef STEPTICKER_DEBUG_PIN
@@ -50,9 +52,18 @@ StepTicker::StepTicker()
     this->set_unstep_time(100);
 
     this->unstep.reset();
+    this->pending.reset();
+    this->pending_steps.fill(0);
     this->num_motors = 0;
 
     this->running = false;
+    this->skip_block = false;
+    this->pulse_gap = false;
+    this->shaper_tail = false;
+    this->shaper_reset = false;
+    this->hold_stopped = false;
+    this->drop_held = false;
+    this->drop_prepared = false;
     this->current_block = nullptr;
 
     #ifdef STEPTICKER_DEBUG_PIN
@@ -64,6 +75,8 @@ StepTicker::StepTicker()
 
 StepTicker::~StepTicker()
 {
+    delete segments;
+    for(auto s : shapers) delete s;
 }
 
 //called when everything is setup and interrupts can start
@@ -79,29 +92,256 @@ void StepTicker::set_frequency( float frequency )
 {
     this->frequency = frequency;
     this->period = floorf((SystemCoreClock / 4.0F) / frequency); // SystemCoreClock/4 = Timer increments in a second
-    LPC_TIM0->MR0 = this->period;
+    this->tick_period = ((uint64_t)this->period << 16) / this->speed_factor;
+    this->interval = 1;
+    LPC_TIM0->MR0 = this->tick_period;
     LPC_TIM0->TCR = 3;  // Reset
     LPC_TIM0->TCR = 1;  // start
 }
 
+// Switch to segment mode, must be called after set_frequency
+void StepTicker::enable_segments(float segment_ms)
+{
+    this->segment_ticks = roundf(this->frequency * segment_ms / 1000.0F);
+    if(this->segment_ticks < 1) this->segment_ticks = 1;
+    if(this->segments == nullptr) this->segments = new TSRingBuffer<segment_t, 8>;
+}
+
+// Switch to event driven mode, must be called after set_frequency
+void StepTicker::enable_events()
+{
+    // never sleep for more than 1ms so a new block does not wait long to start
+    this->max_interval = std::max(1.0F, floorf(this->frequency / 1000.0F));
+}
+
+// set how many ticks until the next step interrupt, this is called from the step interrupt just after the
+// match reset the timer so the new match value applies to the next interrupt
+void StepTicker::set_interval(uint32_t ticks)
+{
+    if(ticks != this->interval) {
+        this->interval = ticks;
+        LPC_TIM0->MR0 = this->tick_period * ticks;
+    }
+}
+
+// can be called at any time, even from the serial interrupts, it only stores the target. The step interrupt works out
+// the ramp on its next tick and picks it up within a millisecond
+void StepTicker::set_speed_factor(float factor)
+{
+    if(factor < 0.1F) factor = 0.1F;
+    if(factor > 1.0F) factor = 1.0F;
+    this->speed_target = lroundf(factor * 65536);
+    this->factor_request = true;
+}
+
+void StepTicker::set_speed_ramp(float seconds)
+{
+    this->speed_ramp_step = seconds > 0.001F ? std::max(1L, lroundf(65536 / (seconds * 1000))) : 65536;
+    this->factor_request = true;
+}
+
+// can be called at any time like set_speed_factor(), the ramp is worked out for the block being stepped on the next
+// tick and again as each block starts
+void StepTicker::set_feed_hold(bool hold)
+{
+    this->hold_target = hold ? 0 : 65536;
+    this->factor_request = true;
+}
+
+// The factors slow every block they run into, so the ramps are worked out for the fastest of the blocks still to be
+// stepped, which the planner keeps in each block as max_speed_ahead. From that speed v at acceleration a the speed
+// factor can change by a/v a second, the hold as it multiplies the speed factor s by a/(v*s). Slowed like that any
+// speed below v stops sooner
+void StepTicker::update_factor_steps()
+{
+    uint32_t step = 65536;
+    uint32_t hstep = 65536;
+    const Block *b = get_current_block();
+    if(b != nullptr && b->acceleration > 0) {
+        float v = b->max_speed_ahead;
+        if(v > 0) {
+            step = std::max(1L, std::min(65536L, lroundf(65536 * b->acceleration / v / 1000)));
+            hstep = std::min((uint64_t)65536, ((uint64_t)step << 16) / this->speed_factor);
+        }
+    }
+    this->speed_step = std::min(step, this->speed_ramp_step);
+    this->hold_step = hstep;
+}
+
+// which way the planned profile of the block being stepped is changing its speed, 1 accelerating, -1 decelerating
+int8_t StepTicker::profile_direction() const
+{
+    if(!running) return 0;
+    if(segments != nullptr) {
+        if(segment.block == nullptr) return 0;
+        return segment.decelerating ? -1 : segment.accelerating ? 1 : 0;
+    }
+    if(current_tick < current_block->accelerate_until) return 1;
+    return current_tick > current_block->decelerate_after ? -1 : 0;
+}
+
+// the XYZ motors have taken up the backlash the block has once it starts
+void StepTicker::set_backlash(const Block *b)
+{
+    for (uint8_t m = 0; m < 3 && m < num_motors; m++) motor[m]->set_backlash(b->backlash[m]);
+}
+
+// one millisecond of a factor's ramp to its target, profile and f2 as worked out in update_speed_factor()
+static uint32_t ramp_factor(uint32_t factor, uint32_t target, uint32_t step, int8_t profile, uint32_t f2)
+{
+    if(factor == target) return factor;
+    if(profile != 0) {
+        if((target > factor) == (profile > 0)) step = ((uint64_t)step * (65536 - f2)) >> 16;
+        else step = std::min((uint64_t)65536, ((uint64_t)step * (65536 + f2)) >> 16);
+    }
+    if(target > factor) return std::min(target, factor + step);
+    return (factor - target > step) ? factor - step : target;
+}
+
+// called from the step interrupt just after the match reset the timer, moves the speed and hold factors toward their
+// targets once a millisecond and changes the timer period to match
+void StepTicker::update_speed_factor()
+{
+    // the ticks get longer as it slows down so this counts the timer
+    this->speed_ms_counts += this->tick_period * this->interval;
+    if(this->speed_ms_counts < SystemCoreClock / 4000) return;
+    this->speed_ms_counts = 0;
+
+    // the block's own profile changes the speed too, by f² of its acceleration at factor f. A factor moves that much
+    // slower where the two go the same way so together they stay within the acceleration, faster otherwise
+    int8_t profile = profile_direction();
+    uint32_t f = ((uint64_t)this->speed_factor * this->hold_factor) >> 16;
+    uint32_t f2 = ((uint64_t)f * f) >> 16;
+    this->speed_factor = ramp_factor(this->speed_factor, this->speed_target, this->speed_step, profile, f2);
+    uint32_t hold = this->hold_target;
+    this->hold_factor = ramp_factor(this->hold_factor, hold, this->hold_step, profile, f2);
+
+    uint32_t factor = ((uint64_t)this->speed_factor * this->hold_factor) >> 16;
+    if(factor < 1024) {
+        // below 1/64 of the speed it stops, the interrupt then just comes back every millisecond until the hold is released
+        if(hold == 0) this->hold_factor = 0;
+        this->hold_stopped = true;
+        this->interval = 1;
+        this->tick_period = SystemCoreClock / 4000;
+    } else {
+        this->hold_stopped = false;
+        this->tick_period = ((uint64_t)this->period << 16) / factor;
+    }
+    LPC_TIM0->MR0 = this->tick_period * this->interval;
+}
+
+// only called from the step tick ISR while held, the motors are at rest part way through the block
+void StepTicker::drop_block()
+{
+    drop_held= false;
+    for (uint8_t m = 0; m < num_motors; m++) motor[m]->stop_moving();
+    running= false;
+    current_tick= 0;
+    pending.reset();
+    pending_steps.fill(0);
+
+    if(segments != nullptr) {
+        // current_block belongs to prepare_segments()
+        skip_block= false;
+        stepping_block= nullptr;
+        drop_prepared= true;
+        pend_prepare();
+
+    } else {
+        // the conveyor is flushing so this releases the block along with everything after it
+        current_block= nullptr;
+        Block *b;
+        THECONVEYOR->get_next_block(&b);
+    }
+}
+
 // Set the reset delay, must be called after set_frequency
 void StepTicker::set_unstep_time( float microseconds )
 {
     uint32_t delay = floorf((SystemCoreClock / 4.0F) * (microseconds / 1000000.0F)); // SystemCoreClock/4 = Timer increments in a second
     LPC_TIM1->MR0 = delay;
+    this->unstep_delay = delay;
 
     // TODO check that the unstep time is less than the step period, if not slow down step ticker
 }
 
+// Shape one of the first two actuators, only called when idle so nothing is being prepared
+bool StepTicker::set_input_shaper(uint8_t m, InputShaper::TYPE type, float frequency, float damping)
+{
+    if(m >= shapers.size()) return false;
+
+    InputShaper *s= nullptr;
+    if(type != InputShaper::NONE) {
+        s= new InputShaper();
+        if(!s->configure(type, frequency, damping, this->frequency)) {
+            delete s;
+            return false;
+        }
+        // the shaper works on the segments
+        if(this->segments == nullptr) enable_segments(1.0F);
+        s->reset(shaper_tick, shaper_input[m]);
+    }
+
+    delete shapers[m];
+    shapers[m]= s;
+    shaper_output[m]= shaper_input[m];
+    return true;
+}
+
+// Enable multi stepping, must be called after set_frequency and set_unstep_time
+void StepTicker::enable_multistep(uint8_t max_multiplier, float threshold)
+{
+    uint8_t m = max_multiplier >= 4 ? 4 : max_multiplier >= 2 ? 2 : 1;
+    // every pulse needs a high and a low time of one pulse width and they all have to be done before the next tick
+    while(m > 1 && 2 * m * this->unstep_delay >= this->period) m /= 2;
+    this->multistep_max = m;
+    this->multistep_threshold = threshold;
+}
+
+uint8_t StepTicker::get_step_multiplier(float steps_per_second) const
+{
+    // the segment DDA issues at most one step per tick
+    if(segments != nullptr || multistep_max == 1 || steps_per_second <= multistep_threshold) return 1;
+    // it always has to be below one step per tick
+    if(multistep_max == 4 && (steps_per_second > multistep_threshold * 2 || steps_per_second >= frequency * 2)) return 4;
+    return 2;
+}
+
+void StepTicker::restart_unstep_timer()
+{
+    LPC_TIM1->TCR = 3;
+    LPC_TIM1->TCR = 1;
+}
+
 // Reset step pins on any motor that was stepped
 void StepTicker::unstep_tick()
 {
+    if(this->pulse_gap) {
+        // the low time is over, pulse every motor that still has steps due this tick
+        this->pulse_gap = false;
+        for (int i = 0; i < num_motors; i++) {
+            if(this->pending[i]) {
+                this->motor[i]->step();
+                this->unstep.set(i);
+                if(--this->pending_steps[i] == 0) this->pending.reset(i);
+            }
+        }
+        restart_unstep_timer();
+        return;
+    }
+
     for (int i = 0; i < num_motors; i++) {
         if(this->unstep[i]) {
             this->motor[i]->unstep();
         }
     }
     this->unstep.reset();
+
+    if(this->pending.any()) {
+        // time the low time before the next pulse of a multi step tick
+        this->pulse_gap = true;
+        restart_unstep_timer();
+    }
 }
 
 extern "C" void TIMER1_IRQHandler (void)
@@ -118,8 +358,10 @@ extern "C" void TIMER0_IRQHandler (void)
     StepTicker::getInstance()->step_tick();
 }
 
+// in segment mode this is pended by the step interrupt whenever there is room in the segment buffer
 extern "C" void PendSV_Handler(void)
 {
+    StepTicker::getInstance()->prepare_segments();
     StepTicker::getInstance()->handle_finish();
 }
 
@@ -135,13 +377,31 @@ void StepTicker::step_tick (void)
 {
     //SET_STEPTICKER_DEBUG_PIN(running ? 1 : 0);
 
+    // the ramps are only worked out here so nothing else writes them while the queue is walked
+    if(factor_request) {
+        factor_request= false;
+        update_factor_steps();
+    }
+    if(speed_factor != speed_target || hold_factor != hold_target) update_speed_factor();
+    // held, a halt still has to be seen to drop the block
+    if(hold_stopped && !THEKERNEL->is_halted()) {
+        if(drop_held) drop_block();
+        return;
+    }
+
+    if(segments != nullptr) {
+        segment_tick();
+        return;
+    }
+
     // if nothing has been setup we ignore the ticks
     if(!running){
         // check if anything new available
         if(THECONVEYOR->get_next_block(&current_block)) { // returns false if no new block is available
             running= start_next_block(); // returns true if there is at least one motor with steps to issue
-            if(!running) return;
-        }else{
+        }
+        if(!running) {
+            if(max_interval > 1) set_interval(max_interval); // just poll the queue
             return;
         }
     }
@@ -150,59 +410,125 @@ void StepTicker::step_tick (void)
         running= false;
         current_tick = 0;
         current_block= nullptr;
+        pending.reset();
+        pending_steps.fill(0);
+        if(max_interval > 1) set_interval(max_interval);
         return;
     }
 
+    // for S-curve blocks work out if the acceleration is ramping this tick, this is the same for all motors
+    int8_t jerk_dir= 0;
+    bool jerk_decel= false;
+    if(current_block->s_curve) {
+        if(current_tick < current_block->accelerate_until) {
+            if(current_tick < current_block->accel_jerk_ticks) jerk_dir= 1;
+            else if(current_tick >= current_block->accelerate_until - current_block->accel_jerk_ticks) jerk_dir= -1;
+
+        } else if(current_tick > current_block->decelerate_after) {
+            // deceleration takes effect the tick after decelerate_after
+            uint32_t t= current_tick - current_block->decelerate_after;
+            jerk_decel= true;
+            if(t <= current_block->decel_jerk_ticks) jerk_dir= -1;
+            else if(t > current_block->total_move_ticks - current_block->decelerate_after - current_block->decel_jerk_ticks) jerk_dir= 1;
+        }
+    }
+
     bool still_moving= false;
     // foreach motor, if it is active see if time to issue a step to that motor
     for (uint8_t m = 0; m < num_motors; m++) {
-        if(current_block->tick_info[m].steps_to_move == 0) continue; // not active
-
-        current_block->tick_info[m].steps_per_tick += current_block->tick_info[m].acceleration_change;
-
-        if(current_tick == current_block->tick_info[m].next_accel_event) {
-            if(current_tick == current_block->accelerate_until) { // We are done accelerating, deceleration becomes 0 : plateau
-                current_block->tick_info[m].acceleration_change = 0;
-                if(current_block->decelerate_after < current_block->total_move_ticks) {
-                    current_block->tick_info[m].next_accel_event = current_block->decelerate_after;
-                    if(current_tick != current_block->decelerate_after) { // We are plateauing
-                        // steps/sec / tick frequency to get steps per tick
-                        current_block->tick_info[m].steps_per_tick = current_block->tick_info[m].plateau_rate;
+        if(tick_info[m].steps_to_move == 0) continue; // not active
+
+        if(current_block->advance && (tick_info[m].advance_accel != 0 || tick_info[m].advance_decel != 0)) {
+            // an extruder with pressure advance, it can step backwards so it keeps a net step count
+            tickinfo_t &ti= tick_info[m];
+            int8_t dir= tick_advance(m);
+            bool ismoving= true;
+            if(dir != 0) {
+                bool d= current_block->direction_bits[m] != (dir < 0);
+                if(motor[m]->which_direction() != d) motor[m]->set_direction(d);
+                ismoving= motor[m]->step();
+                unstep.set(m);
+                ti.step_count += dir;
+            }
+
+            // done once the block has run all its ticks and the net steps are where pressure advance put them
+            if(!ismoving || (current_tick + 1 >= current_block->total_move_ticks && (int32_t)ti.step_count == (int32_t)ti.steps_to_move + ti.advance_steps)) {
+                ti.steps_to_move = 0;
+                motor[m]->stop_moving();
+            }
+
+            if(motor[m]->is_moving()) still_moving= true;
+            continue;
+        }
+
+        bool step_due;
+        if(current_block->fp32) {
+            step_due= tick_fp32(m);
+
+        } else {
+            if(jerk_dir != 0) {
+                int64_t jerk= jerk_decel ? tick_info[m].decel_jerk : tick_info[m].accel_jerk;
+                tick_info[m].acceleration_change += (jerk_dir > 0) ? jerk : -jerk;
+            }
+
+            tick_info[m].steps_per_tick += tick_info[m].acceleration_change;
+
+            if(current_tick == tick_info[m].next_accel_event) {
+                if(current_tick == current_block->accelerate_until) { // We are done accelerating, deceleration becomes 0 : plateau
+                    tick_info[m].acceleration_change = 0;
+                    if(current_block->decelerate_after < current_block->total_move_ticks) {
+                        tick_info[m].next_accel_event = current_block->decelerate_after;
+                        if(current_tick != current_block->decelerate_after) { // We are plateauing
+                            // steps/sec / tick frequency to get steps per tick
+                            tick_info[m].steps_per_tick = tick_info[m].plateau_rate;
+                        }
                     }
                 }
+
+                if(current_tick == current_block->decelerate_after) { // We start decelerating
+                    tick_info[m].acceleration_change = tick_info[m].deceleration_change;
+                }
             }
 
-            if(current_tick == current_block->decelerate_after) { // We start decelerating
-                current_block->tick_info[m].acceleration_change = current_block->tick_info[m].deceleration_change;
+            // protect against rounding errors and such
+            if(tick_info[m].steps_per_tick <= 0) {
+                tick_info[m].counter = STEPTICKER_FPSCALE; // we force completion this step by setting to 1.0
+                tick_info[m].steps_per_tick = 0;
             }
-        }
 
-        // protect against rounding errors and such
-        if(current_block->tick_info[m].steps_per_tick <= 0) {
-            current_block->tick_info[m].counter = STEPTICKER_FPSCALE; // we force completion this step by setting to 1.0
-            current_block->tick_info[m].steps_per_tick = 0;
-        }
+            tick_info[m].counter += tick_info[m].steps_per_tick;
 
-        current_block->tick_info[m].counter += current_block->tick_info[m].steps_per_tick;
+            step_due= tick_info[m].counter >= STEPTICKER_FPSCALE; // >= 1.0 step time
+            if(step_due) tick_info[m].counter -= STEPTICKER_FPSCALE; // -= 1.0F;
+        }
 
-        if(current_block->tick_info[m].counter >= STEPTICKER_FPSCALE) { // >= 1.0 step time
-            current_block->tick_info[m].counter -= STEPTICKER_FPSCALE; // -= 1.0F;
-            ++current_block->tick_info[m].step_count;
+        if(step_due) {
+            // multi step blocks issue step_multiplier steps for each DDA step, apart from the remainder at the end
+            uint32_t n= current_block->step_multiplier;
+            uint32_t remaining= tick_info[m].steps_to_move - tick_info[m].step_count;
+            if(n > remaining) n= remaining;
+            tick_info[m].step_count += n;
 
             // step the motor
             bool ismoving= motor[m]->step(); // returns false if the moving flag was set to false externally (probes, endstops etc)
             // we stepped so schedule an unstep
             unstep.set(m);
 
-            if(!ismoving || current_block->tick_info[m].step_count == current_block->tick_info[m].steps_to_move) {
+            // the rest are pulsed by the unstep timer before the next tick
+            if(n > 1 && ismoving) {
+                pending_steps[m] += n - 1;
+                pending.set(m);
+            }
+
+            if(!ismoving || tick_info[m].step_count == tick_info[m].steps_to_move) {
                 // done
-                current_block->tick_info[m].steps_to_move = 0;
+                tick_info[m].steps_to_move = 0;
                 motor[m]->stop_moving(); // let motor know it is no longer moving
             }
         }
 
-        // see if any motors are still moving after this tick
-        if(motor[m]->is_moving()) still_moving= true;
+        // see if any motors are still moving after this tick, the block is not done until the last pulses are out
+        if(motor[m]->is_moving() || pending[m]) still_moving= true;
     }
 
     // do this after so we start at tick 0
@@ -213,8 +539,7 @@ void StepTicker::step_tick (void)
     // right now it takes about 3-4us but if the unstep were near 10uS or greater it would be an issue
     // also it takes at least 2us to get here so even when set to 1us pulse width it will still be about 3us
     if( unstep.any()) {
-        LPC_TIM1->TCR = 3;
-        LPC_TIM1->TCR = 1;
+        restart_unstep_timer();
     }
 
 
@@ -242,6 +567,227 @@ void StepTicker::step_tick (void)
         //NVIC_SetPendingIRQ(PendSV_IRQn); this doesn't work
         //SCB->ICSR = 0x10000000; // SCB_ICSR_PENDSVSET_Msk;
     }
+
+    if(max_interval > 1) schedule_next_tick();
+}
+
+// Number of the coming ticks (at most n) that are certain not to step a motor whose DDA is at the given counter,
+// rate and acceleration per tick, in any fixed point scale where one is 1.0 step
+static uint32_t ticks_without_step(int64_t one, int64_t counter, int64_t steps_per_tick, int64_t acceleration_change, uint32_t n)
+{
+    int64_t room= one - 1 - counter;
+    int64_t fastest= steps_per_tick;
+    if(acceleration_change > 0) {
+        // the rate at the end of the skipped ticks is the fastest
+        fastest += acceleration_change * n;
+
+    } else if(acceleration_change < 0) {
+        // the rate has to stay positive, otherwise the tick forces the last step
+        int64_t positive= (steps_per_tick - 1) / -acceleration_change;
+        if(positive < n) n= positive > 0 ? positive : 0;
+    }
+
+    if(fastest > 0 && room / fastest < n) n= room / fastest;
+    return n;
+}
+
+// Event driven mode, skip the ticks on which no motor can step and the acceleration does not change.
+// The DDA is moved over them in one go, which gives exactly the same counters as ticking them one by one:
+// after n ticks the rate has gone up by n*a and the counter by n*rate + a*n*(n+1)/2
+void StepTicker::schedule_next_tick()
+{
+    uint32_t n= max_interval - 1;
+    // S-curve blocks change the acceleration every tick, pressure advance can run an extruder backwards
+    // and the ticks are not skipped while a feed hold is ramping
+    if(!running || current_block->s_curve || current_block->advance || hold_factor != hold_target) n= 0;
+
+    for (uint8_t m = 0; m < num_motors && n > 0; m++) {
+        tickinfo_t &ti= tick_info[m];
+        if(ti.steps_to_move == 0) continue;
+
+        // the acceleration change events have to be ticked
+        if(ti.next_accel_event >= current_tick && ti.next_accel_event - current_tick < n) n= ti.next_accel_event - current_tick;
+
+        if(current_block->fp32) {
+            n= ticks_without_step(STEPTICKER_FPSCALE32, ti.counter32, ti.steps_per_tick32, ti.acceleration_change32, n);
+        } else {
+            n= ticks_without_step(STEPTICKER_FPSCALE, ti.counter, ti.steps_per_tick, ti.acceleration_change, n);
+        }
+    }
+
+    if(n > 0) {
+        int64_t tri= (int64_t)n * (n + 1) / 2;
+        for (uint8_t m = 0; m < num_motors; m++) {
+            tickinfo_t &ti= tick_info[m];
+            if(ti.steps_to_move == 0) continue;
+
+            if(current_block->fp32) {
+                ti.counter32 += (int64_t)ti.steps_per_tick32 * n + (int64_t)ti.acceleration_change32 * tri;
+                ti.steps_per_tick32 += ti.acceleration_change32 * (int32_t)n;
+            } else {
+                ti.counter += ti.steps_per_tick * n + ti.acceleration_change * tri;
+                ti.steps_per_tick += ti.acceleration_change * n;
+            }
+        }
+        current_tick += n;
+    }
+
+    set_interval(n + 1);
+}
+
+// The 2.62 update in step_tick() for an extruder with pressure advance. The rate has K times the acceleration added while
+// accelerating and K times the deceleration taken away while decelerating, so it can go negative and the counter is signed,
+// a step forwards is due when it reaches 1.0 and one backwards when it reaches -1.0. After the last tick of the block any
+// step left over from rounding is issued. returns 1 or -1 for the direction of a step that is due, 0 for none
+int8_t StepTicker::tick_advance(uint8_t m)
+{
+    tickinfo_t &ti= tick_info[m];
+
+    if(current_tick >= current_block->total_move_ticks) {
+        int32_t left= (int32_t)ti.steps_to_move + ti.advance_steps - (int32_t)ti.step_count;
+        return (left > 0) ? 1 : (left < 0) ? -1 : 0;
+    }
+
+    ti.steps_per_tick += ti.acceleration_change;
+
+    if(current_tick == ti.next_accel_event) {
+        if(current_tick == current_block->accelerate_until) { // plateau, the advance offset goes
+            ti.acceleration_change = 0;
+            ti.steps_per_tick -= ti.advance_accel;
+            if(current_block->decelerate_after < current_block->total_move_ticks) {
+                ti.next_accel_event = current_block->decelerate_after;
+                if(current_tick != current_block->decelerate_after) {
+                    ti.steps_per_tick = ti.plateau_rate;
+                }
+            }
+        }
+
+        if(current_tick == current_block->decelerate_after) {
+            ti.acceleration_change = ti.deceleration_change;
+            ti.steps_per_tick -= ti.advance_decel;
+        }
+    }
+
+    ti.counter += ti.steps_per_tick;
+
+    if(ti.counter >= STEPTICKER_FPSCALE) {
+        ti.counter -= STEPTICKER_FPSCALE;
+        return 1;
+    }
+    if(ti.counter <= -STEPTICKER_FPSCALE) {
+        ti.counter += STEPTICKER_FPSCALE;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Same as the 2.62 update in step_tick() in 1.31 fixed point, only used for blocks that prepare() found fit,
+// the whole update is done in 32 bit registers. returns true if the motor is due a step
+inline bool StepTicker::tick_fp32(uint8_t m)
+{
+    tickinfo_t &ti= tick_info[m];
+
+    ti.steps_per_tick32 += ti.acceleration_change32;
+
+    if(current_tick == ti.next_accel_event) {
+        if(current_tick == current_block->accelerate_until) { // plateau
+            ti.acceleration_change32 = 0;
+            if(current_block->decelerate_after < current_block->total_move_ticks) {
+                ti.next_accel_event = current_block->decelerate_after;
+                if(current_tick != current_block->decelerate_after) {
+                    ti.steps_per_tick32 = ti.plateau_rate32;
+                }
+            }
+        }
+
+        if(current_tick == current_block->decelerate_after) {
+            ti.acceleration_change32 = ti.deceleration_change32;
+        }
+    }
+
+    if(ti.steps_per_tick32 <= 0) {
+        ti.counter32 = STEPTICKER_FPSCALE32; // force completion
+        ti.steps_per_tick32 = 0;
+    }
+
+    // counter is below 1.0 and the rate is below 1.0 so this can not overflow
+    ti.counter32 += ti.steps_per_tick32;
+
+    if(ti.counter32 >= STEPTICKER_FPSCALE32) {
+        ti.counter32 -= STEPTICKER_FPSCALE32;
+        return true;
+    }
+
+    return false;
+}
+
+// round a 2.62 fixed point value to 1.31
+static inline int32_t fp62_to_fp31(int64_t v)
+{
+    return (int32_t)((v + (1LL << 30)) >> 31);
+}
+
+// the 2.62 fixed point value of one kept in a tickplan_t
+static inline int64_t from_plan(int32_t v, uint8_t shift)
+{
+    return (int64_t)((uint64_t)(int64_t)v << shift);
+}
+
+// set up each motor to step current_block from the plan Block::prepare() made
+void StepTicker::load_tick_info()
+{
+    // the first acceleration event is the end of the acceleration, or the start of the deceleration if there is none
+    uint32_t next_accel_event= current_block->total_move_ticks + 1;
+    if(current_block->accelerate_until != 0) {
+        next_accel_event= current_block->accelerate_until;
+    } else if(current_block->decelerate_after != 0 && current_block->decelerate_after != current_block->total_move_ticks) {
+        next_accel_event= current_block->decelerate_after;
+    }
+
+    for (uint8_t m = 0; m < num_motors; m++) {
+        const Block::tickplan_t &tp= current_block->tick_plan[m];
+        tickinfo_t &ti= tick_info[m];
+        ti.steps_to_move= tp.steps_to_move;
+        ti.step_count= 0;
+        ti.next_accel_event= next_accel_event;
+        ti.advance_steps= tp.advance_steps;
+        if(tp.steps_to_move == 0) continue;
+
+        int64_t steps_per_tick= from_plan(tp.steps_per_tick, current_block->tick_shift.rate);
+        int64_t plateau_rate= from_plan(tp.plateau_rate, current_block->tick_shift.rate);
+        int64_t acceleration_change= from_plan(tp.acceleration_change, current_block->tick_shift.acceleration);
+        int64_t deceleration_change= from_plan(tp.deceleration_change, current_block->tick_shift.acceleration);
+        if(current_block->fp32) {
+            ti.steps_per_tick32= fp62_to_fp31(steps_per_tick);
+            ti.counter32= 0;
+            ti.acceleration_change32= fp62_to_fp31(acceleration_change);
+            ti.deceleration_change32= fp62_to_fp31(deceleration_change);
+            ti.plateau_rate32= fp62_to_fp31(plateau_rate);
+
+        } else {
+            ti.steps_per_tick= steps_per_tick;
+            ti.counter= 0;
+            ti.acceleration_change= acceleration_change;
+            ti.deceleration_change= deceleration_change;
+            ti.plateau_rate= plateau_rate;
+            ti.accel_jerk= from_plan(tp.accel_jerk, current_block->tick_shift.jerk);
+            ti.decel_jerk= from_plan(tp.decel_jerk, current_block->tick_shift.jerk);
+        }
+    }
+}
+
+// returns current rate (steps/sec) for the given motor
+float StepTicker::get_trapezoid_rate(uint8_t m) const
+{
+    // FIXME the rate can change at any time, potential race condition if it changes while being read here
+    if(segments != nullptr) {
+        return (running && segment.ticks > 0) ? (float)segment.steps[m] * frequency / segment.ticks : 0;
+    }
+    if(current_block == nullptr) return 0;
+    // convert steps per tick from fixed point to float and convert to steps/sec
+    if(current_block->fp32) return STEPTICKER_FROMFP32(tick_info[m].steps_per_tick32) * frequency * current_block->step_multiplier;
+    return STEPTICKER_FROMFP(tick_info[m].steps_per_tick) * frequency * current_block->step_multiplier;
 }
 
 // only called from the step tick ISR (single consumer)
@@ -249,10 +795,12 @@ bool StepTicker::start_next_block()
 {
     if(current_block == nullptr) return false;
 
+    load_tick_info();
+
     bool ok= false;
     // need to prepare each active motor
     for (uint8_t m = 0; m < num_motors; m++) {
-        if(current_block->tick_info[m].steps_to_move == 0) continue;
+        if(tick_info[m].steps_to_move == 0) continue;
 
         ok= true; // mark at least one motor is moving
         // set direction bit here
@@ -263,6 +811,8 @@ bool StepTicker::start_next_block()
     }
 
     current_tick= 0;
+    set_backlash(current_block);
+    if(hold_factor != 65536 || hold_target != 65536 || speed_factor != speed_target) update_factor_steps();
 
     if(ok) {
         //SET_STEPTICKER_DEBUG_PIN(1);
@@ -278,6 +828,280 @@ bool StepTicker::start_next_block()
 }
 
 
+// runs at PendSV priority so it can be interrupted by the step ticks, the step interrupt is the only consumer
+void StepTicker::pend_prepare()
+{
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
+
+// only called from the step tick ISR, prepare_segments() has room in the ring and a block, or the rest of one, to cut
+// up or shaped motors to bring to rest
+bool StepTicker::prepare_wanted() const
+{
+    return !segments->full() && (current_block != nullptr || THECONVEYOR->has_next_block() || !shapers_settled());
+}
+
+// segment mode step clock, each motor steps evenly over the segment with no per tick acceleration math
+void StepTicker::segment_tick()
+{
+    if(THEKERNEL->is_halted()) {
+        // prepare_segments() throws the rest away, once
+        if(running || stepping_block != nullptr || current_block != nullptr || !segments->empty()) pend_prepare();
+        running= false;
+        skip_block= false;
+        stepping_block= nullptr;
+        return;
+    }
+
+    if(!running) {
+        if(!start_next_segment()) {
+            // idle, only wake prepare_segments() when a block has come in for it
+            if(prepare_wanted()) pend_prepare();
+            return;
+        }
+    }
+
+    for (uint8_t m = 0; m < num_motors; m++) {
+        if(segment.steps[m] == 0 || !segment_active[m]) continue;
+
+        segment_counter[m] += segment.steps[m];
+        if(segment_counter[m] >= segment.ticks) {
+            segment_counter[m] -= segment.ticks;
+
+            // returns false if the moving flag was set to false externally (probes, endstops etc)
+            if(!motor[m]->step()) segment_active.reset(m);
+            unstep.set(m);
+        }
+    }
+
+    ++segment_tick_count;
+
+    // We may have set a pin on in this tick, now we reset the timer to set it off
+    if( unstep.any()) {
+        restart_unstep_timer();
+    }
+
+    // all the motors were stopped externally, the block ends here as it would in the normal mode
+    bool stopped= (segment.block_motors & segment_active).none();
+    if(stopped && !segment.last) {
+        skip_block= true;
+        shaper_reset= true;
+    }
+
+    if(segment_tick_count >= segment.ticks || stopped) {
+        if(segment.last || stopped) {
+            for (uint8_t m = 0; m < num_motors; m++) {
+                if(segment.block_motors[m]) motor[m]->stop_moving();
+            }
+            // the conveyor can let the block go now
+            stepping_block= nullptr;
+        }
+
+        // the next segment is started on the next tick so there is no gap
+        running= false;
+        pend_prepare();
+    }
+}
+
+// only called from the step tick ISR
+bool StepTicker::start_next_segment()
+{
+    while(segments->get(segment)) {
+        if(skip_block) {
+            // drop what is left of a block whose motors were all stopped
+            if(!segment.first) {
+                if(segment.last) skip_block= false;
+                continue;
+            }
+            skip_block= false;
+        }
+
+        if(segment.first) {
+            if(segment.block != nullptr) set_backlash(segment.block);
+            segment_active= segment.block_motors;
+            for (uint8_t m = 0; m < num_motors; m++) {
+                if(!segment.block_motors[m]) continue;
+                motor[m]->set_direction(segment.direction_bits[m]);
+                motor[m]->start_moving();
+            }
+        }
+
+        // shaped motors can change direction within a block
+        for (uint8_t m = 0; m < shapers.size() && m < num_motors; m++) {
+            if(shapers[m] != nullptr && segment.steps[m] > 0) motor[m]->set_direction(segment.direction_bits[m]);
+        }
+
+        stepping_block= segment.block;
+        if(segment.first && segment.block != nullptr && (hold_factor != 65536 || hold_target != 65536 || speed_factor != speed_target)) {
+            update_factor_steps();
+        }
+        segment_counter.fill(segment.ticks / 2); // centres the steps in the segment
+        segment_tick_count= 0;
+        running= true;
+        return true;
+    }
+
+    return false;
+}
+
+// Cut the blocks from the conveyor into segments until the segment buffer is full.
+// Called from PendSV so it only ever runs between step ticks, and is the only producer
+void StepTicker::prepare_segments()
+{
+    if(segments == nullptr) return;
+
+    if(THEKERNEL->is_halted() || drop_prepared) {
+        // the step interrupt has stopped, throw away everything prepared and let the conveyor flush the queue
+        drop_prepared= false;
+        segment_t s;
+        while(segments->get(s)) ;
+        current_block= nullptr;
+        Block *b;
+        THECONVEYOR->get_next_block(&b);
+        reset_shapers();
+        return;
+    }
+
+    if(shaper_reset) {
+        // segments were dropped so the shaped positions no longer match the motors
+        shaper_reset= false;
+        reset_shapers();
+    }
+
+    while(!segments->full()) {
+        if(current_block == nullptr) {
+            if(!THECONVEYOR->get_next_block(&current_block)) { // returns false if no new block is available
+                current_block= nullptr;
+                if(shapers_settled()) return;
+
+                // no more blocks but the shaped motors have not caught up yet, keep going with nothing commanded
+                segment_t s;
+                s.ticks= segment_ticks;
+                s.steps.fill(0);
+                s.direction_bits.reset();
+                s.first= !shaper_tail;
+                if(s.first) {
+                    prepared_motors.reset();
+                    for (uint8_t m = 0; m < shapers.size(); m++) {
+                        if(shaper_moving(m)) prepared_motors.set(m);
+                    }
+                }
+                s.block_motors= prepared_motors;
+                s.block= nullptr;
+                s.accelerating= false;
+                s.decelerating= false;
+                shape_segment(s);
+                s.last= shapers_settled();
+                shaper_tail= !s.last;
+                segments->put(s);
+                continue;
+            }
+
+            if(current_block->steps_event_count == 0) {
+                // same edge condition as start_next_block()
+                current_block= nullptr;
+                THECONVEYOR->block_finished();
+                continue;
+            }
+
+            // scale the profile so it ends exactly on the step count, the tick rounding leaves it a little out
+            float total= current_block->steps_at(current_block->total_move_ticks);
+            prepared_scale= total > 0 ? current_block->steps_event_count / total : 1.0F;
+            prepared_ticks= 0;
+            prepared_steps.fill(0);
+
+            // the shaped motors move in this block if they are still catching up with the earlier ones
+            shaper_tail= false;
+            prepared_motors.reset();
+            for (uint8_t m = 0; m < num_motors; m++) {
+                if(current_block->steps[m] > 0 || (m < shapers.size() && shaper_moving(m))) prepared_motors.set(m);
+            }
+        }
+
+        segment_t s;
+        uint32_t end= prepared_ticks + segment_ticks;
+        bool at_end= end >= current_block->total_move_ticks;
+        s.ticks= (at_end && prepared_ticks < current_block->total_move_ticks) ? current_block->total_move_ticks - prepared_ticks : segment_ticks;
+        s.direction_bits= current_block->direction_bits;
+        s.first= prepared_ticks == 0;
+        s.last= true;
+        s.accelerating= prepared_ticks < current_block->accelerate_until;
+        s.decelerating= end > current_block->decelerate_after;
+        s.block_motors= prepared_motors;
+        s.block= current_block;
+
+        float position= current_block->steps_at(end) * prepared_scale;
+        for (uint8_t m = 0; m < num_motors; m++) {
+            uint32_t steps= current_block->steps[m];
+            s.steps[m]= 0;
+            if(steps == 0) continue;
+
+            uint32_t target= at_end ? steps : std::min(steps, (uint32_t)(position * steps / current_block->steps_event_count));
+            if(target > prepared_steps[m]) {
+                // at most one step per tick, anything left over is carried into the next segment
+                s.steps[m]= std::min(target - prepared_steps[m], s.ticks);
+                prepared_steps[m] += s.steps[m];
+            }
+            if(prepared_steps[m] < steps) s.last= false;
+        }
+
+        shape_segment(s);
+        segments->put(s);
+        prepared_ticks= end;
+
+        if(s.last) {
+            // everything the step interrupt needs is in the segments, so prepare_segments() can go on to the next one.
+            // The conveyor keeps the block while it is being stepped, see Conveyor::on_idle()
+            current_block= nullptr;
+            THECONVEYOR->block_finished();
+        }
+    }
+}
+
+// true if the shaped motor has not caught up with its commanded position
+bool StepTicker::shaper_moving(uint8_t m) const
+{
+    return shapers[m] != nullptr && (!shapers[m]->is_settled() || shaper_output[m] != shaper_input[m]);
+}
+
+bool StepTicker::shapers_settled() const
+{
+    for (uint8_t m = 0; m < shapers.size(); m++) {
+        if(shaper_moving(m)) return false;
+    }
+    return true;
+}
+
+// the motors are where the shapers think they are, start shaping from there
+void StepTicker::reset_shapers()
+{
+    for (uint8_t m = 0; m < shapers.size(); m++) {
+        shaper_output[m]= shaper_input[m];
+        if(shapers[m] != nullptr) shapers[m]->reset(shaper_tick, shaper_input[m]);
+    }
+    shaper_tail= false;
+}
+
+// Replace the steps of the shaped motors in a segment with the shaped motion. The shaped position is rounded to
+// whole steps, anything over one step per tick is carried into the following segments
+void StepTicker::shape_segment(segment_t &s)
+{
+    shaper_tick += s.ticks;
+    for (uint8_t m = 0; m < shapers.size(); m++) {
+        if(shapers[m] == nullptr) continue;
+
+        shaper_input[m] += s.direction_bits[m] ? -(int32_t)s.steps[m] : (int32_t)s.steps[m];
+        int32_t delta= shapers[m]->shape(shaper_tick, shaper_input[m]) - shaper_output[m];
+        int32_t limit= s.ticks;
+        if(delta > limit) delta= limit;
+        else if(delta < -limit) delta= -limit;
+
+        shaper_output[m] += delta;
+        s.steps[m]= abs(delta);
+        s.direction_bits[m]= delta < 0;
+    }
+}
+
 // returns index of the stepper motor in the array and bitset
 int StepTicker::register_motor(StepperMotor* m)
 {
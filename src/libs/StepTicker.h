@@ -17,6 +17,7 @@
 
 #include "ActuatorCoordinates.h"
 #include "TSRingBuffer.h"
+#include "InputShaper.h"
 
 class StepperMotor;
 class Block;
@@ -24,6 +25,9 @@ class Block;
 // handle 2.62 Fixed point
 #define STEPTICKER_FPSCALE (1LL<<62)
 #define STEPTICKER_FROMFP(x) ((float)(x)/STEPTICKER_FPSCALE)
+// and 1.31 fixed point for blocks that fit
+#define STEPTICKER_FPSCALE32 (1UL<<31)
+#define STEPTICKER_FROMFP32(x) ((float)(x)/STEPTICKER_FPSCALE32)
 
 class StepTicker{
     public:
@@ -33,13 +37,102 @@ class StepTicker{
         void set_unstep_time( float microseconds );
         int register_motor(StepperMotor* motor);
         float get_frequency() const { return frequency; }
+        // timer counts per tick
+        uint32_t get_period() const { return period; }
         void unstep_tick();
-        const Block *get_current_block() const { return current_block; }
+        // the block being stepped, in segment mode the one the segment being stepped was cut from
+        const Block *get_current_block() const { return segments != nullptr ? stepping_block : current_block; }
+        // rate in steps/sec the given motor is stepping at now
+        float get_trapezoid_rate(uint8_t m) const;
+
+        // this is the data needed to determine when each motor needs to be issued a step, loaded from the block's
+        // tick_plan when it starts
+        using tickinfo_t= struct {
+            union {
+                struct {
+                    int64_t steps_per_tick; // 2.62 fixed point
+                    int64_t counter; // 2.62 fixed point
+                    int64_t acceleration_change; // 2.62 fixed point signed
+                    int64_t deceleration_change; // 2.62 fixed point
+                    int64_t plateau_rate; // 2.62 fixed point
+                    // S-curve blocks use these for the jerk, pressure advance blocks (never S-curve) for the rate offsets
+                    union {
+                        int64_t accel_jerk; // 2.62 fixed point, S-curve only
+                        int64_t advance_accel; // 2.62 fixed point, rate added while accelerating
+                    };
+                    union {
+                        int64_t decel_jerk; // 2.62 fixed point, S-curve only
+                        int64_t advance_decel; // 2.62 fixed point, rate taken away while decelerating
+                    };
+                };
+                // used instead when the block is fp32
+                struct {
+                    int32_t steps_per_tick32; // 1.31 fixed point
+                    uint32_t counter32; // 1.31 fixed point
+                    int32_t acceleration_change32; // 1.31 fixed point signed
+                    int32_t deceleration_change32; // 1.31 fixed point
+                    int32_t plateau_rate32; // 1.31 fixed point
+                };
+            };
+            uint32_t steps_to_move;
+            uint32_t step_count;
+            uint32_t next_accel_event;
+            int32_t advance_steps; // net steps pressure advance adds to steps_to_move, may be negative
+        };
+        // the state of the given motor for the block being stepped, not used in segment mode
+        const tickinfo_t &get_tick_info(uint8_t m) const { return tick_info[m]; }
 
         void step_tick (void);
         void handle_finish (void);
         void start();
 
+        // cut blocks into constant rate segments of the given length, the step interrupt then only runs the DDA
+        void enable_segments(float segment_ms);
+        bool is_segment_mode() const { return segments != nullptr; }
+        // true while prepared segments have not all been stepped
+        bool has_segments() const { return segments != nullptr && (running || !segments->empty()); }
+        void prepare_segments();
+
+        // shape the motion of actuator 0 or 1 (X and Y on a cartesian), this needs segment mode and switches to it if needed.
+        // returns false if the shaper can not be used, NONE turns shaping off. Only call when idle
+        bool set_input_shaper(uint8_t motor, InputShaper::TYPE type, float frequency, float damping);
+        const InputShaper *get_input_shaper(uint8_t motor) const { return motor < shapers.size() ? shapers[motor] : nullptr; }
+
+        // let blocks faster than threshold steps/sec issue up to max_multiplier (2 or 4) steps per tick, limited by
+        // how many pulses fit in a tick, must be called after set_frequency and set_unstep_time
+        void enable_multistep(uint8_t max_multiplier, float threshold);
+        // steps per tick a block running at the given rate should issue, 1 unless multi stepping is enabled
+        uint8_t get_step_multiplier(float steps_per_second) const;
+        // only interrupt on the ticks where a motor steps or the acceleration changes, must be called after set_frequency
+        void enable_events();
+        bool is_event_driven() const { return max_interval > 1; }
+
+        // realtime feed override, the step timer is slowed so the block being stepped and all the ones after it run at factor
+        // (0.1 to 1) of their planned speed. As everything is slowed the same the speeds at the block junctions still match.
+        // The factor moves to the new one within the acceleration of the block being stepped, and by at most the full
+        // range in the ramp time
+        void set_speed_factor(float factor);
+        void set_speed_ramp(float seconds);
+        // the factor being applied now
+        float get_speed_factor() const { return (float)speed_factor / 65536; }
+
+        // feed hold, slows the timer the same way to a stop within the acceleration of the block being stepped, wherever
+        // in the block that is. Releasing it speeds back up at the same rate and carries on from there, nothing needs
+        // re-planning
+        void set_feed_hold(bool hold);
+        // true once a hold has brought the motors to a stop
+        bool is_held() const { return hold_stopped; }
+        // true from when a hold is asked for, while it slows down and stopped, until it is released
+        bool is_holding() const { return hold_target == 0 || hold_stopped; }
+        // how fast the motors run now as a fraction of their planned speed, the speed factor and the feed hold together
+        float get_time_scale() const { return ((float)speed_factor / 65536) * ((float)hold_factor / 65536); }
+        // throw away the rest of the block a hold has stopped, and any segments prepared from it, so the conveyor can flush
+        // the queue. Does nothing unless held
+        void drop_held_block() { if(hold_stopped) drop_held= true; }
+
+        // fastest rate an actuator can step at
+        float get_max_step_rate() const { return frequency * (segments == nullptr ? multistep_max : 1); }
+
         // whatever setup the block should register this to know when it is done
         std::function<void()> finished_fnc{nullptr};
 
@@ -49,17 +142,101 @@ class StepTicker{
         static StepTicker *instance;
 
         bool start_next_block();
+        void load_tick_info();
+        bool tick_fp32(uint8_t m);
+        int8_t tick_advance(uint8_t m);
+        void segment_tick();
+        bool start_next_segment();
+        void pend_prepare();
+        bool prepare_wanted() const;
+        void restart_unstep_timer();
+        void schedule_next_tick();
+        void set_interval(uint32_t ticks);
+        void update_speed_factor();
+        void update_factor_steps();
+        int8_t profile_direction() const;
+        void set_backlash(const Block *b);
+        void drop_block();
+
+        // a constant rate part of a block, steps are spread evenly over the ticks by the DDA in segment_tick()
+        using segment_t= struct {
+            uint32_t ticks;                                  // length in step ticks
+            std::array<uint32_t, k_max_actuators> steps;     // steps for each motor, never more than ticks
+            std::bitset<k_max_actuators> direction_bits;     // copied from the block, shaped motors can change direction every segment
+            std::bitset<k_max_actuators> block_motors;       // motors that have steps anywhere in the block
+            Block *block;                                    // the block it was cut from, nullptr while the shapers catch up
+            bool first:1;                                    // first segment of the block, sets directions and starts the motors
+            bool last:1;                                     // last segment of the block, stops the motors
+            bool accelerating:1;                             // starts in the acceleration of the block
+            bool decelerating:1;                             // ends in the deceleration of the block
+        };
+        void shape_segment(segment_t &s);
+        bool shaper_moving(uint8_t m) const;
+        bool shapers_settled() const;
+        void reset_shapers();
 
         float frequency;
         uint32_t period;
+        uint32_t unstep_delay;
+        // event driven mode, the timer interrupts every interval ticks, never more than max_interval
+        uint32_t interval{1};
+        uint32_t max_interval{1};
+        // feed override, factors are 16.16 fixed point
+        uint32_t tick_period;                        // timer counts per tick with the speed factor applied
+        volatile uint32_t speed_target{65536};
+        uint32_t speed_factor{65536};
+        volatile uint32_t speed_step{65536};         // most the factor changes in a millisecond
+        uint32_t speed_ramp_step{65536};             // the same for the shortest ramp time allowed
+        uint32_t speed_ms_counts{0};                 // timer counts since the factor last moved
+        // feed hold, multiplies the speed factor
+        volatile uint32_t hold_target{65536};
+        uint32_t hold_factor{65536};
+        volatile uint32_t hold_step{65536};
+        volatile bool factor_request{false};         // a target or the ramp time changed, the step interrupt redoes the steps
         std::array<StepperMotor*, k_max_actuators> motor;
         std::bitset<k_max_actuators> unstep;
 
+        // multi step blocks, the extra steps due this tick are pulsed one after the other by the unstep timer
+        float multistep_threshold{0};
+        uint8_t multistep_max{1};
+        std::array<uint8_t, k_max_actuators> pending_steps;
+        std::bitset<k_max_actuators> pending;
+
         Block *current_block;
         uint32_t current_tick{0};
+        std::array<tickinfo_t, k_max_actuators> tick_info;
+
+        // segment mode, filled by prepare_segments() from PendSV and emptied by the step interrupt
+        TSRingBuffer<segment_t, 8> *segments{nullptr};
+        uint32_t segment_ticks{0};
+        // the segment being stepped
+        segment_t segment;
+        Block * volatile stepping_block{nullptr};        // its block, the conveyor keeps it until its last segment is done
+        uint32_t segment_tick_count{0};
+        std::array<uint32_t, k_max_actuators> segment_counter;
+        std::bitset<k_max_actuators> segment_active;
+        // where prepare_segments() is up to in current_block
+        uint32_t prepared_ticks{0};
+        std::array<uint32_t, k_max_actuators> prepared_steps;
+        float prepared_scale{1.0F};
+        // the shaped motors that move in current_block, either commanded or still catching up with earlier blocks
+        std::bitset<k_max_actuators> prepared_motors;
+
+        // input shaping in segment mode, positions are in steps relative to where the shaper was reset
+        std::array<InputShaper*, 2> shapers{{nullptr, nullptr}};
+        std::array<int32_t, 2> shaper_input{{0, 0}};   // commanded position of each shaped motor
+        std::array<int32_t, 2> shaper_output{{0, 0}};  // position prepared for it
+        uint32_t shaper_tick{0};                       // end of the last prepared segment
 
         struct {
             volatile bool running:1;
             uint8_t num_motors:4;
+            bool skip_block:1;                // all the motors were stopped externally, drop the rest of the block's segments
+            volatile bool pulse_gap:1;        // the unstep timer is timing the low time between two pulses of a multi step tick
+            bool shaper_tail:1;               // preparing the segments that let the shapers catch up after the last block
+            volatile bool shaper_reset:1;     // the step interrupt dropped segments, the shapers have to start again
+            volatile bool hold_stopped:1;     // a feed hold has stopped the stepping
+            volatile bool drop_held:1;        // drop the block the hold stopped
+            volatile bool drop_prepared:1;    // the step interrupt dropped a held block, prepare_segments() throws away the rest
         };
 };
@@ -45,10 +45,15 @@ class StepperMotor  : public Module {
         int32_t get_last_milestone_steps(void) const { return last_milestone_steps; }
         float get_current_position(void) const { return (float)current_position_steps/steps_per_mm; }
         uint32_t get_current_step(void) const { return current_position_steps; }
+        // backlash taken up by the end of the block being stepped, the step ticker sets it as each block starts
+        void set_backlash(float mm) { backlash= mm; }
+        float get_backlash() const { return backlash; }
         float get_max_rate(void) const { return max_rate; }
         void set_max_rate(float mr) { max_rate= mr; }
         void set_acceleration(float a) { acceleration= a; }
         float get_acceleration() const { return acceleration; }
+        void set_pressure_advance(float k) { pressure_advance= k; }
+        float get_pressure_advance() const { return pressure_advance; }
         bool is_selected() const { return selected; }
         void set_selected(bool b) { selected= b; }
         bool is_extruder() const { return extruder; }
@@ -69,8 +74,10 @@ class StepperMotor  : public Module {
         float steps_per_mm;
         float max_rate; // this is not really rate it is in mm/sec, misnamed used in Robot and Extruder
         float acceleration;
+        float pressure_advance; // seconds, extra extruder travel per mm/s of extruder speed
 
         volatile int32_t current_position_steps;
+        volatile float backlash;
         int32_t last_milestone_steps;
         float   last_milestone_mm;
 
@@ -28,6 +28,8 @@ class StreamOutput {
         virtual int _getc(void) { return 0; }
         virtual int puts(const char* str) = 0;
         virtual bool ready() { return true; };
+        // bytes the host can send without waiting for a reply, for character counting hosts, -1 if it is not known
+        virtual int rx_free() { return -1; }
 
         static NullStreamOutput NullStream;
 };
@@ -23,6 +23,8 @@
 
 #include "libs/Kernel.h"
 #include "libs/SerialMessage.h"
+#include "libs/RealtimeCommands.h"
+#include "BinaryProtocol.h"
 #include "StreamOutputPool.h"
 
 #include "mbed.h"
@@ -41,6 +43,8 @@ USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(256 + 8), txbuf(128 + 8)
     halt_flag = false;
     query_flag = false;
     last_char_was_dollar = false;
+    last_char_was_cr = false;
+    binary = nullptr;
 }
 
 bool USBSerial::ensure_tx_space(int space)
@@ -191,6 +195,9 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     iprintf("Read %ld bytes:\n\t", size);
     for (uint8_t i = 0; i < size; i++) {
 
+        // in binary mode the frames are taken whole, only what comes between them is looked at
+        if(binary != nullptr && binary->receive(c[i])) continue;
+
         // handle backspace and delete by deleting the last character in the buffer if there is one
         if(c[i] == 0x08 || c[i] == 0x7F) {
             if(!rxbuf.isEmpty()) rxbuf.pop();
@@ -208,20 +215,20 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
             continue;
         }
 
-        if(THEKERNEL->is_grbl_mode() || THEKERNEL->is_feed_hold_enabled()) {
-            if(c[i] == '!') { // safe pause
-                THEKERNEL->set_feed_hold(true);
-                continue;
-            }
-
-            if(c[i] == '~') { // safe resume
-                THEKERNEL->set_feed_hold(false);
-                continue;
-            }
-        }
+        // feed hold, resume, overrides etc take effect from here, not when the line buffer gets to them
+        if(THEKERNEL->realtime->receive(c[i])) continue;
+        if(binary != nullptr) continue;
 
         last_char_was_dollar = (c[i] == '$');
 
+        // CR NL is one line end so it gets one reply
+        bool cr = (c[i] == '\r');
+        if (c[i] == '\n' && last_char_was_cr) {
+            last_char_was_cr = false;
+            continue;
+        }
+        last_char_was_cr = cr;
+
         if (flush_to_nl == false)
             rxbuf.queue(c[i]);
 
@@ -267,6 +274,14 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     return r;
 }
 
+// the endpoint stops taking packets once there is less than one packet of room, anything sent after that, realtime
+// commands included, waits in the host until the line in front of it has been run
+int USBSerial::rx_free()
+{
+    int n = rxbuf.free() - MAX_PACKET_SIZE_EPBULK;
+    return n > 0 ? n : 0;
+}
+
 uint8_t USBSerial::available()
 {
     return rxbuf.available();
@@ -281,12 +296,14 @@ void USBSerial::on_module_loaded()
 {
     this->register_for_event(ON_MAIN_LOOP);
     this->register_for_event(ON_IDLE);
+    this->register_for_command("binary", &USBSerial::binary_command);
 }
 
 void USBSerial::on_idle(void *argument)
 {
     if(halt_flag) {
         halt_flag = false;
+        if(binary != nullptr) binary->end(); // the host is giving up on it
         THEKERNEL->call_event(ON_HALT, nullptr);
         if(THEKERNEL->is_grbl_mode()) {
             puts("ALARM: Abort during cycle\r\n");
@@ -299,7 +316,7 @@ void USBSerial::on_idle(void *argument)
 
     if(query_flag) {
         query_flag = false;
-        puts(THEKERNEL->get_query_string().c_str());
+        puts(THEKERNEL->get_query_string(this).c_str());
     }
 
 }
@@ -321,7 +338,17 @@ void USBSerial::on_main_loop(void *argument)
             txbuf.flush();
             rxbuf.flush();
             nl_in_rx = 0;
+            if(binary != nullptr) binary->end();
+        }
+    }
+
+    if(binary != nullptr) {
+        if(!binary->process()) {
+            BinaryProtocol *b= binary;
+            binary= nullptr;
+            delete b;
         }
+        return;
     }
 
     // if we are in feed hold we do not process anything
@@ -345,6 +372,14 @@ void USBSerial::on_main_loop(void *argument)
     }
 }
 
+// switches this stream over to binary frames, see BinaryProtocol.h
+void USBSerial::binary_command(std::string parameters, StreamOutput *stream)
+{
+    if(stream != this || binary != nullptr) return;
+    binary= new BinaryProtocol(this);
+    printf("ok binary %d\n", BinaryProtocol::window);
+}
+
 void USBSerial::on_attach()
 {
     attach = true;
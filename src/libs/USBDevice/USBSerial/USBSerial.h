@@ -26,6 +26,10 @@
 #include "Module.h"
 #include "StreamOutput.h"
 
+#include <string>
+
+class BinaryProtocol;
+
 class USBSerial_Receiver {
 protected:
     virtual bool SerialEvent_RX(void) = 0;
@@ -38,6 +42,7 @@ public:
     int _putc(int c);
     int _getc();
     int puts(const char *);
+    int rx_free();
 
     uint8_t available();
     bool ready();
@@ -50,6 +55,7 @@ public:
     void on_module_loaded(void);
     void on_main_loop(void *);
     void on_idle(void *);
+    void binary_command(std::string parameters, StreamOutput *stream);
 
 protected:
 //     virtual bool EpCallback(uint8_t, uint8_t);
@@ -67,6 +73,9 @@ protected:
     // this makes it trivial to detect if there's a new line available
     volatile int nl_in_rx;
 
+    // set while in binary mode
+    BinaryProtocol * volatile binary;
+
 
     volatile struct {
         volatile bool attach:1;
@@ -74,6 +83,7 @@ protected:
         bool halt_flag:1;
         bool query_flag:1;
         bool last_char_was_dollar:1;
+        bool last_char_was_cr:1;
         // if we receive a line that's longer than the buffer, to avoid a deadlock
         // we must flush the buffer.
         // then to avoid delivering the tail of a line to Smoothie we must keep
@@ -0,0 +1,224 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BinaryProtocol.h"
+
+#include "Kernel.h"
+#include "Gcode.h"
+#include "SerialMessage.h"
+#include "StreamOutput.h"
+
+#include <math.h>
+#include <string.h>
+
+const uint8_t BinaryProtocol::sync;
+const uint8_t BinaryProtocol::max_payload;
+const uint16_t BinaryProtocol::window;
+const uint16_t BinaryProtocol::buffer_size;
+const uint8_t BinaryProtocol::ack_every;
+
+BinaryProtocol::BinaryProtocol(StreamOutput *stream) : stream(stream)
+{
+    memset(last, 0, sizeof(last));
+    head= tail= 0;
+    frame_start= 0;
+    rx_left= 0;
+    rx_overrun= false;
+    expected= 0;
+    unacked= 0;
+    naked= false;
+    ended= false;
+}
+
+uint16_t BinaryProtocol::crc16(const uint8_t *p, size_t n, uint16_t crc)
+{
+    while(n-- > 0) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int i = 0; i < 8; ++i) {
+            crc= (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// only the length needs looking at, the rest of the frame is taken as it is
+bool BinaryProtocol::receive(uint8_t c)
+{
+    if(rx_left == 0) {
+        if(c != sync) return false;
+        frame_start= head;
+        rx_overrun= false;
+        rx_left= -1;
+
+    } else if(rx_left < 0) {
+        // a bad length gets cut short, the CRC then fails
+        if(c > max_payload) c= max_payload;
+        rx_left= c + 5; // seq, type, the payload and the CRC, with this one
+
+    }
+
+    // a host that goes over the window loses the whole frame, it gets a nak for it from the next one
+    if(!rx_overrun && available() == buffer_size - 1) {
+        rx_overrun= true;
+        head= frame_start;
+    }
+    if(!rx_overrun) {
+        buffer[head]= c;
+        head= (head + 1) & (buffer_size - 1);
+    }
+    if(rx_left > 0) --rx_left;
+    return true;
+}
+
+bool BinaryProtocol::process()
+{
+    uint8_t frame[max_payload + 6];
+    while(!ended) {
+        size_t n= available();
+        if(n < 2) break;
+        uint8_t len= peek(1);
+        if(n < len + 6U) break;
+
+        for (int i = 0; i < len + 6; ++i) frame[i]= peek(i);
+        tail= (tail + len + 6) & (buffer_size - 1);
+        run(frame, len);
+    }
+
+    // ack when it has caught up with the host, or every few frames while it keeps sending
+    if(unacked > 0 && (ended || available() < 2 || available() < peek(1) + 6U)) ack();
+    return !ended;
+}
+
+void BinaryProtocol::run(const uint8_t *frame, uint8_t len)
+{
+    uint16_t crc= frame[len + 4] | (frame[len + 5] << 8);
+    if(crc16(frame + 1, len + 3) != crc) {
+        nak("crc");
+        return;
+    }
+
+    // once one is missing everything after it is dropped until the host goes back to it
+    uint8_t seq= frame[2];
+    if(seq != expected) {
+        nak("seq");
+        return;
+    }
+    naked= false;
+
+    const uint8_t *payload= frame + 4;
+    switch(frame[3]) {
+        case MOVE:
+            if(THEKERNEL->is_halted()) {
+                nak("halted");
+                return;
+            }
+            if(!move(payload, payload + len)) {
+                nak("error");
+                return;
+            }
+            break;
+
+        case LINE: {
+            struct SerialMessage message{stream, std::string((const char *)payload, len)};
+            THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+            break;
+        }
+
+        case END:
+            ended= true;
+            break;
+
+        default:
+            nak("type");
+            return;
+    }
+
+    ++expected;
+    if(++unacked >= ack_every) ack();
+}
+
+static bool get_float(const uint8_t *&p, const uint8_t *end, float &v)
+{
+    if(end - p < 4) return false;
+    memcpy(&v, p, 4);
+    p += 4;
+    return true;
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, int32_t &v)
+{
+    uint32_t u= 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if(p == end) return false;
+        uint8_t b= *p++;
+        u |= (uint32_t)(b & 0x7F) << shift;
+        if((b & 0x80) == 0) {
+            v= (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinaryProtocol::move(const uint8_t *p, const uint8_t *end)
+{
+    if(p == end) return false;
+    uint8_t flags= *p++;
+
+    char letters[6];
+    float values[6];
+    int n= 0;
+    for (int i = 0; i < 4; ++i) {
+        if((flags & (1 << i)) == 0) continue;
+        float v;
+        if(flags & DELTAS) {
+            int32_t d;
+            if(!get_varint(p, end, d)) return false;
+            last[i] += d;
+            v= last[i] / 1000.0F;
+        } else {
+            if(!get_float(p, end, v)) return false;
+            last[i]= lroundf(v * 1000.0F);
+        }
+        letters[n]= "XYZE"[i];
+        values[n++]= v;
+    }
+    if(flags & F) {
+        if(!get_float(p, end, values[n])) return false;
+        letters[n++]= 'F';
+    }
+    if(flags & S) {
+        if(!get_float(p, end, values[n])) return false;
+        letters[n++]= 'S';
+    }
+    if(p != end) return false;
+
+    Gcode gcode((flags & RAPID) ? 0 : 1, letters, values, n, stream);
+    THEKERNEL->call_event(ON_GCODE_RECEIVED, &gcode);
+    if(gcode.is_error) {
+        // as GcodeDispatch does, it is not safe to carry on
+        stream->printf("Error: %s\r\nEntering Alarm/Halt state\n", gcode.txt_after_ok.empty() ? "unknown" : gcode.txt_after_ok.c_str());
+        THEKERNEL->call_event(ON_HALT, nullptr);
+        return false;
+    }
+    return true;
+}
+
+void BinaryProtocol::nak(const char *why)
+{
+    // just the once, the frames that were already on their way after it get the same answer
+    if(naked) return;
+    naked= true;
+    if(unacked > 0) ack();
+    stream->printf("nak %u %s\n", (unsigned)expected, why);
+}
+
+void BinaryProtocol::ack()
+{
+    stream->printf("ack %u\n", (unsigned)(uint8_t)(expected - 1));
+    unacked= 0;
+}
@@ -0,0 +1,89 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class StreamOutput;
+
+/*
+ * Binary framed streaming, for hosts that need more moves a second than text gcode with an ok per line can manage.
+ *
+ * The binary console command switches the stream over, it replies "ok binary <window>" and every byte after that is
+ * a frame, a realtime command (which are only looked for between frames) or dropped:
+ *
+ *   A5 <len> <seq> <type> <payload: len bytes> <crc16 lo> <crc16 hi>
+ *
+ * The CRC is CRC-16/CCITT-FALSE over len to the end of the payload, seq counts up from 0 and wraps.
+ *
+ *   MOVE  <flags> [X] [Y] [Z] [E] [F] [S]   a G1, or G0 with RAPID, the fields the flags ask for in that order
+ *   LINE  <text>                            a gcode or command line as it would be sent in text
+ *   END                                     back to text
+ *
+ * The axis fields are float32 values of the words, or with DELTAS varints of the change in the word value since it
+ * was last sent in microns (zigzag encoded so small negative changes stay small). F and S are always float32. It all
+ * is little endian. A move goes straight to the robot as a Gcode made from these words, nothing is printed or parsed.
+ *
+ * The receive buffer holds window bytes. The host can have that many bytes of frames that are not acked yet in
+ * flight, "ack <seq>" says every frame up to seq has been run, they are acked a few at a time. "nak <seq> <why>"
+ * says the frames from seq on were thrown away (bad CRC, one missing, the machine is halted) and have to be sent again.
+ */
+class BinaryProtocol {
+    public:
+        enum TYPE : uint8_t { MOVE= 1, LINE= 2, END= 3 };
+        enum FLAGS : uint8_t {
+            X=      1<<0,
+            Y=      1<<1,
+            Z=      1<<2,
+            E=      1<<3,
+            F=      1<<4,
+            S=      1<<5,
+            RAPID=  1<<6,
+            DELTAS= 1<<7,
+        };
+        static const uint8_t sync= 0xA5;
+        static const uint8_t max_payload= 120;
+        static const uint16_t window= 511;
+
+        BinaryProtocol(StreamOutput *stream);
+
+        // from the receive interrupt, true if c is part of a frame and has been taken
+        bool receive(uint8_t c);
+        // from the main loop, runs the frames that are in, false once binary mode has ended
+        bool process();
+        // leaves binary mode, the stream deletes it from its main loop
+        void end() { ended= true; }
+
+        static uint16_t crc16(const uint8_t *p, size_t n, uint16_t crc= 0xFFFF);
+
+    private:
+        static const uint16_t buffer_size= window + 1;      // a power of 2
+        static const uint8_t ack_every= 8;
+
+        size_t available() const { return (head - tail) & (buffer_size - 1); }
+        uint8_t peek(size_t i) const { return buffer[(tail + i) & (buffer_size - 1)]; }
+        void run(const uint8_t *frame, uint8_t len);
+        bool move(const uint8_t *p, const uint8_t *end);
+        void nak(const char *why);
+        void ack();
+
+        StreamOutput *stream;
+        int32_t last[4];                                    // the XYZE word values last sent in microns, for DELTAS
+        uint8_t buffer[buffer_size];
+        volatile uint16_t head;                             // written by the receive interrupt
+        volatile uint16_t tail;                             // read by the main loop
+        uint16_t frame_start;                               // where the frame being received started
+        int16_t rx_left;                                    // bytes of it still to come, -1 for the length
+        bool rx_overrun;                                    // it did not fit and is being dropped
+
+        uint8_t expected;                                   // seq of the next frame to run
+        uint8_t unacked;                                    // frames run since the last ack
+        bool naked;                                         // frames are thrown away until expected is sent again
+        volatile bool ended;
+};
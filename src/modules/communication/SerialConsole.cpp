@@ -16,6 +16,8 @@ using std::string;
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
+#include "libs/RealtimeCommands.h"
+#include "BinaryProtocol.h"
 
 // Serial reading module
 // Treats every received line as a command and passes it ( via event call ) to the command dispatcher.
@@ -23,6 +25,9 @@ using std::string;
 SerialConsole::SerialConsole( PinName rx_pin, PinName tx_pin, int baud_rate ){
     this->serial = new mbed::Serial( rx_pin, tx_pin );
     this->serial->baud(baud_rate);
+    this->binary = nullptr;
+    this->nl_in_rx = 0;
+    this->line_start = 0;
 }
 
 // Called when the module has just been loaded
@@ -31,10 +36,13 @@ void SerialConsole::on_module_loaded() {
     this->serial->attach(this, &SerialConsole::on_serial_char_received, mbed::Serial::RxIrq);
     query_flag= false;
     halt_flag= false;
+    last_char_was_cr= false;
+    overflow= false;
 
     // We only call the command dispatcher in the main loop, nowhere else
     this->register_for_event(ON_MAIN_LOOP);
     this->register_for_event(ON_IDLE);
+    this->register_for_command("binary", &SerialConsole::binary_command);
 
     // Add to the pack of streams kernel can call to, for example for broadcasting
     THEKERNEL->streams->append_stream(this);
@@ -44,6 +52,10 @@ void SerialConsole::on_module_loaded() {
 void SerialConsole::on_serial_char_received(){
     while(this->serial->readable()){
         char received = this->serial->getc();
+        // in binary mode the frames are taken whole, only what comes between them is looked at
+        if(this->binary != nullptr) {
+            if(this->binary->receive(received)) continue;
+        }
         if(received == '?') {
             query_flag= true;
             continue;
@@ -52,9 +64,32 @@ void SerialConsole::on_serial_char_received(){
             halt_flag= true;
             continue;
         }
-        // convert CR to NL (for host OSs that don't send NL)
-        if( received == '\r' ){ received = '\n'; }
+        // feed hold, overrides etc take effect from here, not when the line buffer gets to them
+        if(THEKERNEL->realtime->receive(received)) continue;
+        if(this->binary != nullptr) continue;
+        // convert CR to NL (for host OSs that don't send NL), CR NL is one line end so it gets one reply
+        bool cr= received == '\r';
+        if(received == '\n' && last_char_was_cr) { last_char_was_cr= false; continue; }
+        last_char_was_cr= cr;
+        if(cr) received = '\n';
+
+        if(overflow) {
+            // the whole line is thrown away rather than running what fitted of it
+            if(received != '\n') continue;
+            overflow= false;
+            received= dropped_line;
+        } else if(received != '\n' && this->buffer.size() >= this->buffer.capacity() - 1) {
+            // there is always room for the end of a line, the lines already in the buffer are never lost
+            this->buffer.head= line_start;
+            overflow= true;
+            continue;
+        }
+        if(this->buffer.size() >= this->buffer.capacity()) continue;
         this->buffer.push_back(received);
+        if(received == '\n' || received == dropped_line) {
+            line_start= this->buffer.head;
+            nl_in_rx++;
+        }
     }
 }
 
@@ -62,10 +97,11 @@ void SerialConsole::on_idle(void * argument)
 {
     if(query_flag) {
         query_flag= false;
-        puts(THEKERNEL->get_query_string().c_str());
+        puts(THEKERNEL->get_query_string(this).c_str());
     }
     if(halt_flag) {
         halt_flag= false;
+        if(this->binary != nullptr) this->binary->end(); // the host is giving up on it
         THEKERNEL->call_event(ON_HALT, nullptr);
         if(THEKERNEL->is_grbl_mode()) {
             puts("ALARM: Abort during cycle\r\n");
@@ -77,13 +113,32 @@ void SerialConsole::on_idle(void * argument)
 
 // Actual event calling must happen in the main loop because if it happens in the interrupt we will loose data
 void SerialConsole::on_main_loop(void * argument){
-    if( this->has_char('\n') ){
+    if(this->binary != nullptr) {
+        if(!this->binary->process()) {
+            BinaryProtocol *b= this->binary;
+            this->binary= nullptr;
+            delete b;
+        }
+        return;
+    }
+
+    if( nl_in_rx > 0 ){
         string received;
         received.reserve(20);
         while(1){
            char c;
            this->buffer.pop_front(c);
+           if( c == dropped_line ){
+                __disable_irq();
+                nl_in_rx--;
+                __enable_irq();
+                this->printf(THEKERNEL->is_grbl_mode() ? "error:Line overflow\r\n" : "Error: line too long for the receive buffer\r\n");
+                return;
+           }
            if( c == '\n' ){
+                __disable_irq();
+                nl_in_rx--;
+                __enable_irq();
                 struct SerialMessage message;
                 message.message = received;
                 message.stream = this;
@@ -96,6 +151,14 @@ void SerialConsole::on_main_loop(void * argument){
     }
 }
 
+// switches this stream over to binary frames, see BinaryProtocol.h
+void SerialConsole::binary_command(string parameters, StreamOutput *stream)
+{
+    if(stream != this || this->binary != nullptr) return;
+    this->binary= new BinaryProtocol(this);
+    this->printf("ok binary %d\n", BinaryProtocol::window);
+}
+
 
 int SerialConsole::puts(const char* s)
 {
@@ -112,14 +175,9 @@ int SerialConsole::_getc()
     return this->serial->getc();
 }
 
-// Does the queue have a given char ?
-bool SerialConsole::has_char(char letter){
-    int index = this->buffer.tail;
-    while( index != this->buffer.head ){
-        if( this->buffer.buffer[index] == letter ){
-            return true;
-        }
-        index = this->buffer.next_block_index(index);
-    }
-    return false;
+// the last place is kept for the end of a line
+int SerialConsole::rx_free()
+{
+    int n= this->buffer.capacity() - 1 - this->buffer.size();
+    return n > 0 ? n : 0;
 }
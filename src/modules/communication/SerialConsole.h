@@ -20,6 +20,8 @@ using std::string;
 
 #define baud_rate_setting_checksum CHECKSUM("baud_rate")
 
+class BinaryProtocol;
+
 class SerialConsole : public Module, public StreamOutput {
     public:
         SerialConsole( PinName rx_pin, PinName tx_pin, int baud_rate );
@@ -28,20 +30,31 @@ class SerialConsole : public Module, public StreamOutput {
         void on_serial_char_received();
         void on_main_loop(void * argument);
         void on_idle(void * argument);
-        bool has_char(char letter);
+        void binary_command(string parameters, StreamOutput *stream);
 
         int _putc(int c);
         int _getc(void);
         int puts(const char*);
+        int rx_free();
 
         //string receive_buffer;                 // Received chars are stored here until a newline character is received
         //vector<std::string> received_lines;    // Received lines are stored here until they are requested
         RingBuffer<char,256> buffer;             // Receive buffer
         mbed::Serial* serial;
+        BinaryProtocol* volatile binary;         // set while in binary mode
+        volatile int nl_in_rx;                   // complete lines in the buffer
+        int line_start;                          // where the line being received starts in the buffer
+        bool last_char_was_cr;                   // only used in the interrupt, so not with the flags
+        bool overflow;                           // the line being received did not fit and is being dropped
         struct {
           bool query_flag:1;
           bool halt_flag:1;
         };
+
+    private:
+        // stands in for a line that was dropped, there is an error reply in its place. ^X is always taken out as a halt
+        // before the buffer so it can not be part of a line
+        static const char dropped_line= 'X'-'A'+1;
 };
 
 #endif
@@ -10,13 +10,41 @@
 #include "libs/StreamOutput.h"
 #include "utils.h"
 #include <stdlib.h>
+#include <string.h>
 #include <algorithm>
 
+// the common forms of number in a line (-12.345) without the cost of strtof(), anything else is left to strtof()
+static float parse_number(const char *s, char **end)
+{
+    const char *p= s;
+    while(*p == ' ' || *p == '\t') p++;
+    bool neg= *p == '-';
+    if(neg || *p == '+') p++;
+
+    uint32_t n= 0;
+    int digits= 0, scale= 0;
+    for (; *p >= '0' && *p <= '9'; p++, digits++) n= n * 10 + (*p - '0');
+    if(*p == '.') {
+        for (p++; *p >= '0' && *p <= '9'; p++, digits++, scale++) n= n * 10 + (*p - '0');
+    }
+
+    // exponents, hex, inf, nan and too many digits to hold
+    if(digits == 0 || digits > 9 || *p == 'e' || *p == 'E' || ((*p == 'x' || *p == 'X') && digits == 1)) {
+        return strtof(s, end);
+    }
+
+    static const double pow10[]= { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+    *end= (char *)p;
+    float v= scale == 0 ? (float)n : (float)(n / pow10[scale]);
+    return neg ? -v : v;
+}
+
 // This is a gcode object. It represents a GCode string/command, and caches some important values about that command for the sake of performance.
 // It gets passed around in events, and attached to the queue ( that'll change )
 Gcode::Gcode(const string &command, StreamOutput *stream, bool strip)
 {
-    this->command= strdup(command.c_str());
+    this->command= nullptr;
+    set_command(command.c_str(), strlen(command.c_str()));
     this->m= 0;
     this->g= 0;
     this->subcode= 0;
@@ -27,9 +55,32 @@ Gcode::Gcode(const string &command, StreamOutput *stream, bool strip)
     this->stripped= strip;
 }
 
+Gcode::Gcode(unsigned int g, const char letters[], const float values[], int n, StreamOutput *stream)
+{
+    this->command= nullptr;
+    set_command("", 0);
+    this->m= 0;
+    this->g= g;
+    this->has_g= true;
+    this->has_m= false;
+    this->subcode= 0;
+    this->add_nl= false;
+    this->is_error= false;
+    this->stripped= true;
+    this->stream= stream;
+
+    n_words= 0;
+    n_args= 0;
+    overflow= false;
+    for (int i = 0; i < n && n_words < max_words; ++i) {
+        words[n_words++]= word_t{letters[i], true, 0, values[i]};
+        if(letters[i] != 'T') n_args++;
+    }
+}
+
 Gcode::~Gcode()
 {
-    if(command != nullptr) {
+    if(command != text) {
         // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
         free(command);
     }
@@ -37,28 +88,25 @@ Gcode::~Gcode()
 
 Gcode::Gcode(const Gcode &to_copy)
 {
-    this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
-    this->has_m                 = to_copy.has_m;
-    this->has_g                 = to_copy.has_g;
-    this->m                     = to_copy.m;
-    this->g                     = to_copy.g;
-    this->subcode               = to_copy.subcode;
-    this->add_nl                = to_copy.add_nl;
-    this->is_error              = to_copy.is_error;
-    this->stream                = to_copy.stream;
-    this->txt_after_ok.assign( to_copy.txt_after_ok );
+    this->command= nullptr;
+    *this= to_copy;
 }
 
 Gcode &Gcode::operator= (const Gcode &to_copy)
 {
     if( this != &to_copy ) {
-        this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
+        set_command(to_copy.command, strlen(to_copy.command));
+        memcpy(this->words, to_copy.words, to_copy.n_words * sizeof(word_t));
+        this->n_words               = to_copy.n_words;
+        this->n_args                = to_copy.n_args;
+        this->overflow              = to_copy.overflow;
         this->has_m                 = to_copy.has_m;
         this->has_g                 = to_copy.has_g;
         this->m                     = to_copy.m;
         this->g                     = to_copy.g;
         this->subcode               = to_copy.subcode;
         this->add_nl                = to_copy.add_nl;
+        this->stripped              = to_copy.stripped;
         this->is_error              = to_copy.is_error;
         this->stream                = to_copy.stream;
         this->txt_after_ok.assign( to_copy.txt_after_ok );
@@ -66,91 +114,164 @@ Gcode &Gcode::operator= (const Gcode &to_copy)
     return *this;
 }
 
+// keeps a copy of the line, in text if it fits
+void Gcode::set_command(const char *s, size_t len)
+{
+    if(command != nullptr && command != text) free(command);
+    command= len < inline_size ? text : (char *)malloc(len + 1);
+    memcpy(command, s, len);
+    command[len]= '\0';
+}
 
-// Whether or not a Gcode has a letter
-bool Gcode::has_letter( char letter ) const
+// fills in the words table, a letter that is there more than once gets the first value it has
+void Gcode::parse_words()
 {
-    for (size_t i = 0; i < strlen(this->command); ++i) {
-        if( command[i] == letter ) {
-            return true;
+    n_words= 0;
+    n_args= 0;
+    overflow= false;
+    const char *cs= command;
+    while(*cs) {
+        char c= *cs++;
+        if(c < 'A' || c > 'Z') continue;
+        if(c != 'T') n_args++;
+
+        char *cn;
+        float v= parse_number(cs, &cn);
+        bool has_value= cn > cs;
+        uint16_t pos= cs - command;
+        if(has_value) cs= cn;
+
+        word_t *w= const_cast<word_t *>(find(c));
+        if(w == nullptr) {
+            if(n_words == max_words) {
+                overflow= true;
+                continue;
+            }
+            w= &words[n_words++];
+        } else if(w->has_value) {
+            continue;
         }
+        w->letter= c;
+        w->has_value= has_value;
+        w->pos= pos;
+        w->value= has_value ? v : 0;
     }
-    return false;
 }
 
-// Retrieve the value for a given letter
-float Gcode::get_value( char letter, char **ptr ) const
+const Gcode::word_t *Gcode::find(char letter) const
+{
+    for (int i = 0; i < n_words; ++i) {
+        if(words[i].letter == letter) return &words[i];
+    }
+    return nullptr;
+}
+
+// where the value of a letter starts in the line, the table is only bypassed for what it can not hold
+const char *Gcode::scan(char letter) const
 {
+    if(letter >= 'A' && letter <= 'Z') {
+        const word_t *w= find(letter);
+        if(w != nullptr && w->has_value) return command + w->pos;
+        if(!overflow) return nullptr;
+    }
+
     const char *cs = command;
     char *cn = NULL;
     for (; *cs; cs++) {
         if( letter == *cs ) {
             cs++;
-            float r = strtof(cs, &cn);
-            if(ptr != nullptr) *ptr= cn;
+            strtof(cs, &cn);
             if (cn > cs)
-                return r;
+                return cs;
         }
     }
-    if(ptr != nullptr) *ptr= nullptr;
-    return 0;
+    return nullptr;
+}
+
+// Whether or not a Gcode has a letter
+bool Gcode::has_letter( char letter ) const
+{
+    if(letter >= 'A' && letter <= 'Z') {
+        if(find(letter) != nullptr) return true;
+        if(!overflow) return false;
+    }
+    return strchr(this->command, letter) != nullptr;
+}
+
+// Retrieve the value for a given letter
+float Gcode::get_value( char letter, char **ptr ) const
+{
+    if(ptr == nullptr) {
+        const word_t *w= find(letter);
+        if(w != nullptr && w->has_value) return w->value;
+    }
+
+    const char *cs= scan(letter);
+    if(cs == nullptr) {
+        if(ptr != nullptr) *ptr= nullptr;
+        return 0;
+    }
+    char *cn;
+    float r = parse_number(cs, &cn);
+    if(ptr != nullptr) *ptr= cn;
+    return r;
 }
 
+// a word with no text, from the binary protocol, is read from the table
 int Gcode::get_int( char letter, char **ptr ) const
 {
-    const char *cs = command;
-    char *cn = NULL;
-    for (; *cs; cs++) {
-        if( letter == *cs ) {
-            cs++;
-            int r = strtol(cs, &cn, 10);
-            if(ptr != nullptr) *ptr= cn;
-            if (cn > cs)
-                return r;
-        }
+    if(ptr == nullptr) {
+        const word_t *w= find(letter);
+        if(w != nullptr && w->has_value && w->pos == 0) return (int)w->value;
     }
-    if(ptr != nullptr) *ptr= nullptr;
-    return 0;
+
+    const char *cs= scan(letter);
+    char *cn = NULL;
+    int r = cs != nullptr ? strtol(cs, &cn, 10) : 0;
+    if(ptr != nullptr) *ptr= cs != nullptr && cn > cs ? cn : nullptr;
+    return r;
 }
 
 uint32_t Gcode::get_uint( char letter, char **ptr ) const
 {
-    const char *cs = command;
-    char *cn = NULL;
-    for (; *cs; cs++) {
-        if( letter == *cs ) {
-            cs++;
-            int r = strtoul(cs, &cn, 10);
-            if(ptr != nullptr) *ptr= cn;
-            if (cn > cs)
-                return r;
-        }
+    if(ptr == nullptr) {
+        const word_t *w= find(letter);
+        if(w != nullptr && w->has_value && w->pos == 0) return (uint32_t)w->value;
     }
-    if(ptr != nullptr) *ptr= nullptr;
-    return 0;
+
+    const char *cs= scan(letter);
+    char *cn = NULL;
+    uint32_t r = cs != nullptr ? strtoul(cs, &cn, 10) : 0;
+    if(ptr != nullptr) *ptr= cs != nullptr && cn > cs ? cn : nullptr;
+    return r;
 }
 
 int Gcode::get_num_args() const
 {
-    int count = 0;
-    for(size_t i = stripped?0:1; i < strlen(command); i++) {
-        if( this->command[i] >= 'A' && this->command[i] <= 'Z' ) {
-            if(this->command[i] == 'T') continue;
-            count++;
-        }
-    }
-    return count;
+    // the G or M is not an argument when it was left on the line
+    char c= command[0];
+    return (!stripped && c >= 'A' && c <= 'Z' && c != 'T') ? n_args - 1 : n_args;
 }
 
+// the letters other than T from the words table, so a gcode made from its words has them too. Only a line with more
+// words than the table holds is scanned
 std::map<char,float> Gcode::get_args() const
 {
     std::map<char,float> m;
-    for(size_t i = stripped?0:1; i < strlen(command); i++) {
-        char c= this->command[i];
-        if( c >= 'A' && c <= 'Z' ) {
-            if(c == 'T') continue;
-            m[c]= get_value(c);
+    if(overflow) {
+        for(size_t i = stripped?0:1; command[i] != '\0'; i++) {
+            char c= this->command[i];
+            if( c >= 'A' && c <= 'Z' ) {
+                if(c == 'T') continue;
+                m[c]= get_value(c);
+            }
         }
+        return m;
+    }
+
+    for (int i = 0; i < n_words; ++i) {
+        if(words[i].letter == 'T' || is_leading_word(i)) continue;
+        m[words[i].letter]= words[i].value;
     }
     return m;
 }
@@ -158,19 +279,35 @@ std::map<char,float> Gcode::get_args() const
 std::map<char,int> Gcode::get_args_int() const
 {
     std::map<char,int> m;
-    for(size_t i = stripped?0:1; i < strlen(command); i++) {
-        char c= this->command[i];
-        if( c >= 'A' && c <= 'Z' ) {
-            if(c == 'T') continue;
-            m[c]= get_int(c);
+    if(overflow) {
+        for(size_t i = stripped?0:1; command[i] != '\0'; i++) {
+            char c= this->command[i];
+            if( c >= 'A' && c <= 'Z' ) {
+                if(c == 'T') continue;
+                m[c]= get_int(c);
+            }
         }
+        return m;
+    }
+
+    for (int i = 0; i < n_words; ++i) {
+        if(words[i].letter == 'T' || is_leading_word(i)) continue;
+        m[words[i].letter]= get_int(words[i].letter);
     }
     return m;
 }
 
+// the G or M left at the start of a line that was not stripped is not an argument
+bool Gcode::is_leading_word(int i) const
+{
+    return !stripped && words[i].pos <= 1 && command[0] == words[i].letter;
+}
+
 // Cache some of this command's properties, so we don't have to parse the string every time we want to look at them
 void Gcode::prepare_cached_values(bool strip)
 {
+    parse_words();
+
     char *p= nullptr;
     if( this->has_letter('G') ) {
         this->has_g = true;
@@ -200,11 +337,21 @@ void Gcode::prepare_cached_values(bool strip)
 
     if(!strip) return;
 
-    // remove the Gxxx or Mxxx from string
+    // remove the Gxxx or Mxxx from string, the words before it go too
     if (p != nullptr) {
-        char *n= strdup(p); // create new string starting at end of the numeric value
-        free(command);
-        command= n;
+        uint16_t off= p - command;
+        for (uint16_t i = 0; i < off; ++i) {
+            if(command[i] >= 'A' && command[i] <= 'Z' && command[i] != 'T') n_args--;
+        }
+        memmove(command, p, strlen(p) + 1);
+
+        uint8_t n= 0;
+        for (int i = 0; i < n_words; ++i) {
+            if(words[i].pos < off) continue;
+            words[n]= words[i];
+            words[n++].pos -= off;
+        }
+        n_words= n;
     }
 }
 
@@ -234,9 +381,8 @@ void Gcode::strip_parameters()
         // strip whitespace to save even more, this causes problems so don't do it
         //newcmd.erase(std::remove_if(newcmd.begin(), newcmd.end(), ::isspace), newcmd.end());
 
-        // release the old one
-        free(command);
-        // copy the new shortened one
-        command= strdup(newcmd.c_str());
+        // it is never longer so it goes where the old one was
+        memcpy(command, newcmd.c_str(), newcmd.size() + 1);
+        parse_words();
     }
 }
@@ -16,9 +16,12 @@ using std::string;
 class StreamOutput;
 
 // Object to represent a Gcode command
+// The line is parsed once into a table of its words, the lookups do not go back to the text
 class Gcode {
     public:
         Gcode(const string&, StreamOutput*, bool strip=true);
+        // a G code from its words alone, there is no text to parse
+        Gcode(unsigned int g, const char letters[], const float values[], int n, StreamOutput*);
         Gcode(const Gcode& to_copy);
         Gcode& operator= (const Gcode& to_copy);
         ~Gcode();
@@ -50,7 +53,29 @@ class Gcode {
         string txt_after_ok;
 
     private:
+        // a letter and the number after it, pos is where the number starts in command, 0 for a word with no text
+        struct word_t {
+            char letter;
+            bool has_value;
+            uint16_t pos;
+            float value;
+        };
+        static const uint8_t max_words= 12;
+        // lines that fit are kept in here, longer ones go on the heap
+        static const uint8_t inline_size= 64;
+
+        void set_command(const char *s, size_t len);
         void prepare_cached_values(bool strip=true);
+        void parse_words();
+        const word_t *find(char letter) const;
+        const char *scan(char letter) const;
+        bool is_leading_word(int i) const;
+
         char *command;
+        char text[inline_size];
+        word_t words[max_words];
+        uint8_t n_words;
+        uint8_t n_args;                                  // letters other than T, as get_num_args() counts them
+        bool overflow;                                   // more words than max_words, the rest are looked up in the text
 };
 #endif
@@ -16,6 +16,8 @@
 #include "Gcode.h"
 #include "libs/StreamOutputPool.h"
 #include "StepTicker.h"
+#include "StepperMotor.h"
+#include "Robot.h"
 #include "platform_memory.h"
 
 #include "mri.h"
@@ -27,6 +29,7 @@ using std::string;
 
 uint8_t Block::n_actuators= 0;
 double Block::fp_scale= 0;
+bool Block::fp32_enable= false;
 
 // A block represents a movement, it's length for each stepper motor, and the corresponding acceleration curves.
 // It's stacked on a queue, and that queue is then executed in order, to move the motors.
@@ -35,7 +38,7 @@ double Block::fp_scale= 0;
 
 Block::Block()
 {
-    tick_info= nullptr;
+    tick_plan= nullptr;
     clear();
 }
 
@@ -54,10 +57,12 @@ void Block::clear()
     steps_event_count   = 0;
     nominal_rate        = 0.0F;
     nominal_speed       = 0.0F;
+    max_speed_ahead     = 0.0F;
     millimeters         = 0.0F;
     entry_speed         = 0.0F;
     exit_speed          = 0.0F;
     acceleration        = 100.0F; // we don't want to get divide by zeroes if this is not set
+    jerk                = 0.0F;
     initial_rate        = 0.0F;
     accelerate_until    = 0;
     decelerate_after    = 0;
@@ -65,48 +70,58 @@ void Block::clear()
     recalculate_flag    = false;
     nominal_length_flag = false;
     max_entry_speed     = 0.0F;
+    backlash[0]= backlash[1]= backlash[2]= 0.0F;
     is_ticking          = false;
     is_g123             = false;
     locked              = false;
+    s_curve             = false;
+    fp32                = false;
+    advance             = false;
+    advance_in          = false;
+    advance_out         = false;
+    step_multiplier     = 1;
     s_value             = 0.0F;
 
     total_move_ticks= 0;
-    if(tick_info == nullptr) {
+    accel_jerk_ticks= 0;
+    decel_jerk_ticks= 0;
+    if(tick_plan == nullptr) {
         // we create this once for this block
-        tick_info= new tickinfo_t[n_actuators]; //(tickinfo_t *)malloc(sizeof(tickinfo_t) * n_actuators);
-        if(tick_info == nullptr) {
+        tick_plan= new tickplan_t[n_actuators];
+        if(tick_plan == nullptr) {
             // if we ran out of memory in AHB0 just stop here
             __debugbreak();
         }
     }
 
     for(int i = 0; i < n_actuators; ++i) {
-        tick_info[i].steps_per_tick= 0;
-        tick_info[i].counter= 0;
-        tick_info[i].acceleration_change= 0;
-        tick_info[i].deceleration_change= 0;
-        tick_info[i].plateau_rate= 0;
-        tick_info[i].steps_to_move= 0;
-        tick_info[i].step_count= 0;
-        tick_info[i].next_accel_event= 0;
+        tick_plan[i].steps_per_tick= 0;
+        tick_plan[i].plateau_rate= 0;
+        tick_plan[i].acceleration_change= 0;
+        tick_plan[i].deceleration_change= 0;
+        tick_plan[i].accel_jerk= 0;
+        tick_plan[i].decel_jerk= 0;
+        tick_plan[i].steps_to_move= 0;
+        tick_plan[i].advance_steps= 0;
     }
+    tick_shift.rate= tick_shift.acceleration= tick_shift.jerk= 0;
 }
 
 void Block::debug() const
 {
-    THEKERNEL->streams->printf("%p: steps-X:%lu Y:%lu Z:%lu ", this, this->steps[0], this->steps[1], this->steps[2]);
+    THEKERNEL->streams->printf("%p: steps-X:%lu Y:%lu Z:%lu ", this, (unsigned long)this->steps[0], (unsigned long)this->steps[1], (unsigned long)this->steps[2]);
     for (size_t i = E_AXIS; i < n_actuators; ++i) {
-        THEKERNEL->streams->printf("%c:%lu ", 'A' + i-E_AXIS, this->steps[i]);
+        THEKERNEL->streams->printf("%c:%lu ", (int)('A' + i-E_AXIS), (unsigned long)this->steps[i]);
     }
     THEKERNEL->streams->printf("(max:%lu) nominal:r%1.4f/s%1.4f mm:%1.4f acc:%1.2f accu:%lu decu:%lu ticks:%lu rates:%1.4f/%1.4f entry/max:%1.4f/%1.4f exit:%1.4f primary:%d ready:%d locked:%d ticking:%d recalc:%d nomlen:%d time:%f\r\n",
-                               this->steps_event_count,
+                               (unsigned long)this->steps_event_count,
                                this->nominal_rate,
                                this->nominal_speed,
                                this->millimeters,
                                this->acceleration,
-                               this->accelerate_until,
-                               this->decelerate_after,
-                               this->total_move_ticks,
+                               (unsigned long)this->accelerate_until,
+                               (unsigned long)this->decelerate_after,
+                               (unsigned long)this->total_move_ticks,
                                this->initial_rate,
                                this->maximum_rate,
                                this->entry_speed,
@@ -177,6 +192,42 @@ void Block::calculate_trapezoid( float entryspeed, float exitspeed )
         plateau_time = plateau_distance / this->maximum_rate;
     }
 
+    // A jerk limited phase takes longer than a trapezoid one to change the rate as the acceleration has to ramp up
+    // and back down, so the block is planned again with those phase times and a lower maximum rate if they do not fit
+    if(this->jerk > 0.0F) {
+        float jerk_in_steps = (this->jerk * this->steps_event_count) / this->millimeters; // steps/s³
+        float lowest_rate = std::max(initial_rate, final_rate);
+
+        if(s_curve_steps(lowest_rate, initial_rate, final_rate, acceleration_per_second, jerk_in_steps) <= this->steps_event_count) {
+            if(s_curve_steps(this->maximum_rate, initial_rate, final_rate, acceleration_per_second, jerk_in_steps) > this->steps_event_count) {
+                // the distance grows with the rate, find the highest one that fits
+                float highest_rate = this->maximum_rate;
+                for (int i = 0; i < 16; ++i) {
+                    float rate = (lowest_rate + highest_rate) / 2.0F;
+                    if(s_curve_steps(rate, initial_rate, final_rate, acceleration_per_second, jerk_in_steps) > this->steps_event_count) {
+                        highest_rate = rate;
+                    } else {
+                        lowest_rate = rate;
+                    }
+                }
+                this->maximum_rate = lowest_rate;
+            }
+
+            time_to_accelerate = s_curve_time(this->maximum_rate - initial_rate, acceleration_per_second, jerk_in_steps);
+            time_to_decelerate = s_curve_time(this->maximum_rate - final_rate, acceleration_per_second, jerk_in_steps);
+            plateau_time = (this->steps_event_count - s_curve_steps(this->maximum_rate, initial_rate, final_rate, acceleration_per_second, jerk_in_steps)) / this->maximum_rate;
+
+        } else {
+            // the entry and exit speeds were planned at the acceleration alone and are too far apart for the jerk,
+            // the whole block changes the rate and the jerk ramps are shortened to fit
+            this->maximum_rate = lowest_rate;
+            float phase_time = (2.0F * this->steps_event_count) / (initial_rate + final_rate);
+            time_to_accelerate = (initial_rate < final_rate) ? phase_time : 0.0F;
+            time_to_decelerate = (initial_rate < final_rate) ? 0.0F : phase_time;
+            plateau_time = 0.0F;
+        }
+    }
+
     // Figure out how long the move takes total ( in seconds )
     float total_move_time = time_to_accelerate + time_to_decelerate + plateau_time;
     //puts "total move time: #{total_move_time}s time to accelerate: #{time_to_accelerate}, time to decelerate: #{time_to_decelerate}"
@@ -218,6 +269,17 @@ void Block::calculate_trapezoid( float entryspeed, float exitspeed )
     this->initial_rate = initial_rate;
     this->exit_speed = exitspeed;
 
+    // the acceleration is ramped up and down within each phase as long as it can be without going over the
+    // acceleration, the phases were planned long enough for the jerk above
+    this->s_curve = this->jerk > 0.0F;
+    if(this->s_curve) {
+        this->accel_jerk_ticks = jerk_ramp_ticks(acceleration_ticks, this->maximum_rate - initial_rate, acceleration_per_second);
+        this->decel_jerk_ticks = jerk_ramp_ticks(deceleration_ticks, this->maximum_rate - final_rate, acceleration_per_second);
+    } else {
+        this->accel_jerk_ticks = 0;
+        this->decel_jerk_ticks = 0;
+    }
+
     // prepare the block for stepticker
     this->prepare(acceleration_in_steps, deceleration_in_steps);
 
@@ -231,6 +293,87 @@ float Block::max_allowable_speed(float acceleration, float target_velocity, floa
     return sqrtf(target_velocity * target_velocity - 2.0F * acceleration * distance);
 }
 
+// Time in seconds a jerk limited phase takes to change the rate by rate_change steps/sec, the acceleration ramps up
+// at the jerk, holds at the acceleration and ramps back down. A change too small to reach the acceleration ramps
+// straight up and back down.
+float Block::s_curve_time(float rate_change, float acceleration, float jerk)
+{
+    if(rate_change <= 0.0F) return 0.0F;
+    if(rate_change * jerk >= acceleration * acceleration) return (rate_change / acceleration) + (acceleration / jerk);
+    return 2.0F * sqrtf(rate_change / jerk);
+}
+
+// Steps the jerk limited acceleration from initial_rate to rate and deceleration to final_rate cover, the profile
+// is symmetric so each phase covers the average of its two rates
+float Block::s_curve_steps(float rate, float initial_rate, float final_rate, float acceleration, float jerk)
+{
+    return (((initial_rate + rate) / 2.0F) * s_curve_time(rate - initial_rate, acceleration, jerk)) +
+           (((rate + final_rate) / 2.0F) * s_curve_time(rate - final_rate, acceleration, jerk));
+}
+
+// Work out how many ticks the acceleration takes to ramp up (and back down) for a phase lasting phase_ticks that
+// changes the rate by rate_change steps/sec, holding at no more than acceleration steps/sec² in between.
+// The ramps take as much of the phase as they can, half of it each at most, so a phase planned by s_curve_time()
+// ramps at the jerk and one that had to be shorter ramps faster rather than going over the acceleration.
+uint32_t Block::jerk_ramp_ticks(uint32_t phase_ticks, float rate_change, float acceleration)
+{
+    if(phase_ticks < 2 || rate_change <= 0.0F) return 0;
+
+    float hold_ticks = (rate_change / acceleration) * STEP_TICKER_FREQUENCY; // the phase at the acceleration alone
+    float ramp_ticks = std::min(phase_ticks / 2.0F, phase_ticks - hold_ticks);
+    if(ramp_ticks < 1.0F) return 0;
+    return floorf(ramp_ticks);
+}
+
+// Distance covered t ticks into an acceleration or deceleration phase, rates are in steps per tick.
+// With no jerk ramp the acceleration is constant, otherwise it ramps up over ramp_ticks, holds and ramps back down
+// over the last ramp_ticks, the profile is symmetric so the whole phase covers the average of the two rates.
+float Block::phase_steps(float t, float phase_ticks, float ramp_ticks, float start_rate, float end_rate)
+{
+    if(ramp_ticks <= 0.0F) {
+        return (start_rate * t) + ((end_rate - start_rate) * t * t / (2.0F * phase_ticks));
+    }
+
+    float peak = (end_rate - start_rate) / (phase_ticks - ramp_ticks); // acceleration while holding
+    float jerk = peak / ramp_ticks;
+
+    if(t <= ramp_ticks) {
+        return (start_rate * t) + (jerk * t * t * t / 6.0F);
+    }
+
+    if(t < phase_ticks - ramp_ticks) {
+        float u = t - ramp_ticks;
+        return (start_rate * ramp_ticks) + (peak * ramp_ticks * ramp_ticks / 6.0F) + ((start_rate + peak * ramp_ticks / 2.0F) * u) + (peak * u * u / 2.0F);
+    }
+
+    float u = phase_ticks - t;
+    return ((start_rate + end_rate) * phase_ticks / 2.0F) - (end_rate * u) + (jerk * u * u * u / 6.0F);
+}
+
+// Distance in steps the longest axis has covered the given number of ticks into the block, following the same
+// acceleration profile the step ticker generates. Used to cut the block into constant rate segments
+float Block::steps_at(uint32_t tick) const
+{
+    float initial = this->initial_rate / STEP_TICKER_FREQUENCY;
+    float maximum = this->maximum_rate / STEP_TICKER_FREQUENCY;
+    float final = (this->nominal_rate * (this->exit_speed / this->nominal_speed)) / STEP_TICKER_FREQUENCY;
+    float accel_ticks = this->accelerate_until;
+    float decel_ticks = this->total_move_ticks - this->decelerate_after;
+    float t = std::min(tick, this->total_move_ticks);
+
+    if(t <= accel_ticks) {
+        return phase_steps(t, accel_ticks, this->accel_jerk_ticks, initial, maximum);
+    }
+
+    float steps = (initial + maximum) * accel_ticks / 2.0F;
+    if(t <= this->decelerate_after) {
+        return steps + (maximum * (t - accel_ticks));
+    }
+
+    steps += maximum * (this->decelerate_after - accel_ticks);
+    return steps + phase_steps(t - this->decelerate_after, decel_ticks, this->decel_jerk_ticks, maximum, final);
+}
+
 // Called by Planner::recalculate() when scanning the plan from last to first entry.
 float Block::reverse_pass(float exit_speed)
 {
@@ -301,6 +444,24 @@ float Block::max_exit_speed()
     return min(max, nominal_speed);
 }
 
+// the step ticker values are worked out in 2.62 here, prepare() only runs in the main loop
+static StepTicker::tickinfo_t prepare_info[k_max_actuators];
+
+// smallest shift that fits a 2.62 fixed point value of up to max into the 32 bits of a tickplan_t
+static uint8_t plan_shift(uint64_t max)
+{
+    uint8_t shift= 0;
+    while((max >> shift) >= 0x7FFFFFFFULL) ++shift;
+    return shift;
+}
+
+// round a 2.62 fixed point value shifted right to 32 bits
+static int32_t plan_value(int64_t v, uint8_t shift)
+{
+    if(shift == 0) return (int32_t)v;
+    return (int32_t)((v + (1LL << (shift - 1))) >> shift);
+}
+
 // prepare block for the step ticker, called everytime the block changes
 // this is done during planning so does not delay tick generation and step ticker can simply grab the next block during the interrupt
 void Block::prepare(float acceleration_in_steps, float deceleration_in_steps)
@@ -313,60 +474,154 @@ void Block::prepare(float acceleration_in_steps, float deceleration_in_steps)
     // was....
     // float acceleration_per_tick = acceleration_in_steps / STEP_TICKER_FREQUENCY_2; // that is 100,000² too big for a float
     // float deceleration_per_tick = deceleration_in_steps / STEP_TICKER_FREQUENCY_2;
+    // fast blocks step in units of step_multiplier steps so the DDA rate stays below one per tick
+    this->step_multiplier = THEKERNEL->step_ticker->get_step_multiplier(this->nominal_rate);
+    float rate_scale = 1.0F / this->step_multiplier;
+    inv *= rate_scale;
+
     double acceleration_per_tick = acceleration_in_steps * fp_scale; // this is now scaled to fit a 2.30 fixed point number
     double deceleration_per_tick = deceleration_in_steps * fp_scale;
 
+    // S-curve, the acceleration ramps from 0 to a peak and back to 0, the peak is chosen so the total rate change over
+    // the phase is the same as the trapezoid, jerk_ramp_ticks() keeps it within the acceleration. The ramps are applied by the step ticker adding the jerk to acceleration_change each tick
+    double accel_jerk_per_tick = 0, decel_jerk_per_tick = 0;
+    if(this->s_curve) {
+        uint32_t acceleration_ticks = this->accelerate_until;
+        uint32_t deceleration_ticks = this->total_move_ticks - this->decelerate_after;
+        if(this->accel_jerk_ticks > 0) {
+            double peak = acceleration_per_tick * acceleration_ticks / (acceleration_ticks - this->accel_jerk_ticks);
+            accel_jerk_per_tick = peak / this->accel_jerk_ticks;
+        }
+        if(this->decel_jerk_ticks > 0) {
+            double peak = deceleration_per_tick * deceleration_ticks / (deceleration_ticks - this->decel_jerk_ticks);
+            decel_jerk_per_tick = peak / this->decel_jerk_ticks;
+        }
+    }
+
+    // The 1.31 fixed point path is used when every rate is below 1 step per tick and rounding the acceleration to 1.31
+    // can not move a step by more than 0.1 step. The rounding error is at most half a bit per tick so after t ticks
+    // a step is off by t²/2^33 at most, which limits the length of the acceleration and deceleration phases.
+    // S-curve blocks need the precision of 2.62 for the jerk
+    // Pressure advance, an extruder moving with XYZ gets an extra K times its acceleration added to its rate, which pushes
+    // the filament ahead while accelerating and pulls it back while decelerating (backwards if that is more than the rate).
+    // Over the block that adds up to K times the change of the extruder rate, which is added to its steps. A block next to
+    // one that does not extrude starts or ends with no lead.
+    // Not for S-curve or multi step blocks, the step ticker only does this on the 2.62 path
+    float advance_k[n_actuators];
+    this->advance = false;
     for (uint8_t m = 0; m < n_actuators; m++) {
+        advance_k[m] = 0;
+        if(this->steps[m] == 0 || !this->primary_axis || this->s_curve || this->step_multiplier > 1) continue;
+        if(THEROBOT->actuators[m]->is_extruder() && THEROBOT->actuators[m]->get_pressure_advance() > 0) {
+            advance_k[m] = THEROBOT->actuators[m]->get_pressure_advance();
+            this->advance = true;
+        }
+    }
+
+    uint32_t longest_ramp = std::max(this->accelerate_until, this->total_move_ticks - this->decelerate_after);
+    this->fp32 = fp32_enable && !this->s_curve && !this->advance &&
+                 this->initial_rate * rate_scale < STEP_TICKER_FREQUENCY && this->maximum_rate * rate_scale < STEP_TICKER_FREQUENCY &&
+                 (uint64_t)longest_ramp * longest_ramp <= (1ULL << 33) / 10;
+
+    for (uint8_t m = 0; m < n_actuators; m++) {
+        StepTicker::tickinfo_t &ti= prepare_info[m];
         uint32_t steps = this->steps[m];
-        this->tick_info[m].steps_to_move = steps;
+        ti.steps_to_move = steps;
+        ti.advance_steps = 0;
         if(steps == 0) continue;
 
         float aratio = inv * steps;
 
-        this->tick_info[m].steps_per_tick = (int64_t)round((((double)this->initial_rate * aratio) / STEP_TICKER_FREQUENCY) * STEPTICKER_FPSCALE); // steps/sec / tick frequency to get steps per tick in 2.62 fixed point
-        this->tick_info[m].counter = 0; // 2.62 fixed point
-        this->tick_info[m].step_count = 0;
-        this->tick_info[m].next_accel_event = this->total_move_ticks + 1;
+        ti.steps_per_tick = (int64_t)round((((double)this->initial_rate * aratio) / STEP_TICKER_FREQUENCY) * STEPTICKER_FPSCALE); // steps/sec / tick frequency to get steps per tick in 2.62 fixed point
 
+        // the step ticker works out the acceleration events when it loads the block, see StepTicker::load_tick_info()
         double acceleration_change = 0;
         if(this->accelerate_until != 0) { // If the next accel event is the end of accel
-            this->tick_info[m].next_accel_event = this->accelerate_until;
             acceleration_change = acceleration_per_tick;
 
         } else if(this->decelerate_after == 0 /*&& this->accelerate_until == 0*/) {
             // we start off decelerating
             acceleration_change = -deceleration_per_tick;
-
-        } else if(this->decelerate_after != this->total_move_ticks /*&& this->accelerate_until == 0*/) {
-            // If the next event is the start of decel ( don't set this if the next accel event is accel end )
-            this->tick_info[m].next_accel_event = this->decelerate_after;
         }
 
         // already converted to fixed point just needs scaling by ratio
         //#define STEPTICKER_TOFP(x) ((int64_t)round((double)(x)*STEPTICKER_FPSCALE))
-        this->tick_info[m].acceleration_change= (int64_t)round(acceleration_change * aratio);
-        this->tick_info[m].deceleration_change= -(int64_t)round(deceleration_per_tick * aratio);
-        this->tick_info[m].plateau_rate= (int64_t)round(((this->maximum_rate * aratio) / STEP_TICKER_FREQUENCY) * STEPTICKER_FPSCALE);
+        ti.acceleration_change= (int64_t)round(acceleration_change * aratio);
+        ti.deceleration_change= -(int64_t)round(deceleration_per_tick * aratio);
+        ti.plateau_rate= (int64_t)round(((this->maximum_rate * aratio) / STEP_TICKER_FREQUENCY) * STEPTICKER_FPSCALE);
+
+        if(this->s_curve) {
+            // a phase without a jerk ramp (too short) keeps the constant acceleration
+            if(this->accel_jerk_ticks > 0) ti.acceleration_change= 0;
+            if(this->decel_jerk_ticks > 0) {
+                if(this->accelerate_until == 0 && this->decelerate_after == 0) ti.acceleration_change= 0;
+                ti.deceleration_change= 0;
+            }
+            ti.accel_jerk= (int64_t)round(accel_jerk_per_tick * aratio);
+            ti.decel_jerk= (int64_t)round(decel_jerk_per_tick * aratio);
+        } else if(advance_k[m] > 0) {
+            // steps/sec² * K is steps/sec, in 2.62 fixed point per tick that is K * tick frequency * the acceleration per tick
+            double k = (double)advance_k[m] * STEP_TICKER_FREQUENCY;
+            ti.advance_accel= (int64_t)round(k * acceleration_per_tick * aratio);
+            ti.advance_decel= (int64_t)round(k * deceleration_per_tick * aratio);
+            ti.steps_per_tick += (this->accelerate_until != 0) ? ti.advance_accel :
+                                                 (this->decelerate_after == 0) ? -ti.advance_decel : 0;
+            // the lead is only carried over a junction with a block that extrudes as well, otherwise the extruder takes
+            // it up or pays it back evenly over the block so it ends where the block says
+            float final_rate = this->nominal_rate * (this->exit_speed / this->nominal_speed);
+            float lead_in = this->advance_in ? this->initial_rate : 0;
+            float lead_out = this->advance_out ? final_rate : 0;
+            if(this->total_move_ticks > 0) {
+                double spread = (double)advance_k[m] * ((this->initial_rate - lead_in) - (final_rate - lead_out)) * aratio / this->total_move_ticks;
+                int64_t c = (int64_t)round(spread * STEPTICKER_FPSCALE);
+                ti.steps_per_tick += c;
+                ti.plateau_rate += c;
+            }
+            ti.advance_steps = lroundf(advance_k[m] * lead_out * aratio) - lroundf(advance_k[m] * lead_in * aratio);
+
+        } else {
+            ti.accel_jerk= 0;
+            ti.decel_jerk= 0;
+        }
 
         #if 0
         THEKERNEL->streams->printf("spt: %08lX %08lX, ac: %08lX %08lX, dc: %08lX %08lX, pr: %08lX %08lX\n",
-            (uint32_t)(this->tick_info[m].steps_per_tick>>32), // 2.62 fixed point
-            (uint32_t)(this->tick_info[m].steps_per_tick&0xFFFFFFFF), // 2.62 fixed point
-            (uint32_t)(this->tick_info[m].acceleration_change>>32), // 2.62 fixed point signed
-            (uint32_t)(this->tick_info[m].acceleration_change&0xFFFFFFFF), // 2.62 fixed point signed
-            (uint32_t)(this->tick_info[m].deceleration_change>>32), // 2.62 fixed point
-            (uint32_t)(this->tick_info[m].deceleration_change&0xFFFFFFFF), // 2.62 fixed point
-            (uint32_t)(this->tick_info[m].plateau_rate>>32), // 2.62 fixed point
-            (uint32_t)(this->tick_info[m].plateau_rate&0xFFFFFFFF) // 2.62 fixed point
+            (uint32_t)(ti.steps_per_tick>>32), // 2.62 fixed point
+            (uint32_t)(ti.steps_per_tick&0xFFFFFFFF), // 2.62 fixed point
+            (uint32_t)(ti.acceleration_change>>32), // 2.62 fixed point signed
+            (uint32_t)(ti.acceleration_change&0xFFFFFFFF), // 2.62 fixed point signed
+            (uint32_t)(ti.deceleration_change>>32), // 2.62 fixed point
+            (uint32_t)(ti.deceleration_change&0xFFFFFFFF), // 2.62 fixed point
+            (uint32_t)(ti.plateau_rate>>32), // 2.62 fixed point
+            (uint32_t)(ti.plateau_rate&0xFFFFFFFF) // 2.62 fixed point
         );
         #endif
     }
-}
 
-// returns current rate (steps/sec) for the given actuator
-float Block::get_trapezoid_rate(int i) const
-{
-    // convert steps per tick from fixed point to float and convert to steps/sec
-    // FIXME steps_per_tick can change at any time, potential race condition if it changes while being read here
-    return STEPTICKER_FROMFP(tick_info[i].steps_per_tick) * STEP_TICKER_FREQUENCY;
+    // keep them in the block shifted down to 32 bits, by the same for each pair of values of all the motors
+    uint64_t max_rate= 0, max_acceleration= 0, max_jerk= 0;
+    for (uint8_t m = 0; m < n_actuators; m++) {
+        const StepTicker::tickinfo_t &ti= prepare_info[m];
+        if(ti.steps_to_move == 0) continue;
+        max_rate= std::max(max_rate, (uint64_t)std::max(llabs(ti.steps_per_tick), llabs(ti.plateau_rate)));
+        max_acceleration= std::max(max_acceleration, (uint64_t)std::max(llabs(ti.acceleration_change), llabs(ti.deceleration_change)));
+        max_jerk= std::max(max_jerk, (uint64_t)std::max(llabs(ti.accel_jerk), llabs(ti.decel_jerk)));
+    }
+    this->tick_shift.rate= plan_shift(max_rate);
+    this->tick_shift.acceleration= plan_shift(max_acceleration);
+    this->tick_shift.jerk= plan_shift(max_jerk);
+
+    for (uint8_t m = 0; m < n_actuators; m++) {
+        const StepTicker::tickinfo_t &ti= prepare_info[m];
+        tickplan_t &tp= this->tick_plan[m];
+        tp.steps_to_move= ti.steps_to_move;
+        tp.advance_steps= ti.advance_steps;
+        if(ti.steps_to_move == 0) continue;
+        tp.steps_per_tick= plan_value(ti.steps_per_tick, this->tick_shift.rate);
+        tp.plateau_rate= plan_value(ti.plateau_rate, this->tick_shift.rate);
+        tp.acceleration_change= plan_value(ti.acceleration_change, this->tick_shift.acceleration);
+        tp.deceleration_change= plan_value(ti.deceleration_change, this->tick_shift.acceleration);
+        tp.accel_jerk= plan_value(ti.accel_jerk, this->tick_shift.jerk);
+        tp.decel_jerk= plan_value(ti.decel_jerk, this->tick_shift.jerk);
+    }
 }
@@ -24,10 +24,14 @@ class Block {
         void debug() const;
         void ready() { is_ready= true; }
         void clear();
-        float get_trapezoid_rate(int i) const;
+        float steps_at(uint32_t tick) const;
 
     private:
         float max_allowable_speed( float acceleration, float target_velocity, float distance);
+        uint32_t jerk_ramp_ticks(uint32_t phase_ticks, float rate_change, float acceleration);
+        static float s_curve_time(float rate_change, float acceleration, float jerk);
+        static float s_curve_steps(float rate, float initial_rate, float final_rate, float acceleration, float jerk);
+        static float phase_steps(float t, float phase_ticks, float ramp_ticks, float start_rate, float end_rate);
         void prepare(float acceleration_in_steps, float deceleration_in_steps);
 
         static double fp_scale; // optimize to store this as it does not change
@@ -37,37 +41,52 @@ class Block {
         uint32_t steps_event_count;  // Steps for the longest axis
         float nominal_rate;       // Nominal rate in steps per second
         float nominal_speed;      // Nominal speed in mm per second
+        float max_speed_ahead;    // fastest nominal speed of this block and the ones queued after it, set by the planner
         float millimeters;        // Distance for this move
         float entry_speed;
         float exit_speed;
         float acceleration;       // the acceleration for this block
+        float jerk;               // jerk limit in mm/s³ for this block, 0 for a trapezoid profile
         float initial_rate;       // Initial rate in steps per second
         float maximum_rate;
 
         float max_entry_speed;
+        float backlash[3];        // backlash the XYZ actuators have taken up by the end of the block, see Robot::plan_backlash()
 
         // this is tick info needed for this block. applies to all motors
         uint32_t accelerate_until;
         uint32_t decelerate_after;
         uint32_t total_move_ticks;
+        // S-curve profiles only, length of the jerk ramps at each end of the acceleration and deceleration phases
+        uint32_t accel_jerk_ticks;
+        uint32_t decel_jerk_ticks;
         std::bitset<k_max_actuators> direction_bits;     // Direction for each axis in bit form, relative to the direction port's mask
 
-        // this is the data needed to determine when each motor needs to be issued a step
-        using tickinfo_t= struct {
-            int64_t steps_per_tick; // 2.62 fixed point
-            int64_t counter; // 2.62 fixed point
-            int64_t acceleration_change; // 2.62 fixed point signed
-            int64_t deceleration_change; // 2.62 fixed point
-            int64_t plateau_rate; // 2.62 fixed point
+        // what each motor needs to be stepped, loaded into the step ticker's tickinfo_t when the block starts. The values
+        // are the 2.62 fixed point ones shifted right by the tick_shift for the pair, chosen so the largest of the block
+        // fits in 32 bits, which keeps a queued block at half the size while the step interrupt still runs in 2.62
+        using tickplan_t= struct {
+            int32_t steps_per_tick;
+            int32_t plateau_rate;
+            int32_t acceleration_change; // signed, the acceleration at the start of the block
+            int32_t deceleration_change;
+            int32_t accel_jerk; // S-curve jerk or pressure advance rate offset while accelerating
+            int32_t decel_jerk; // S-curve jerk or pressure advance rate offset while decelerating
             uint32_t steps_to_move;
-            uint32_t step_count;
-            uint32_t next_accel_event;
+            int32_t advance_steps; // net steps pressure advance adds to steps_to_move, may be negative
         };
 
         // need info for each active motor
-        tickinfo_t *tick_info;
+        tickplan_t *tick_plan;
+        // how far the rates, accelerations and jerks (or advance offsets) in tick_plan are shifted
+        struct {
+            uint8_t rate;
+            uint8_t acceleration;
+            uint8_t jerk;
+        } tick_shift;
 
         static uint8_t n_actuators;
+        static bool fp32_enable; // allow the 1.31 fixed point step ticker path, set from config by the Planner
 
         struct {
             bool recalculate_flag:1;             // Planner flag to recalculate trapezoids on entry junction
@@ -77,6 +96,12 @@ class Block {
             bool is_g123:1;                      // set if this is a G1, G2 or G3
             volatile bool is_ticking:1;          // set when this block is being actively ticked by the stepticker
             volatile bool locked:1;              // set to true when the critical data is being updated, stepticker will have to skip if this is set
+            bool s_curve:1;                      // set if the acceleration phases are jerk limited
+            bool fp32:1;                         // set if the step ticker can run this block in 1.31 fixed point
+            bool advance:1;                      // set if an extruder in this block has pressure advance
+            bool advance_in:1;                   // the block before extrudes as well and hands its pressure advance lead on
+            bool advance_out:1;                  // the block after extrudes as well and takes the lead on
+            uint8_t step_multiplier:3;           // steps issued each time the step ticker DDA steps, 1, 2 or 4
             uint16_t s_value:12;                 // for laser 1.11 Fixed point
         };
 };
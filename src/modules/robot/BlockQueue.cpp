@@ -12,14 +12,14 @@
 BlockQueue::BlockQueue()
 {
     head_i = tail_i = length = 0;
-    isr_tail_i = tail_i;
+    isr_tail_i = planned_i = tail_i;
     ring = nullptr;
 }
 
 BlockQueue::BlockQueue(unsigned int length)
 {
     head_i = tail_i = 0;
-    isr_tail_i = tail_i;
+    isr_tail_i = planned_i = tail_i;
     void *v= AHB0.alloc(sizeof(Block) * length);
     ring = new(v) Block[length];
     // TODO: handle allocation failure
@@ -124,8 +124,12 @@ void BlockQueue::produce_head()
 
 void BlockQueue::consume_tail()
 {
-    if (!is_empty())
+    if (!is_empty()) {
+        // the planned block is being released, so the next one is the oldest one the planner may look at
+        if (planned_i == tail_i)
+            planned_i = next(tail_i);
         tail_i = next(tail_i);
+    }
 }
 
 /*
@@ -141,6 +145,13 @@ bool BlockQueue::is_full() const
     return r;
 }
 
+unsigned int BlockQueue::free() const
+{
+    if (length == 0)
+        return 0;
+    return (tail_i + length - head_i - 1) % length;
+}
+
 bool BlockQueue::is_empty() const
 {
     //__disable_irq();
@@ -164,7 +175,7 @@ bool BlockQueue::resize(unsigned int length)
 
             if (is_empty()) // check again in case something was pushed
             {
-                head_i = tail_i = this->length = 0;
+                head_i = tail_i = planned_i = this->length = 0;
 
                 __enable_irq();
 
@@ -194,7 +205,7 @@ bool BlockQueue::resize(unsigned int length)
             {
                 ring = newring;
                 this->length = length;
-                head_i = tail_i = 0;
+                head_i = tail_i = planned_i = 0;
 
                 __enable_irq();
 
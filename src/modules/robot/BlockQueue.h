@@ -37,6 +37,7 @@ public:
      */
     bool is_empty(void) const;
     bool is_full(void) const;
+    unsigned int free(void) const;   // blocks that can still be queued
 
     /*
      * resize
@@ -76,6 +77,10 @@ protected:
     volatile unsigned int tail_i;
     volatile unsigned int isr_tail_i;
 
+    // blocks from tail up to here have an optimal plan, their entry speeds can not change any more
+    // so the planner does not need to look further back than this. only used from the main loop
+    unsigned int planned_i;
+
 private:
     Block* ring;
 };
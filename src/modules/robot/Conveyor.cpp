@@ -102,8 +102,9 @@ void Conveyor::on_idle(void*)
         if (queue.is_empty()) {
             __debugbreak();
         } else {
-            // Cleanly delete block
+            // Cleanly delete block, unless its last segments are still being stepped
             Block* block = queue.tail_ref();
+            if(block == THEKERNEL->step_ticker->get_current_block()) return;
             //block->debug();
             block->clear();
             queue.consume_tail();
@@ -116,7 +117,8 @@ void Conveyor::on_idle(void*)
 // checks that all motors are no longer moving
 bool Conveyor::is_idle() const
 {
-    if(queue.is_empty()) {
+    // in segment mode blocks are finished once they are cut up, before they have been stepped
+    if(queue.is_empty() && !THEKERNEL->step_ticker->has_segments()) {
         for(auto &a : THEROBOT->actuators) {
             if(a->is_moving()) return false;
         }
@@ -129,6 +131,9 @@ bool Conveyor::is_idle() const
 // Wait for the queue to be empty and for all the jobs to finish in step ticker
 void Conveyor::wait_for_idle(bool wait_for_motors)
 {
+    // a line the Robot is holding back to merge with the next one has to be planned first
+    THEROBOT->flush_coalesced();
+
     // wait for the job queue to empty, this means cycling everything on the block queue into the job queue
     // forcing them to be jobs
     running = false; // stops on_idle calling check_queue
@@ -154,12 +159,14 @@ void Conveyor::wait_for_idle(bool wait_for_motors)
 void Conveyor::queue_head_block()
 {
     // upstream caller will block on this until there is room in the queue
+    uint32_t flushes= flush_count;
     while (queue.is_full() && !THEKERNEL->is_halted()) {
         //check_queue();
         THEKERNEL->call_event(ON_IDLE, this); // will call check_queue();
     }
 
-    if(THEKERNEL->is_halted()) {
+    // the queue it was planned to follow has been thrown away by a flush while it waited, so it goes too
+    if(THEKERNEL->is_halted() || flushes != flush_count) {
         // we do not want to stick more stuff on the queue if we are in halt state
         // clear and release the block on the head
         queue.head_ref()->clear();
@@ -231,19 +238,32 @@ void Conveyor::block_finished()
     queue.isr_tail_i= queue.next(queue.isr_tail_i);
 }
 
+float Conveyor::get_lookahead_distance()
+{
+    float mm= 0;
+    bool next= true;
+    for (unsigned int i = queue.isr_tail_i; i != queue.head_i; i = queue.next(i)) {
+        Block *b= queue.item_ref(i);
+        if(b->is_ticking) continue;
+        if(next) next= false; // this one is picked up next
+        else mm += b->millimeters;
+    }
+    return mm;
+}
+
 /*
-    In most cases this will not totally flush the queue, as when streaming
-    gcode there is one stalled waiting for space in the queue, in
-    queue_head_block() so after this flush, once main_loop runs again one more
-    gcode gets stuck in the queue, this is bad. Current work around is to call
-    this when the queue in not full and streaming has stopped
+    A block stalled waiting for space in the queue in queue_head_block() is
+    thrown away as well once this returns. The block being stepped is only
+    dropped if a feed hold has already brought it to a stop, otherwise it runs
+    to its end.
 */
 void Conveyor::flush_queue()
 {
     allow_fetch = false;
     flush= true;
+    ++flush_count;
 
-    // TODO force deceleration of last block
+    THEKERNEL->step_ticker->drop_held_block();
 
     // now wait until the block queue has been flushed
     wait_for_idle(false);
@@ -25,11 +25,17 @@ public:
     void wait_for_idle(bool wait_for_motors=true);
     bool is_queue_empty() { return queue.is_empty(); };
     bool is_queue_full() { return queue.is_full(); };
+    unsigned int get_queue_free() const { return queue.free(); }
     bool is_idle() const;
 
     // returns next available block writes it to block and returns true
     bool get_next_block(Block **block);
+    // true if get_next_block() would have a block to give or to flush, without taking it
+    bool has_next_block() const { return (allow_fetch || flush) && queue.isr_tail_i != queue.head_i; }
     void block_finished();
+    // length in mm of the queued blocks after the next one to be stepped, which is as far as the planner can still look
+    // ahead of the blocks whose speeds are fixed
+    float get_lookahead_distance();
 
     void dump_queue(void);
     void flush_queue(void);
@@ -48,6 +54,7 @@ private:
     uint32_t queue_delay_time_ms;
     size_t queue_size;
     float current_feedrate{0}; // actual nominal feedrate that current block is running at in mm/sec
+    uint32_t flush_count{0};   // flush_queue() calls, so a block waiting to be queued knows it was flushed
 
     struct {
         volatile bool running:1;
@@ -28,10 +28,13 @@ using namespace std;
 #define junction_deviation_checksum    CHECKSUM("junction_deviation")
 #define z_junction_deviation_checksum  CHECKSUM("z_junction_deviation")
 #define minimum_planner_speed_checksum CHECKSUM("minimum_planner_speed")
+#define s_curve_jerk_checksum          CHECKSUM("s_curve_jerk")
+#define stepticker_fp32_enable_checksum CHECKSUM("stepticker_fp32_enable")
 
 // The Planner does the acceleration math for the queue of Blocks ( movements ).
 // It makes sure the speed stays within the configured constraints ( acceleration, junction_deviation, etc )
 // It goes over the list in both direction, every time a block is added, re-doing the math to make sure everything is optimal
+// Only the blocks added since the last optimally planned one are revisited
 
 Planner::Planner()
 {
@@ -45,11 +48,13 @@ void Planner::config_load()
     this->junction_deviation = THEKERNEL->config->value(junction_deviation_checksum)->by_default(0.05F)->as_number();
     this->z_junction_deviation = THEKERNEL->config->value(z_junction_deviation_checksum)->by_default(NAN)->as_number(); // disabled by default
     this->minimum_planner_speed = THEKERNEL->config->value(minimum_planner_speed_checksum)->by_default(0.0f)->as_number();
+    this->s_curve_jerk = THEKERNEL->config->value(s_curve_jerk_checksum)->by_default(0.0f)->as_number(); // mm/s³, disabled by default
+    Block::fp32_enable = THEKERNEL->config->value(stepticker_fp32_enable_checksum)->by_default(false)->as_bool(); // opt in 32 bit step math when the block allows
 }
 
 
 // Append a block to the queue, compute it's speed factors
-bool Planner::append_block( ActuatorCoordinates &actuator_pos, uint8_t n_motors, float rate_mm_s, float distance, float *unit_vec, float acceleration, float s_value, bool g123)
+bool Planner::append_block( ActuatorCoordinates &actuator_pos, uint8_t n_motors, float rate_mm_s, float distance, float *unit_vec, float acceleration, float s_value, bool g123, const float backlash[])
 {
     // Create ( recycle ) a new block
     Block* block = THECONVEYOR->queue.head_ref();
@@ -79,6 +84,7 @@ bool Planner::append_block( ActuatorCoordinates &actuator_pos, uint8_t n_motors,
     // info needed by laser
     block->s_value = roundf(s_value*(1<<11)); // 1.11 fixed point
     block->is_g123 = g123;
+    for (int i = 0; i < 3; ++i) block->backlash[i] = backlash[i];
 
     // use default JD
     float junction_deviation = this->junction_deviation;
@@ -105,7 +111,22 @@ bool Planner::append_block( ActuatorCoordinates &actuator_pos, uint8_t n_motors,
         }
     }
 
+    // pressure advance hands the extruder's lead on from a block to the next only if both extrude with it
+    if(!THECONVEYOR->is_queue_empty()) {
+        Block *prev_block = THECONVEYOR->queue.item_ref(THECONVEYOR->queue.prev(THECONVEYOR->queue.head_i));
+        bool carried = false;
+        if(block->primary_axis && prev_block->primary_axis) {
+            for (size_t i = 0; i < n_motors; i++) {
+                StepperMotor *a = THEROBOT->actuators[i];
+                if(a->is_extruder() && a->get_pressure_advance() > 0 && block->steps[i] != 0 && prev_block->steps[i] != 0) carried = true;
+            }
+        }
+        prev_block->advance_out = carried;
+        block->advance_in = carried;
+    }
+
     block->acceleration = acceleration; // save in block
+    block->jerk = s_curve_jerk;
 
     // Max number of steps, for all axes
     auto mi = std::max_element(block->steps.begin(), block->steps.end());
@@ -197,6 +218,18 @@ bool Planner::append_block( ActuatorCoordinates &actuator_pos, uint8_t n_motors,
         memset(previous_unit_vec, 0, sizeof(previous_unit_vec));
     }
 
+    // the feed override and hold ramps are worked out by the step ticker for the fastest block still to be stepped, each
+    // block keeps the fastest speed from it to the end of the queue. That only goes down along the queue so walking back
+    // stops at the first block that is already as fast as this one
+    Conveyor::Queue_t &queue = THECONVEYOR->queue;
+    block->max_speed_ahead = block->nominal_speed;
+    for (unsigned int i = queue.head_i; i != queue.tail_i; ) {
+        i = queue.prev(i);
+        Block *b = queue.item_ref(i);
+        if(b->max_speed_ahead >= block->nominal_speed) break;
+        b->max_speed_ahead = block->nominal_speed;
+    }
+
     // Math-heavy re-computing of the whole queue to take the new
     this->recalculate();
 
@@ -241,6 +274,12 @@ void Planner::recalculate()
      *     then we're accel limited. set recalculate to false, work out max exit speed
      *
      * finally, work out trapezoid for the final (and newest) block.
+     *
+     * once a block has had its recalculate flag cleared every block before it is also optimally planned, as
+     * entry speeds only ever go up as blocks are added. queue.planned_i tracks the newest such block so the
+     * reverse pass never walks past it. the reverse pass also stops at the first block whose entry speed is unchanged,
+     * so the work per block is bounded by the blocks still planned to decelerate to the end of the queue,
+     * not by the queue length.
      */
 
     /*
@@ -254,18 +293,22 @@ void Planner::recalculate()
     current     = queue.item_ref(block_index);
 
     if (!queue.is_empty()) {
-        while ((block_index != queue.tail_i) && current->recalculate_flag) {
+        while ((block_index != queue.tail_i) && (block_index != queue.planned_i) && current->recalculate_flag) {
+            float previous_entry_speed = current->entry_speed;
             entry_speed = current->reverse_pass(entry_speed);
 
+            // the new block did not change this entry speed, so nothing before it changes either.
+            // this block is treated like a non-recalculate block below, its exit speed may still have changed
+            if (entry_speed == previous_entry_speed && block_index != queue.head_i) break;
+
             block_index = queue.prev(block_index);
             current     = queue.item_ref(block_index);
         }
 
         /*
          * Step 2:
-         * now current points to either tail or first non-recalculate block
-         * and has not had its reverse_pass called
-         * or its calculate_trapezoid
+         * now current points to either tail, the planned block, the first non-recalculate block
+         * or the first block whose entry speed did not change, and has not had its calculate_trapezoid
          * entry_speed is set to the *exit* speed of current.
          * each block from current to head has its entry speed set to its max entry speed- limited by decel or nominal_rate
          */
@@ -282,6 +325,10 @@ void Planner::recalculate()
             exit_speed = current->forward_pass(exit_speed);
 
             previous->calculate_trapezoid(previous->entry_speed, current->entry_speed);
+
+            // this block's entry speed is now final, so is everything before it
+            if (!current->recalculate_flag)
+                queue.planned_i = block_index;
         }
     }
 
@@ -20,13 +20,14 @@ public:
     friend class Robot; // for acceleration, junction deviation, minimum_planner_speed
 
 private:
-    bool append_block(ActuatorCoordinates &target, uint8_t n_motors, float rate_mm_s, float distance, float unit_vec[], float accleration, float s_value, bool g123);
+    bool append_block(ActuatorCoordinates &target, uint8_t n_motors, float rate_mm_s, float distance, float unit_vec[], float accleration, float s_value, bool g123, const float backlash[]);
     void recalculate();
     void config_load();
     float previous_unit_vec[N_PRIMARY_AXIS];
     float junction_deviation;    // Setting
     float z_junction_deviation;  // Setting
     float minimum_planner_speed; // Setting
+    float s_curve_jerk;          // Setting, 0 uses trapezoid profiles
 };
 
 
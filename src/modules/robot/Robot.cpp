@@ -25,6 +25,7 @@
 #include "arm_solutions/CoreXZSolution.h"
 #include "arm_solutions/MorganSCARASolution.h"
 #include "StepTicker.h"
+#include "RealtimeCommands.h"
 #include "checksumm.h"
 #include "utils.h"
 #include "ConfigValue.h"
@@ -46,8 +47,10 @@
 #define  default_feed_rate_checksum          CHECKSUM("default_feed_rate")
 #define  mm_per_line_segment_checksum        CHECKSUM("mm_per_line_segment")
 #define  delta_segments_per_second_checksum  CHECKSUM("delta_segments_per_second")
+#define  mm_max_line_error_checksum          CHECKSUM("mm_max_line_error")
 #define  mm_per_arc_segment_checksum         CHECKSUM("mm_per_arc_segment")
 #define  mm_max_arc_error_checksum           CHECKSUM("mm_max_arc_error")
+#define  jog_queue_time_ms_checksum          CHECKSUM("jog_queue_time_ms")
 #define  arc_correction_checksum             CHECKSUM("arc_correction")
 #define  x_axis_max_speed_checksum           CHECKSUM("x_axis_max_speed")
 #define  y_axis_max_speed_checksum           CHECKSUM("y_axis_max_speed")
@@ -98,6 +101,21 @@
 #define ymax_checksum                      CHECKSUM("y_max")
 #define zmax_checksum                      CHECKSUM("z_max")
 
+#define input_shaper_type_checksum         CHECKSUM("input_shaper_type")
+#define input_shaper_x_frequency_checksum  CHECKSUM("input_shaper_x_frequency")
+#define input_shaper_y_frequency_checksum  CHECKSUM("input_shaper_y_frequency")
+#define input_shaper_damping_checksum      CHECKSUM("input_shaper_damping")
+
+#define coalesce_deviation_checksum        CHECKSUM("coalesce_deviation")
+#define coalesce_max_angle_checksum        CHECKSUM("coalesce_max_angle")
+#define coalesce_max_length_checksum       CHECKSUM("coalesce_max_length")
+#define blend_tolerance_checksum           CHECKSUM("blend_tolerance")
+
+#define alpha_backlash_checksum            CHECKSUM("alpha_backlash")
+#define beta_backlash_checksum             CHECKSUM("beta_backlash")
+#define gamma_backlash_checksum            CHECKSUM("gamma_backlash")
+#define backlash_smoothing_mm_checksum     CHECKSUM("backlash_smoothing_mm")
+
 #define PI 3.14159265358979323846F // force to be float, do not use M_PI
 
 // The Robot converts GCodes into actual movements, and then adds them to the Planner, which passes them to the Conveyor so they can be added to the queue
@@ -111,8 +129,14 @@ Robot::Robot()
     this->select_plane(X_AXIS, Y_AXIS, Z_AXIS);
     memset(this->machine_position, 0, sizeof machine_position);
     memset(this->compensated_machine_position, 0, sizeof compensated_machine_position);
+    memset(this->backlash_state, 0, sizeof backlash_state);
     this->arm_solution = NULL;
     seconds_per_minute = 60.0F;
+    feed_override = 100.0F;
+    rapid_override = 100.0F;
+    in_jog = false;
+    jog_cancelled = false;
+    jog_queued_until = 0;
     this->clearToolOffset();
     this->compensationTransform = nullptr;
     this->get_e_scale_fnc= nullptr;
@@ -122,12 +146,16 @@ Robot::Robot()
     this->disable_segmentation= false;
     this->disable_arm_solution= false;
     this->n_motors= 0;
+    this->coalesced.pending= false;
+    this->spline_continues= false;
 }
 
 //Called when the module has just been loaded
 void Robot::on_module_loaded()
 {
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_event(ON_IDLE);
+    this->register_for_event(ON_HALT);
 
     // Configuration
     this->load_config();
@@ -150,6 +178,7 @@ void Robot::load_config()
     // Here we read the config to find out which arm solution to use
     if (this->arm_solution) delete this->arm_solution;
     int solution_checksum = get_checksum(THEKERNEL->config->value(arm_solution_checksum)->by_default("cartesian")->as_string());
+    this->cartesian_actuators = false;
     // Note checksums are not const expressions when in debug mode, so don't use switch
     if(solution_checksum == hbot_checksum || solution_checksum == corexy_checksum) {
         this->arm_solution = new HBotSolution(THEKERNEL->config);
@@ -171,18 +200,27 @@ void Robot::load_config()
 
     } else if(solution_checksum == cartesian_checksum) {
         this->arm_solution = new CartesianSolution(THEKERNEL->config);
+        this->cartesian_actuators = true;
 
     } else {
         this->arm_solution = new CartesianSolution(THEKERNEL->config);
+        this->cartesian_actuators = true;
     }
 
     this->feed_rate           = THEKERNEL->config->value(default_feed_rate_checksum   )->by_default(  100.0F)->as_number();
     this->seek_rate           = THEKERNEL->config->value(default_seek_rate_checksum   )->by_default(  100.0F)->as_number();
     this->mm_per_line_segment = THEKERNEL->config->value(mm_per_line_segment_checksum )->by_default(    0.0F)->as_number();
     this->delta_segments_per_second = THEKERNEL->config->value(delta_segments_per_second_checksum )->by_default(0.0f   )->as_number();
+    this->mm_max_line_error   = THEKERNEL->config->value(mm_max_line_error_checksum   )->by_default(    0.0F)->as_number();
     this->mm_per_arc_segment  = THEKERNEL->config->value(mm_per_arc_segment_checksum  )->by_default(    0.0f)->as_number();
     this->mm_max_arc_error    = THEKERNEL->config->value(mm_max_arc_error_checksum    )->by_default(   0.01f)->as_number();
     this->arc_correction      = THEKERNEL->config->value(arc_correction_checksum      )->by_default(    5   )->as_number();
+    this->jog_queue_us        = THEKERNEL->config->value(jog_queue_time_ms_checksum   )->by_default(  100   )->as_number() * 1000;
+    this->coalesce_deviation  = THEKERNEL->config->value(coalesce_deviation_checksum  )->by_default(    0.0F)->as_number();
+    this->coalesce_cos_angle  = cosf(THEKERNEL->config->value(coalesce_max_angle_checksum)->by_default(5.0F)->as_number() * PI / 180.0F);
+    this->coalesce_max_length = THEKERNEL->config->value(coalesce_max_length_checksum )->by_default(    5.0F)->as_number();
+    this->default_blend_tolerance= THEKERNEL->config->value(blend_tolerance_checksum  )->by_default(   0.02F)->as_number();
+    this->blend_tolerance     = 0; // G61 exact path by default
 
     // in mm/sec but specified in config as mm/min
     this->max_speeds[X_AXIS]  = THEKERNEL->config->value(x_axis_max_speed_checksum    )->by_default(60000.0F)->as_number() / 60.0F;
@@ -233,7 +271,7 @@ void Robot::load_config()
 
         if(!pins[0].connected() || !pins[1].connected()) { // step and dir must be defined, but enable is optional
             if(a <= Z_AXIS) {
-                THEKERNEL->streams->printf("FATAL: motor %c is not defined in config\n", 'X'+a);
+                THEKERNEL->streams->printf("FATAL: motor %c is not defined in config\n", (int)('X'+a));
                 n_motors= a; // we only have this number of motors
                 return;
             }
@@ -245,7 +283,7 @@ void Robot::load_config()
         uint8_t n= register_motor(sm);
         if(n != a) {
             // this is a fatal error
-            THEKERNEL->streams->printf("FATAL: motor %d does not match index %d\n", n, a);
+            THEKERNEL->streams->printf("FATAL: motor %d does not match index %d\n", n, (int)a);
             return;
         }
 
@@ -290,6 +328,31 @@ void Robot::load_config()
     soft_endstop_max[X_AXIS]= THEKERNEL->config->value(soft_endstop_checksum, xmax_checksum)->by_default(NAN)->as_number();
     soft_endstop_max[Y_AXIS]= THEKERNEL->config->value(soft_endstop_checksum, ymax_checksum)->by_default(NAN)->as_number();
     soft_endstop_max[Z_AXIS]= THEKERNEL->config->value(soft_endstop_checksum, zmax_checksum)->by_default(NAN)->as_number();
+
+    backlash[X_AXIS]= THEKERNEL->config->value(alpha_backlash_checksum)->by_default(0.0F)->as_number();
+    backlash[Y_AXIS]= THEKERNEL->config->value(beta_backlash_checksum)->by_default(0.0F)->as_number();
+    backlash[Z_AXIS]= THEKERNEL->config->value(gamma_backlash_checksum)->by_default(0.0F)->as_number();
+    backlash_smoothing= THEKERNEL->config->value(backlash_smoothing_mm_checksum)->by_default(0.0F)->as_number();
+
+    // input shaping of the first two actuators, which are only X and Y on a cartesian. The shapers delay each
+    // actuator on its own so on any other arm solution they would bend the path, shaping is refused there
+    InputShaper::TYPE shaper= InputShaper::type_from_name(THEKERNEL->config->value(input_shaper_type_checksum)->by_default("none")->as_string());
+    this->input_shaper_type= (shaper == InputShaper::NONE) ? InputShaper::ZV : shaper;
+    if(shaper != InputShaper::NONE && !this->cartesian_actuators) {
+        THEKERNEL->streams->printf("WARNING: input shaping needs the cartesian arm solution, it is not used\n");
+
+    } else if(shaper != InputShaper::NONE) {
+        float damping= THEKERNEL->config->value(input_shaper_damping_checksum)->by_default(0.1F)->as_number();
+        float freq[2]= {
+            THEKERNEL->config->value(input_shaper_x_frequency_checksum)->by_default(0.0F)->as_number(),
+            THEKERNEL->config->value(input_shaper_y_frequency_checksum)->by_default(0.0F)->as_number()
+        };
+        for (int i = X_AXIS; i <= Y_AXIS; ++i) {
+            if(freq[i] > 0 && !THEKERNEL->step_ticker->set_input_shaper(i, shaper, freq[i], damping)) {
+                THEKERNEL->streams->printf("WARNING: input shaper for %c can not be used at %1.2fHz damping %1.3f\n", 'X'+i, freq[i], damping);
+            }
+        }
+    }
 }
 
 uint8_t Robot::register_motor(StepperMotor *motor)
@@ -343,11 +406,11 @@ std::vector<Robot::wcs_t> Robot::get_wcs_state() const
 
 void Robot::get_current_machine_position(float *pos) const
 {
-    // get real time current actuator position in mm
+    // get real time current actuator position in mm, less any backlash taken up by the moves stepped so far
     ActuatorCoordinates current_position{
-        actuators[X_AXIS]->get_current_position(),
-        actuators[Y_AXIS]->get_current_position(),
-        actuators[Z_AXIS]->get_current_position()
+        actuators[X_AXIS]->get_current_position() - actuators[X_AXIS]->get_backlash(),
+        actuators[Y_AXIS]->get_current_position() - actuators[Y_AXIS]->get_backlash(),
+        actuators[Z_AXIS]->get_current_position() - actuators[Z_AXIS]->get_backlash()
     };
 
     // get machine position from the actuator position using FK
@@ -435,25 +498,193 @@ Robot::wcs_t Robot::mcs2wcs(const Robot::wcs_t& pos) const
 
 // this does a sanity check that actuator speeds do not exceed steps rate capability
 // we will override the actuator max_rate if the combination of max_rate and steps/sec exceeds base_stepping_frequency
+// (times the step multiplier when multi stepping is enabled)
 void Robot::check_max_actuator_speeds()
 {
+    float max_step_rate = THEKERNEL->step_ticker->get_max_step_rate();
     for (size_t i = 0; i < n_motors; i++) {
         if(actuators[i]->is_extruder()) continue; //extruders are not included in this check
 
         float step_freq = actuators[i]->get_max_rate() * actuators[i]->get_steps_per_mm();
-        if (step_freq > THEKERNEL->base_stepping_frequency) {
-            actuators[i]->set_max_rate(floorf(THEKERNEL->base_stepping_frequency / actuators[i]->get_steps_per_mm()));
-            THEKERNEL->streams->printf("WARNING: actuator %d rate exceeds base_stepping_frequency * ..._steps_per_mm: %f, setting to %f\n", i, step_freq, actuators[i]->get_max_rate());
+        if (step_freq > max_step_rate) {
+            actuators[i]->set_max_rate(floorf(max_step_rate / actuators[i]->get_steps_per_mm()));
+            THEKERNEL->streams->printf("WARNING: actuator %d rate exceeds base_stepping_frequency * ..._steps_per_mm: %f, setting to %f\n", (int)i, step_freq, actuators[i]->get_max_rate());
         }
     }
 }
 
 //A GCode has been received
 //See if the current Gcode line has some orders for us
+void Robot::on_idle(void *)
+{
+    // don't hold back a line waiting for more to merge with it once the queue is too short to stop in from its speed,
+    // the moves ahead of it would have to slow down for a stop that is not there
+    if(coalesced.pending) {
+        float stopping= (coalesced.rate * coalesced.rate) / (2.0F * default_acceleration);
+        if(THECONVEYOR->get_lookahead_distance() <= stopping) flush_coalesced();
+    }
+
+    // the realtime commands have already slowed what is queued, this catches the planning up
+    RealtimeCommands *rt= THEKERNEL->realtime;
+    if(rt->take(RealtimeCommands::FEED_OVERRIDE)) set_feed_override(rt->get_feed_override());
+    if(rt->take(RealtimeCommands::RAPID_OVERRIDE)) rapid_override= rt->get_rapid_override();
+
+    if(rt->is_jogging()) {
+        // a cancelled jog is thrown away once the hold has stopped it
+        if(THEKERNEL->step_ticker->is_held() && rt->take(RealtimeCommands::CANCEL_JOG)) {
+            cancel_jog();
+        } else if(!in_jog && !THEKERNEL->get_feed_hold() && THECONVEYOR->is_idle()) {
+            rt->set_jogging(false);
+        }
+    }
+}
+
+// $J= grbl jog, G20/G21, G90/G91, G53 and the axis words, F is required. The move is planned as a G1 but none of the
+// modal state changes, and the realtime jog cancel throws away what is left of it. To keep streamed jogs responsive this
+// waits until the ones already queued would be done within jog_queue_time_ms before queuing another
+bool Robot::jog(const std::string &line, StreamOutput *stream, std::string &error)
+{
+    error.clear();
+    if(THEKERNEL->get_feed_hold()) {
+        error= "Jog not allowed in feed hold";
+        return false;
+    }
+
+    push_state();
+    bool mcs= false, has_f= false, has_axis= false;
+    std::string move("G1");
+    const char *p= line.c_str();
+    while(*p != '\0') {
+        if(isspace(*p)) {
+            ++p;
+            continue;
+        }
+
+        char c= toupper(*p++);
+        char *e;
+        float v= strtof(p, &e);
+        if(e == p) {
+            error= "Bad number format";
+            pop_state();
+            return false;
+        }
+
+        if(c == 'G') {
+            int g= lroundf(v);
+            if(g == 20) inch_mode= true;
+            else if(g == 21) inch_mode= false;
+            else if(g == 90) absolute_mode= true;
+            else if(g == 91) absolute_mode= false;
+            else if(g == 53) mcs= true;
+            else c= 0;
+
+        } else if(c == 'F' || (strchr("XYZABC", c) != nullptr && (c >= 'X' ? c - 'X' : c - 'A' + A_AXIS) < n_motors)) {
+            // copied through as it was written for process_move()
+            move.append(1, ' ').append(1, c).append(p, e - p);
+            if(c == 'F') has_f= v > 0; else has_axis= true;
+
+        } else if(c != 'N') {
+            c= 0;
+        }
+
+        if(c == 0) {
+            error= "Invalid jog command";
+            pop_state();
+            return false;
+        }
+        p= e;
+    }
+
+    if(!has_f || !has_axis) {
+        error= has_f ? "Invalid jog command" : "Undefined feed rate";
+        pop_state();
+        return false;
+    }
+
+    // do not merge with a line held from before
+    flush_coalesced();
+
+    // a cancel while this waits throws this one away too
+    in_jog= true;
+    while((int32_t)(jog_queued_until - us_ticker_read()) > (int32_t)jog_queue_us && !jog_cancelled && !THEKERNEL->is_halted()) {
+        THEKERNEL->call_event(ON_IDLE, this);
+    }
+
+    if(!jog_cancelled) {
+        float start[3];
+        memcpy(start, machine_position, sizeof(start));
+
+        Gcode gcode(move, stream);
+        THEKERNEL->realtime->set_jogging(true);
+        next_command_is_MCS= mcs;
+        process_move(&gcode, LINEAR);
+        next_command_is_MCS= false;
+        flush_coalesced();
+        if(gcode.is_error) error= gcode.txt_after_ok;
+
+        uint32_t now= us_ticker_read();
+        if((int32_t)(jog_queued_until - now) < 0) jog_queued_until= now;
+        float d= sqrtf(powf(machine_position[X_AXIS] - start[X_AXIS], 2) + powf(machine_position[Y_AXIS] - start[Y_AXIS], 2) + powf(machine_position[Z_AXIS] - start[Z_AXIS], 2));
+        jog_queued_until += d / (feed_rate / seconds_per_minute) * 1000000;
+
+        // jogs run straight away
+        THECONVEYOR->force_queue();
+    }
+    in_jog= false;
+    pop_state();
+
+    if(jog_cancelled) {
+        // if it was part way through being queued process_move() has just set the target it did not get to
+        jog_cancelled= false;
+        reset_position_from_current_actuator_position();
+    }
+
+    return error.empty();
+}
+
+// the realtime jog cancel has held the jog and the motors have stopped
+void Robot::cancel_jog()
+{
+    coalesced.pending= false;
+    // the step ticker drops the block it is holding as well
+    THECONVEYOR->flush_queue();
+    reset_position_from_current_actuator_position();
+    if(in_jog) jog_cancelled= true;
+    jog_queued_until= us_ticker_read();
+    THEKERNEL->realtime->set_jogging(false);
+    THEKERNEL->set_feed_hold(false);
+}
+
+// from M220 and the realtime feed override commands
+void Robot::set_feed_override(float factor)
+{
+    // enforce minimum 10% speed
+    if (factor < 10.0F)
+        factor = 10.0F;
+    // enforce maximum 10x speed
+    if (factor > 1000.0F)
+        factor = 1000.0F;
+
+    feed_override = factor;
+    // slowing down is done by the step ticker so it applies to the moves already queued straight away,
+    // speeding up above 100% has to be planned as it raises the accelerations as well
+    THEKERNEL->step_ticker->set_speed_factor(std::min(factor, 100.0F) / 100.0F);
+    seconds_per_minute = 6000.0F / std::max(factor, 100.0F);
+}
+
+void Robot::on_halt(void *argument)
+{
+    // the held line is dropped with the rest of the queue
+    if(argument == nullptr) coalesced.pending= false;
+}
+
 void Robot::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
 
+    // anything but another line has to be done after the held line, other modules see the gcode after us
+    if(coalesced.pending && !(gcode->has_g && (gcode->g == 0 || gcode->g == 1))) flush_coalesced();
+
     enum MOTION_MODE_T motion_mode= NONE;
 
     if( gcode->has_g) {
@@ -462,6 +693,10 @@ void Robot::on_gcode_received(void *argument)
             case 1:  motion_mode = LINEAR;  break;
             case 2:  motion_mode = CW_ARC;  break;
             case 3:  motion_mode = CCW_ARC; break;
+            case 5:  // G5 cubic and G5.1 quadratic Bézier
+                if(gcode->subcode == 0) motion_mode = CUBIC_SPLINE;
+                else if(gcode->subcode == 1) motion_mode = QUADRATIC_SPLINE;
+                break;
             case 4: { // G4 Dwell
                 uint32_t delay_ms = 0;
                 if (gcode->has_letter('P')) {
@@ -538,6 +773,12 @@ void Robot::on_gcode_received(void *argument)
             case 20: this->inch_mode = true;   break;
             case 21: this->inch_mode = false;   break;
 
+            case 61: this->blend_tolerance = 0; break; // exact path
+            case 64: // G64 Pn blend corners staying within n of the path
+                this->blend_tolerance = gcode->has_letter('P') ? this->to_millimeters(gcode->get_value('P')) : this->default_blend_tolerance;
+                if(this->blend_tolerance < 0) this->blend_tolerance = 0;
+                break;
+
             case 54: case 55: case 56: case 57: case 58: case 59:
                 // select WCS 0-8: G54..G59, G59.1, G59.2, G59.3
                 current_wcs = gcode->g - 54;
@@ -646,7 +887,7 @@ void Robot::on_gcode_received(void *argument)
                     }
 
                     THEKERNEL->conveyor->wait_for_idle();
-                    THEKERNEL->call_event(ON_ENABLE, (void *)bm);
+                    THEKERNEL->call_event(ON_ENABLE, (void *)(uintptr_t)bm);
                     break;
                 }
                 // fall through
@@ -689,12 +930,12 @@ void Robot::on_gcode_received(void *argument)
             case 203: // M203 Set maximum feedrates in mm/sec, M203.1 set maximum actuator feedrates
                     if(gcode->get_num_args() == 0) {
                         for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
-                            gcode->stream->printf(" %c: %g ", 'X' + i, gcode->subcode == 0 ? this->max_speeds[i] : actuators[i]->get_max_rate());
+                            gcode->stream->printf(" %c: %g ", (int)('X' + i), gcode->subcode == 0 ? this->max_speeds[i] : actuators[i]->get_max_rate());
                         }
                         if(gcode->subcode == 1) {
                             for (size_t i = A_AXIS; i < n_motors; i++) {
                                 if(actuators[i]->is_extruder()) continue; //extruders handle this themselves
-                                gcode->stream->printf(" %c: %g ", 'A' + i - A_AXIS, actuators[i]->get_max_rate());
+                                gcode->stream->printf(" %c: %g ", (int)('A' + i - A_AXIS), actuators[i]->get_max_rate());
                             }
                         }else{
                             gcode->stream->printf(" S: %g ", this->max_speed);
@@ -761,7 +1002,7 @@ void Robot::on_gcode_received(void *argument)
                 }
                 break;
 
-            case 205: // M205 Xnnn - set junction deviation, Z - set Z junction deviation, Snnn - Set minimum planner speed
+            case 205: // M205 Xnnn - set junction deviation, Z - set Z junction deviation, Snnn - Set minimum planner speed, Jnnn - set S-curve jerk
                 if (gcode->has_letter('X')) {
                     float jd = gcode->get_value('X');
                     // enforce minimum
@@ -783,6 +1024,13 @@ void Robot::on_gcode_received(void *argument)
                         mps = 0.0F;
                     THEKERNEL->planner->minimum_planner_speed = mps;
                 }
+                if (gcode->has_letter('J')) {
+                    float jerk = gcode->get_value('J');
+                    // 0 disables S-curve
+                    if (jerk < 0.0F)
+                        jerk = 0.0F;
+                    THEKERNEL->planner->s_curve_jerk = jerk;
+                }
                 break;
 
             case 211: // M211 Sn turns soft endstops on/off
@@ -807,17 +1055,11 @@ void Robot::on_gcode_received(void *argument)
 
             case 220: // M220 - speed override percentage
                 if (gcode->has_letter('S')) {
-                    float factor = gcode->get_value('S');
-                    // enforce minimum 10% speed
-                    if (factor < 10.0F)
-                        factor = 10.0F;
-                    // enforce maximum 10x speed
-                    if (factor > 1000.0F)
-                        factor = 1000.0F;
-
-                    seconds_per_minute = 6000.0F / factor;
+                    set_feed_override(gcode->get_value('S'));
+                    // the realtime override steps carry on from here
+                    THEKERNEL->realtime->set_feed_override(feed_override);
                 } else {
-                    gcode->stream->printf("Speed factor at %6.2f %%\n", 6000.0F / seconds_per_minute);
+                    gcode->stream->printf("Speed factor at %6.2f %%\n", feed_override);
                 }
                 break;
 
@@ -825,6 +1067,55 @@ void Robot::on_gcode_received(void *argument)
                 THEKERNEL->conveyor->wait_for_idle();
                 break;
 
+            case 425: // M425 Xnnn Ynnn Znnn - set the backlash in mm, Snnn - set the mm of travel the take up is smoothed over
+                if(!gcode->has_letter('X') && !gcode->has_letter('Y') && !gcode->has_letter('Z') && !gcode->has_letter('S')) {
+                    gcode->stream->printf("Backlash X:%1.4f Y:%1.4f Z:%1.4f smoothing:%1.4f\n", backlash[X_AXIS], backlash[Y_AXIS], backlash[Z_AXIS], backlash_smoothing);
+                    break;
+                }
+                for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+                    if(gcode->has_letter('X'+i)) {
+                        float b= gcode->get_value('X'+i);
+                        backlash[i]= b < 0 ? 0 : b;
+                    }
+                }
+                if(gcode->has_letter('S')) {
+                    float sm= gcode->get_value('S');
+                    backlash_smoothing= sm < 0 ? 0 : sm;
+                }
+                break;
+
+            case 593: { // M593 X Y Fnnn Dnnn - set the input shaper frequency (0 turns it off) and damping ratio for X and/or Y (both if neither is given)
+                bool both= !gcode->has_letter('X') && !gcode->has_letter('Y');
+                if(!gcode->has_letter('F') && !gcode->has_letter('D')) {
+                    for (int i = X_AXIS; i <= Y_AXIS; ++i) {
+                        const InputShaper *s= THEKERNEL->step_ticker->get_input_shaper(i);
+                        if(s == nullptr) gcode->stream->printf("%c: no input shaping\n", 'X'+i);
+                        else gcode->stream->printf("%c: %s F%1.2f D%1.3f\n", 'X'+i, InputShaper::type_name(s->get_type()), s->get_frequency(), s->get_damping());
+                    }
+                    break;
+                }
+
+                if(!cartesian_actuators) {
+                    gcode->stream->printf("error:input shaping needs the cartesian arm solution\n");
+                    break;
+                }
+
+                // the shapers can only be changed when nothing is moving
+                THEKERNEL->conveyor->wait_for_idle();
+                for (int i = X_AXIS; i <= Y_AXIS; ++i) {
+                    if(!both && !gcode->has_letter('X'+i)) continue;
+                    const InputShaper *s= THEKERNEL->step_ticker->get_input_shaper(i);
+                    InputShaper::TYPE type= s != nullptr ? s->get_type() : (InputShaper::TYPE)input_shaper_type;
+                    float f= gcode->has_letter('F') ? gcode->get_value('F') : (s != nullptr ? s->get_frequency() : 0);
+                    float d= gcode->has_letter('D') ? gcode->get_value('D') : (s != nullptr ? s->get_damping() : 0.1F);
+                    if(f <= 0) type= InputShaper::NONE;
+                    if(!THEKERNEL->step_ticker->set_input_shaper(i, type, f, d)) {
+                        gcode->stream->printf("error:input shaper for %c can not be used at %1.2fHz damping %1.3f\n", 'X'+i, f, d);
+                    }
+                }
+            }
+            break;
+
             case 500: // M500 saves some volatile settings to config override file
             case 503: { // M503 just prints the settings
                 gcode->stream->printf(";Steps per unit:\nM92 ");
@@ -844,7 +1135,7 @@ void Robot::on_gcode_received(void *argument)
                 }
                 gcode->stream->printf("\n");
 
-                gcode->stream->printf(";X- Junction Deviation, Z- Z junction deviation, S - Minimum Planner speed mm/sec:\nM205 X%1.5f Z%1.5f S%1.5f\n", THEKERNEL->planner->junction_deviation, isnan(THEKERNEL->planner->z_junction_deviation)?-1:THEKERNEL->planner->z_junction_deviation, THEKERNEL->planner->minimum_planner_speed);
+                gcode->stream->printf(";X- Junction Deviation, Z- Z junction deviation, S - Minimum Planner speed mm/sec, J - S-curve jerk mm/sec³:\nM205 X%1.5f Z%1.5f S%1.5f J%1.5f\n", THEKERNEL->planner->junction_deviation, isnan(THEKERNEL->planner->z_junction_deviation)?-1:THEKERNEL->planner->z_junction_deviation, THEKERNEL->planner->minimum_planner_speed, THEKERNEL->planner->s_curve_jerk);
 
                 gcode->stream->printf(";Max cartesian feedrates in mm/sec:\nM203 X%1.5f Y%1.5f Z%1.5f S%1.5f\n", this->max_speeds[X_AXIS], this->max_speeds[Y_AXIS], this->max_speeds[Z_AXIS], this->max_speed);
 
@@ -856,6 +1147,15 @@ void Robot::on_gcode_received(void *argument)
                 }
                 gcode->stream->printf("\n");
 
+                if(backlash[X_AXIS] > 0 || backlash[Y_AXIS] > 0 || backlash[Z_AXIS] > 0) {
+                    gcode->stream->printf(";Backlash mm and smoothing mm:\nM425 X%1.5f Y%1.5f Z%1.5f S%1.5f\n", backlash[X_AXIS], backlash[Y_AXIS], backlash[Z_AXIS], backlash_smoothing);
+                }
+
+                for (int i = X_AXIS; i <= Y_AXIS; ++i) {
+                    const InputShaper *s= THEKERNEL->step_ticker->get_input_shaper(i);
+                    if(s != nullptr) gcode->stream->printf(";Input shaper frequency Hz and damping ratio:\nM593 %c F%1.2f D%1.3f\n", 'X'+i, s->get_frequency(), s->get_damping());
+                }
+
                 // get or save any arm solution specific optional values
                 BaseSolution::arm_options_t options;
                 if(arm_solution->get_optional(options) && !options.empty()) {
@@ -920,6 +1220,10 @@ void Robot::on_gcode_received(void *argument)
                     this->mm_per_line_segment = gcode->get_value('U');
                     this->delta_segments_per_second = 0;
                     gcode->stream->printf("mm per line segment set to %8.4f\n", this->mm_per_line_segment);
+
+                } else if(gcode->has_letter('V')) { // or set mm_max_line_error, not saved by M500
+                    this->mm_max_line_error = gcode->get_value('V');
+                    gcode->stream->printf("max line error set to %8.4f\n", this->mm_max_line_error);
                 }
 
                 break;
@@ -947,10 +1251,10 @@ int Robot::get_active_extruder() const
     return 0;
 }
 
-// process a G0/G1/G2/G3
+// process a G0/G1/G2/G3/G5
 void Robot::process_move(Gcode *gcode, enum MOTION_MODE_T motion_mode)
 {
-    // we have a G0/G1/G2/G3 so extract parameters and apply offsets to get machine coordinate target
+    // we have a G0/G1/G2/G3/G5 so extract parameters and apply offsets to get machine coordinate target
     // get XYZ and one E (which goes to the selected extruder)
     float param[4]{NAN, NAN, NAN, NAN};
 
@@ -1054,7 +1358,7 @@ void Robot::process_move(Gcode *gcode, enum MOTION_MODE_T motion_mode)
         case NONE: break;
 
         case SEEK:
-            moved= this->append_line(gcode, target, this->seek_rate / seconds_per_minute, delta_e );
+            moved= this->append_line(gcode, target, this->seek_rate * rapid_override / 100.0F / seconds_per_minute, delta_e );
             break;
 
         case LINEAR:
@@ -1063,11 +1367,19 @@ void Robot::process_move(Gcode *gcode, enum MOTION_MODE_T motion_mode)
 
         case CW_ARC:
         case CCW_ARC:
-            // Note arcs are not currently supported by extruder based machines, as 3D slicers do not use arcs (G2/G3)
-            moved= this->compute_arc(gcode, offset, target, motion_mode);
+            // E and ABC move along the arc in proportion, for arc fitted slicer output
+            moved= this->compute_arc(gcode, offset, target, motion_mode, delta_e);
+            break;
+
+        case CUBIC_SPLINE:
+        case QUADRATIC_SPLINE:
+            moved= this->compute_spline(gcode, offset, target, motion_mode, delta_e);
             break;
     }
 
+    // only a G5 straight after this one can leave out I J
+    spline_continues= moved && motion_mode == CUBIC_SPLINE;
+
     // needed to act as start of next arc command
     memcpy(arc_milestone, target, sizeof(arc_milestone));
 
@@ -1098,8 +1410,10 @@ void Robot::reset_axis_position(float x, float y, float z)
     // now set the actuator positions based on the supplied compensated position
     ActuatorCoordinates actuator_pos;
     arm_solution->cartesian_to_actuator(this->compensated_machine_position, actuator_pos);
-    for (size_t i = X_AXIS; i <= Z_AXIS; i++)
+    for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
         actuators[i]->change_last_milestone(actuator_pos[i]);
+        clear_backlash(i);
+    }
 }
 
 // Reset the position for an axis (used in homing, and to reset extruder after suspend)
@@ -1107,7 +1421,18 @@ void Robot::reset_axis_position(float position, int axis)
 {
     compensated_machine_position[axis] = position;
     if(axis <= Z_AXIS) {
+        // the other axis keep any backlash they have taken up
+        backlash_t kept[3];
+        float stepped[3];
+        memcpy(kept, backlash_state, sizeof kept);
+        for (int i = X_AXIS; i <= Z_AXIS; ++i) stepped[i]= actuators[i]->get_backlash();
         reset_axis_position(compensated_machine_position[X_AXIS], compensated_machine_position[Y_AXIS], compensated_machine_position[Z_AXIS]);
+        for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+            if(i == axis) continue;
+            backlash_state[i]= kept[i];
+            actuators[i]->set_backlash(stepped[i]);
+            actuators[i]->change_last_milestone(actuators[i]->get_last_milestone() + kept[i].offset);
+        }
 
 #if MAX_ROBOT_ACTUATORS > 3
     }else if(axis < n_motors) {
@@ -1123,7 +1448,10 @@ void Robot::reset_axis_position(float position, int axis)
 void Robot::reset_actuator_position(const ActuatorCoordinates &ac)
 {
     for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
-        if(!isnan(ac[i])) actuators[i]->change_last_milestone(ac[i]);
+        if(!isnan(ac[i])) {
+            actuators[i]->change_last_milestone(ac[i]);
+            clear_backlash(i);
+        }
     }
 
     // now correct axis positions then recorrect actuator to account for rounding
@@ -1139,6 +1467,12 @@ void Robot::reset_position_from_current_actuator_position()
         // NOTE actuator::current_position is curently NOT the same as actuator::machine_position after an abrupt abort
         actuator_pos[i] = actuators[i]->get_current_position();
     }
+    // the backlash taken up is kept and is not part of the machine position. Any queued take up may have been flushed
+    // so it is what the moves stepped so far have taken up, the next reversal then takes up the rest
+    for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
+        backlash_state[i].offset= actuators[i]->get_backlash();
+        actuator_pos[i] -= backlash_state[i].offset;
+    }
 
     // discover machine position from where actuators actually are
     arm_solution->actuator_to_cartesian(actuator_pos, compensated_machine_position);
@@ -1152,7 +1486,7 @@ void Robot::reset_position_from_current_actuator_position()
     // to get everything in perfect sync.
     arm_solution->cartesian_to_actuator(compensated_machine_position, actuator_pos);
     for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
-        actuators[i]->change_last_milestone(actuator_pos[i]);
+        actuators[i]->change_last_milestone(actuator_pos[i] + backlash_state[i].offset);
     }
 
     // Handle extruders and/or ABC axis
@@ -1167,11 +1501,62 @@ void Robot::reset_position_from_current_actuator_position()
     #endif
 }
 
+// forget any backlash taken up, the actuator position has been set to where it really is
+void Robot::clear_backlash(int i)
+{
+    backlash_state[i].offset= 0;
+    backlash_state[i].target= 0;
+    backlash_state[i].dir= 0;
+    actuators[i]->set_backlash(0);
+}
+
+// Leadscrews have to turn by the backlash after reversing before the axis moves. On a reversal the actuator is moved
+// by the backlash further than machine_position says, and stays that far out until it reverses again. With no
+// smoothing the take up is returned in correction to be moved as a block of its own before the move, otherwise it is
+// added in to the moves after the reversal, backlash_smoothing mm of travel taking up all of it. actuator_pos is
+// changed to include the take up, next gets what backlash_state will be once the move is queued.
+// returns true if there is a correction block to move first
+bool Robot::plan_backlash(ActuatorCoordinates &actuator_pos, backlash_t next[], float correction[]) const
+{
+    bool correct= false;
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        next[i]= backlash_state[i];
+        if(backlash[i] <= 0) continue;
+
+        // where the actuator is without the take up
+        float d= actuator_pos[i] - (actuators[i]->get_last_milestone() - next[i].offset);
+        if(d != 0) {
+            int8_t dir= d > 0 ? 1 : -1;
+            // the first move only finds out which way the slack is
+            if(next[i].dir != 0 && dir != next[i].dir) next[i].target += dir * backlash[i];
+            next[i].dir= dir;
+
+            float c= next[i].target - next[i].offset;
+            if(c != 0) {
+                if(backlash_smoothing > 0) {
+                    float most= backlash[i] * fabsf(d) / backlash_smoothing;
+                    c= confine(c, -most, most);
+                } else {
+                    correction[i]= c;
+                    correct= true;
+                }
+                next[i].offset += c;
+            }
+        }
+        actuator_pos[i] += next[i].offset;
+    }
+    return correct;
+}
+
 // Convert target (in machine coordinates) to machine_position, then convert to actuator position and append this to the planner
 // target is in machine coordinates without the compensation transform, however we save a compensated_machine_position that includes
 // all transforms and is what we actually convert to actuator positions
-bool Robot::append_milestone(const float target[], float rate_mm_s)
+// actuator_xyz if given is the arm solution of target already worked out by the caller, only when there is no compensation transform
+bool Robot::append_milestone(const float target[], float rate_mm_s, const ActuatorCoordinates *actuator_xyz)
 {
+    // a held line goes first
+    flush_coalesced();
+
     float deltas[n_motors];
     float transformed_target[n_motors]; // adjust target for bed compensation
     float unit_vec[N_PRIMARY_AXIS];
@@ -1274,7 +1659,12 @@ bool Robot::append_milestone(const float target[], float rate_mm_s)
 
     // find actuator position given the machine position, use actual adjusted target
     ActuatorCoordinates actuator_pos;
-    if(!disable_arm_solution) {
+    if(actuator_xyz != nullptr) {
+        for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
+            actuator_pos[i] = (*actuator_xyz)[i];
+        }
+
+    }else if(!disable_arm_solution) {
         arm_solution->cartesian_to_actuator( transformed_target, actuator_pos );
 
     }else{
@@ -1307,6 +1697,12 @@ bool Robot::append_milestone(const float target[], float rate_mm_s)
     }
 #endif
 
+    // move the actuators past the target by any backlash taken up
+    backlash_t next_backlash[3];
+    float backlash_correction[k_max_actuators]= {0};
+    bool backlash_block= plan_backlash(actuator_pos, next_backlash, backlash_correction);
+    float backlash_offset[3]= { next_backlash[X_AXIS].offset, next_backlash[Y_AXIS].offset, next_backlash[Z_AXIS].offset };
+
     // use default acceleration to start with
     float acceleration = default_acceleration;
 
@@ -1314,7 +1710,7 @@ bool Robot::append_milestone(const float target[], float rate_mm_s)
 
     // check per-actuator speed limits
     for (size_t actuator = 0; actuator < n_motors; actuator++) {
-        float d = fabsf(actuator_pos[actuator] - actuators[actuator]->get_last_milestone());
+        float d = fabsf(actuator_pos[actuator] - actuators[actuator]->get_last_milestone() - backlash_correction[actuator]);
         if(d == 0 || !actuators[actuator]->is_selected()) continue; // no movement for this actuator
 
         float actuator_rate= d * isecs;
@@ -1336,26 +1732,65 @@ bool Robot::append_milestone(const float target[], float rate_mm_s)
         }
     }
 
-    // if we are in feed hold wait here until it is released, this means that even segemnted lines will pause
+    // if we are in feed hold wait here until it is released, the step ticker has stopped the move being stepped and this stops
+    // any more being queued, so even segmented lines will pause
     while(THEKERNEL->get_feed_hold()) {
         THEKERNEL->call_event(ON_IDLE, this);
         // if we also got a HALT then break out of this
         if(THEKERNEL->is_halted()) return false;
     }
 
+    // the rest of a cancelled jog is not queued
+    if(jog_cancelled) return false;
+
+    // an unsmoothed backlash take up goes first
+    bool took_up= backlash_block && append_backlash(backlash_correction, backlash_offset, rate_mm_s);
+
     // Append the block to the planner
     // NOTE that distance here should be either the distance travelled by the XYZ axis, or the E mm travel if a solo E move
     // NOTE this call will bock until there is room in the block queue, on_idle will continue to be called
-    if(THEKERNEL->planner->append_block( actuator_pos, n_motors, rate_mm_s, distance, auxilliary_move ? nullptr : unit_vec, acceleration, s_value, is_g123)) {
+    if(THEKERNEL->planner->append_block( actuator_pos, n_motors, rate_mm_s, distance, auxilliary_move ? nullptr : unit_vec, acceleration, s_value, is_g123, backlash_offset)) {
         // this is the new compensated machine position
         memcpy(this->compensated_machine_position, transformed_target, n_motors*sizeof(float));
+        memcpy(this->backlash_state, next_backlash, sizeof backlash_state);
         return true;
     }
 
-    // no actual move
+    // no actual move, but the actuators may have taken up the backlash
+    if(took_up) memcpy(this->backlash_state, next_backlash, sizeof backlash_state);
     return false;
 }
 
+// queues a block that moves just the backlash correction of each actuator, no faster than rate_mm_s and the actuator limits,
+// offset is the backlash taken up once it is done
+bool Robot::append_backlash(const float correction[], const float offset[], float rate_mm_s)
+{
+    ActuatorCoordinates take_up;
+    float unit_vec[N_PRIMARY_AXIS];
+    float sos= 0;
+    for (size_t i = 0; i < n_motors; i++) {
+        take_up[i]= actuators[i]->get_last_milestone() + correction[i];
+        if(i < N_PRIMARY_AXIS) sos += powf(correction[i], 2);
+    }
+    float distance= sqrtf(sos);
+
+    float acceleration= default_acceleration;
+    for (size_t i = X_AXIS; i <= Z_AXIS; i++) {
+        unit_vec[i]= correction[i] / distance;
+        float f= fabsf(unit_vec[i]);
+        if(f == 0) continue;
+        if(rate_mm_s * f > actuators[i]->get_max_rate()) rate_mm_s= actuators[i]->get_max_rate() / f;
+        float ma= actuators[i]->get_acceleration();
+        if(!isnan(ma) && acceleration * f > ma) acceleration= ma / f;
+    }
+    for (size_t i = Z_AXIS + 1; i < N_PRIMARY_AXIS; i++) {
+        unit_vec[i]= 0;
+    }
+
+    // nothing is being made so the laser is off
+    return THEKERNEL->planner->append_block(take_up, n_motors, rate_mm_s, distance, unit_vec, acceleration, 0, false, offset);
+}
+
 // Used to plan a single move used by things like endstops when homing, zprobe, extruder firmware retracts etc.
 bool Robot::delta_move(const float *delta, float rate_mm_s, uint8_t naxis)
 {
@@ -1416,13 +1851,17 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
     }
 
     // We cut the line into smaller segments. This is only needed on a cartesian robot for zgrid, but always necessary for robots with rotational axes like Deltas.
-    // In delta robots either mm_per_line_segment can be used OR delta_segments_per_second
+    // In delta robots either mm_per_line_segment can be used OR delta_segments_per_second OR mm_max_line_error
     // The latter is more efficient and avoids splitting fast long lines into very small segments, like initial z move to 0, it is what Johanns Marlin delta port does
+    // mm_max_line_error cuts the line only where the arm solution needs it, see append_kinematic_segments()
     uint16_t segments;
 
     if(this->disable_segmentation || (!segment_z_moves && !gcode->has_letter('X') && !gcode->has_letter('Y'))) {
         segments= 1;
 
+    } else if(this->mm_max_line_error > 0.0F && !this->disable_arm_solution) {
+        segments= 0; // as many as needed
+
     } else if(this->delta_segments_per_second > 1.0F) {
         // enabled if set to something > 1, it is set to 0.0 by default
         // segment based on current speed and requested segments per second
@@ -1441,7 +1880,10 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
     }
 
     bool moved= false;
-    if (segments > 1) {
+    if(segments == 0) {
+        moved= this->append_kinematic_segments(target, rate_mm_s, millimeters_of_travel);
+
+    } else if (segments > 1) {
         // A vector to keep track of the endpoint of each segment
         float segment_delta[n_motors];
         float segment_end[n_motors];
@@ -1451,32 +1893,320 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s, flo
         for (int i = 0; i < n_motors; i++)
             segment_delta[i] = (target[i] - machine_position[i]) / segments;
 
+        // without a compensation transform the arm solution converts the segment ends a batch at a time
+        const size_t batch_size= 8;
+        bool batch= !compensationTransform && !disable_arm_solution;
+        ActuatorCoordinates batch_pos[batch_size];
+
         // segment 0 is already done - it's the end point of the previous move so we start at segment 1
         // We always add another point after this loop so we stop at segments-1, ie i < segments
         for (int i = 1; i < segments; i++) {
             if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+            size_t bi= (i - 1) % batch_size;
+            if(batch && bi == 0) {
+                size_t n= std::min(batch_size, (size_t)(segments - i));
+                float from[3], to[3];
+                for (int j = X_AXIS; j <= Z_AXIS; j++) {
+                    from[j]= segment_end[j];
+                    to[j]= segment_end[j] + segment_delta[j] * n;
+                }
+                arm_solution->line_to_actuators(from, to, batch_pos, n);
+            }
+
             for (int j = 0; j < n_motors; j++)
                 segment_end[j] += segment_delta[j];
 
             // Append the end of this segment to the queue
             // this can block waiting for free block queue or if in feed hold
-            bool b= this->append_milestone(segment_end, rate_mm_s);
+            bool b= this->append_milestone(segment_end, rate_mm_s, batch ? &batch_pos[bi] : nullptr);
             moved= moved || b;
         }
     }
 
-    // Append the end of this full move to the queue
-    if(this->append_milestone(target, rate_mm_s)) moved= true;
+    // Append the end of this full move to the queue, a line that was not cut up may be merged with the next ones
+    if(segments == 1 ? this->coalesce_milestone(target, rate_mm_s) : this->append_milestone(target, rate_mm_s)) moved= true;
 
     this->next_command_is_MCS = false; // always reset this
 
     return moved;
 }
 
+// Cut a line for an arm solution that does not keep it straight, like a delta or scara. Between the ends of a segment the
+// actuators move linearly, so the head is only on the line at the ends. Each segment is made as long as it can be with the
+// actuator positions halfway through it within mm_max_line_error of the middle of the line, so where the arm solution is
+// close to linear (a vertical move on a delta) the line is cut into few segments or not at all.
+// mm_per_line_segment if set is the longest segment, for the compensation transform.
+// Appends all but the last segment, returns true if any of them moved
+bool Robot::append_kinematic_segments(const float target[], float rate_mm_s, float millimeters_of_travel)
+{
+    const float min_step= 1.0F / 4096; // of the line
+    float max_step= 1.0F;
+    if(this->mm_per_line_segment > 0.0F && millimeters_of_travel > this->mm_per_line_segment) {
+        max_step= this->mm_per_line_segment / millimeters_of_travel;
+    }
+
+    float start[n_motors];
+    memcpy(start, machine_position, n_motors*sizeof(float));
+    auto point= [&](float t, float *p) {
+        for (int i = X_AXIS; i <= Z_AXIS; ++i) p[i]= start[i] + (target[i] - start[i]) * t;
+    };
+
+    ActuatorCoordinates a0, a1, am;
+    arm_solution->cartesian_to_actuator(start, a0);
+
+    bool moved= false;
+    float t= 0, step= max_step;
+    while(true) {
+        if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+
+        // halve the step until the middle of it is close enough
+        if(step > 1 - t) step= 1 - t;
+        while(true) {
+            float p1[3], pm[3], cm[3];
+            point(t + step, p1);
+            arm_solution->cartesian_to_actuator(p1, a1);
+            if(step <= min_step) break;
+
+            point(t + step / 2, pm);
+            for (int i = X_AXIS; i <= Z_AXIS; ++i) am[i]= (a0[i] + a1[i]) / 2;
+            arm_solution->actuator_to_cartesian(am, cm);
+            if(powf(cm[X_AXIS] - pm[X_AXIS], 2) + powf(cm[Y_AXIS] - pm[Y_AXIS], 2) + powf(cm[Z_AXIS] - pm[Z_AXIS], 2) <= powf(this->mm_max_line_error, 2)) break;
+            step /= 2;
+        }
+
+        // the caller appends the last one
+        if(t + step >= 1 - min_step / 2) break;
+        t += step;
+
+        float segment_end[n_motors];
+        for (int i = 0; i < n_motors; i++) {
+            segment_end[i]= start[i] + (target[i] - start[i]) * t;
+        }
+        // the arm solution of the end was worked out above
+        if(this->append_milestone(segment_end, rate_mm_s, compensationTransform ? nullptr : &a1)) moved= true;
+
+        // try a longer one next
+        a0= a1;
+        step= std::min(step * 2, max_step);
+    }
+
+    return moved;
+}
+
+
+// Short lines, like the runs of tiny segments CAM programs output, are held back and merged with the following lines
+// while the merged line stays within coalesce_deviation of every point it replaces and the direction does not change by
+// more than coalesce_max_angle. The queue then holds many times the distance. With G64 every line is held so its corner
+// with the next one can be blended. Not done when lines are segmented (deltas, leveling) as those need the short lines.
+// returns true if the line was taken
+bool Robot::coalesce_milestone(const float target[], float rate_mm_s)
+{
+    if(coalesced.pending) {
+        if(coalesce_deviation > 0 && can_coalesce(target, rate_mm_s)) {
+            // the end of the held line becomes one of the points the merged line has to pass near
+            memcpy(coalesced.points[coalesced.n_points++], coalesced.target, sizeof(coalesced.points[0]));
+            memcpy(coalesced.target, target, n_motors*sizeof(float));
+            return true;
+        }
+
+        if(blend_tolerance > 0) {
+            blend_corner(target, rate_mm_s);
+        } else {
+            flush_coalesced();
+        }
+    }
+
+    bool segmented= !disable_segmentation && (delta_segments_per_second > 1.0F || mm_per_line_segment > 0.0F || mm_max_line_error > 0.0F);
+    if((coalesce_deviation <= 0 && blend_tolerance <= 0) || segmented || compensationTransform || THEKERNEL->is_halted()) {
+        return append_milestone(target, rate_mm_s);
+    }
+
+    // only short lines are held, and only if append_milestone() will not reject them for the soft endstops
+    float sos= 0;
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        sos += powf(target[i] - compensated_machine_position[i], 2);
+        if(soft_endstop_enabled && is_homed(i) &&
+           ((!isnan(soft_endstop_min[i]) && target[i] < soft_endstop_min[i]) || (!isnan(soft_endstop_max[i]) && target[i] > soft_endstop_max[i]))) {
+            return append_milestone(target, rate_mm_s);
+        }
+    }
+    // when blending every line is held as its end may be rounded off
+    float length= sqrtf(sos);
+    if(length < 0.00001F || (blend_tolerance <= 0 && length >= coalesce_max_length)) {
+        return append_milestone(target, rate_mm_s);
+    }
+
+    memcpy(coalesced.target, target, n_motors*sizeof(float));
+    coalesced.rate= rate_mm_s;
+    coalesced.s_value= s_value;
+    coalesced.is_g123= is_g123;
+    coalesced.n_points= 0;
+    coalesced.pending= true;
+    return true;
+}
+
+// true if the held line and the next one can be merged into one line from the last planned position to target
+bool Robot::can_coalesce(const float target[], float rate_mm_s) const
+{
+    if(coalesced.n_points >= coalesce_max_points || rate_mm_s != coalesced.rate || s_value != coalesced.s_value || is_g123 != coalesced.is_g123) return false;
+
+    const float *start= compensated_machine_position;
+    const float *prev= coalesced.n_points > 0 ? coalesced.points[coalesced.n_points - 1] : start;
+    float line[3], last[3], next[3];
+    float length= 0, last_length= 0, next_length= 0;
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        line[i]= target[i] - start[i];
+        last[i]= coalesced.target[i] - prev[i];
+        next[i]= target[i] - coalesced.target[i];
+        length += line[i] * line[i];
+        last_length += last[i] * last[i];
+        next_length += next[i] * next[i];
+    }
+    length= sqrtf(length);
+    last_length= sqrtf(last_length);
+    next_length= sqrtf(next_length);
+    if(next_length < 0.00001F || length >= coalesce_max_length) return false;
+
+    // the direction change from the held line
+    float dot= last[X_AXIS] * next[X_AXIS] + last[Y_AXIS] * next[Y_AXIS] + last[Z_AXIS] * next[Z_AXIS];
+    if(dot < coalesce_cos_angle * last_length * next_length) return false;
+
+    // every point passed has to be within the deviation of the merged line, and in order along it
+    for (int n = 0; n <= coalesced.n_points; ++n) {
+        const float *p= n < coalesced.n_points ? coalesced.points[n] : coalesced.target;
+        float v[3]{p[X_AXIS] - start[X_AXIS], p[Y_AXIS] - start[Y_AXIS], p[Z_AXIS] - start[Z_AXIS]};
+        float along= (v[X_AXIS] * line[X_AXIS] + v[Y_AXIS] * line[Y_AXIS] + v[Z_AXIS] * line[Z_AXIS]) / length;
+        if(along < 0 || along > length) return false;
+        float cx= v[Y_AXIS] * line[Z_AXIS] - v[Z_AXIS] * line[Y_AXIS];
+        float cy= v[Z_AXIS] * line[X_AXIS] - v[X_AXIS] * line[Z_AXIS];
+        float cz= v[X_AXIS] * line[Y_AXIS] - v[Y_AXIS] * line[X_AXIS];
+        if(sqrtf(cx * cx + cy * cy + cz * cz) / length > coalesce_deviation) return false;
+    }
+
+    // extruders and ABC have to keep moving in proportion to XYZ
+    for (int i = Z_AXIS + 1; i < n_motors; ++i) {
+        float ratio= (target[i] - start[i]) / length;
+        float next_ratio= (target[i] - coalesced.target[i]) / next_length;
+        if(fabsf(next_ratio - ratio) > 0.01F * fabsf(ratio) + 0.000001F) return false;
+    }
+
+    return true;
+}
+
+// G64 path blending, the corner between the held line and the next one is rounded off with an arc tangent to both that
+// stays within blend_tolerance of the corner. The held line is planned up to where the arc starts, then the arc as short
+// lines, and the next line starts where the arc ends. The arc takes at most half of either line so the next corner has room
+void Robot::blend_corner(const float target[], float rate_mm_s)
+{
+    const float *start= compensated_machine_position;
+    const float *corner= coalesced.target;
+    float u1[3], u2[3], l1= 0, l2= 0;
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        u1[i]= corner[i] - start[i];
+        u2[i]= target[i] - corner[i];
+        l1 += u1[i] * u1[i];
+        l2 += u2[i] * u2[i];
+    }
+    l1= sqrtf(l1);
+    l2= sqrtf(l2);
+
+    // nothing to round off for nearly straight on or a reversal, and G0 and G1 are not blended together
+    float c= (u1[X_AXIS] * u2[X_AXIS] + u1[Y_AXIS] * u2[Y_AXIS] + u1[Z_AXIS] * u2[Z_AXIS]) / (l1 * l2);
+    if(l1 < 0.00001F || l2 < 0.00001F || c > 0.9998F || c < -0.9998F || is_g123 != coalesced.is_g123) {
+        flush_coalesced();
+        return;
+    }
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        u1[i] /= l1;
+        u2[i] /= l2;
+    }
+
+    // the arc through a corner turning by theta with radius r is r*(1/cos(theta/2) - 1) from the corner at its middle,
+    // and starts and ends r*tan(theta/2) from the corner
+    float theta= acosf(c);
+    float h= cosf(theta / 2);
+    float r= blend_tolerance * h / (1.0F - h);
+    float d= r * tanf(theta / 2);
+    if(d > std::min(l1, l2) / 2) {
+        d= std::min(l1, l2) / 2;
+        r= d / tanf(theta / 2);
+    }
+
+    // where the arc starts and ends, other axes follow their lines
+    float arc_start[n_motors], arc_end[n_motors];
+    for (int i = 0; i < n_motors; ++i) {
+        if(i <= Z_AXIS) {
+            arc_start[i]= corner[i] - d * u1[i];
+            arc_end[i]= corner[i] + d * u2[i];
+        } else {
+            arc_start[i]= corner[i] - (corner[i] - start[i]) * d / l1;
+            arc_end[i]= corner[i] + (target[i] - corner[i]) * d / l2;
+        }
+    }
+
+    // the centre is on the bisector, va and vb are the arc start and the point a quarter turn on from it relative to the centre
+    float bisector[3], bl= 0;
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        bisector[i]= u2[i] - u1[i];
+        bl += bisector[i] * bisector[i];
+    }
+    bl= sqrtf(bl);
+    float cd= sqrtf(r * r + d * d);
+    float va[3], vb[3];
+    for (int i = X_AXIS; i <= Z_AXIS; ++i) {
+        float centre= corner[i] + bisector[i] / bl * cd;
+        va[i]= arc_start[i] - centre;
+        vb[i]= ((arc_end[i] - centre) - va[i] * c) / sinf(theta);
+    }
+
+    // enough lines that each is within a quarter of the tolerance of the arc
+    float sag= std::min(blend_tolerance / 4, r);
+    uint16_t segments= std::max(1.0F, std::min(16.0F, ceilf(theta / (2 * acosf(1.0F - sag / r)))));
+
+    float rate= std::min(rate_mm_s, coalesced.rate);
+    memcpy(coalesced.target, arc_start, n_motors*sizeof(float));
+    flush_coalesced();
+
+    float p[n_motors];
+    for (uint16_t n = 1; n <= segments; ++n) {
+        if(THEKERNEL->is_halted()) return;
+        float t= (float)n / segments;
+        if(n == segments) {
+            memcpy(p, arc_end, n_motors*sizeof(float));
+        } else {
+            float a= theta * t;
+            for (int i = 0; i < n_motors; ++i) {
+                if(i <= Z_AXIS) p[i]= (arc_start[i] - va[i]) + va[i] * cosf(a) + vb[i] * sinf(a);
+                else p[i]= arc_start[i] + (arc_end[i] - arc_start[i]) * t;
+            }
+        }
+        append_held(p, rate);
+    }
+}
+
+// plan a line with the S value and G0/G1 of the held line
+void Robot::append_held(const float target[], float rate_mm_s)
+{
+    float s= s_value;
+    bool g123= is_g123;
+    s_value= coalesced.s_value;
+    is_g123= coalesced.is_g123;
+    append_milestone(target, rate_mm_s);
+    s_value= s;
+    is_g123= g123;
+}
+
+// plan the held line if there is one
+void Robot::flush_coalesced()
+{
+    if(!coalesced.pending) return;
+    coalesced.pending= false;
+    append_held(coalesced.target, coalesced.rate);
+}
 
 // Append an arc to the queue ( cutting it into segments as needed )
-// TODO does not support any E parameters so cannot be used for 3D printing.
-bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[], float radius, bool is_clockwise )
+// the axes not in the plane of the arc, including E, move in proportion to the angle
+bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[], float radius, bool is_clockwise, float delta_e)
 {
     float rate_mm_s= this->feed_rate / seconds_per_minute;
     // catch negative or zero feed rates and return the same error as GRBL does
@@ -1524,23 +2254,34 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
         return false;
     }
 
-    // limit segments by maximum arc error
-    float arc_segment = this->mm_per_arc_segment;
-    if ((this->mm_max_arc_error > 0) && (2 * radius > this->mm_max_arc_error)) {
-        float min_err_segment = 2 * sqrtf((this->mm_max_arc_error * (2 * radius - this->mm_max_arc_error)));
-        if (this->mm_per_arc_segment < min_err_segment) {
-            arc_segment = min_err_segment;
+    // limit the extrusion rate the same as for lines
+    if(!isnan(delta_e)) {
+        float data[2]= {delta_e, rate_mm_s / millimeters_of_travel};
+        if(PublicData::set_value(extruder_checksum, target_checksum, data)) {
+            rate_mm_s *= data[1]; // adjust the feedrate
         }
     }
 
-    // catch fall through on above
-    if(arc_segment < 0.0001F) {
-        arc_segment= 0.5F; /// the old default, so we avoid the divide by zero
-    }
-
     // Figure out how many segments for this gcode
+    // A chord of a circle of radius r turning by phi is r*(1 - cos(phi/2)) from the arc at its middle, so the angle per segment
+    // for the maximum arc error depends only on the radius, large arcs get longer segments and small ones few of them.
+    // Segments are never shorter than mm_per_arc_segment, and turn by no more than 90 degrees
     // TODO for deltas we need to make sure we are at least as many segments as requested, also if mm_per_line_segment is set we need to use the
-    uint16_t segments = floorf(millimeters_of_travel / arc_segment);
+    uint32_t segments;
+    if(this->mm_max_arc_error > 0) {
+        float phi = (this->mm_max_arc_error < radius) ? 2 * acosf(1 - this->mm_max_arc_error / radius) : PI / 2;
+        if(phi > PI / 2) phi = PI / 2;
+        segments = ceilf(fabsf(angular_travel) / phi);
+        if(this->mm_per_arc_segment > 0) {
+            segments = std::min(segments, (uint32_t)floorf(millimeters_of_travel / this->mm_per_arc_segment));
+        }
+
+    } else {
+        float arc_segment = (this->mm_per_arc_segment < 0.0001F) ? 0.5F : this->mm_per_arc_segment; // the old default, so we avoid the divide by zero
+        segments = floorf(millimeters_of_travel / arc_segment);
+    }
+    if(segments > 65535) segments = 65535;
+
     bool moved= false;
 
     if(segments > 1) {
@@ -1570,11 +2311,16 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
         a correction, the planner should have caught up to the lag caused by the initial mc_arc overhead.
         This is important when there are successive arc motions.
         */
-        // Vector rotation matrix values
-        float cos_T = 1 - 0.5F * theta_per_segment * theta_per_segment; // Small angle approximation
-        float sin_T = theta_per_segment;
+        // Vector rotation matrix values, the small angle approximation is only good for short segments on large arcs
+        float cos_T, sin_T;
+        if(fabsf(theta_per_segment) < 0.1F) {
+            cos_T = 1 - 0.5F * theta_per_segment * theta_per_segment; // Small angle approximation
+            sin_T = theta_per_segment;
+        } else {
+            cos_T = cosf(theta_per_segment);
+            sin_T = sinf(theta_per_segment);
+        }
 
-        // TODO we need to handle the ABC axis here by segmenting them
         float arc_target[n_motors];
         float sin_Ti;
         float cos_Ti;
@@ -1612,6 +2358,11 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
             arc_target[this->plane_axis_1] = center_axis1 + r_axis1;
             arc_target[this->plane_axis_2] += linear_per_segment;
 
+            // E and ABC
+            for (int a = A_AXIS; a < n_motors; ++a) {
+                arc_target[a] = machine_position[a] + (target[a] - machine_position[a]) * i / segments;
+            }
+
             // Append this segment to the queue
             bool b= this->append_milestone(arc_target, rate_mm_s);
             moved= moved || b;
@@ -1625,7 +2376,7 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
 }
 
 // Do the math for an arc and add it to the queue
-bool Robot::compute_arc(Gcode * gcode, const float offset[], const float target[], enum MOTION_MODE_T motion_mode)
+bool Robot::compute_arc(Gcode * gcode, const float offset[], const float target[], enum MOTION_MODE_T motion_mode, float delta_e)
 {
 
     // Find the radius
@@ -1638,9 +2389,172 @@ bool Robot::compute_arc(Gcode * gcode, const float offset[], const float target[
     }
 
     // Append arc
-    return this->append_arc(gcode, target, offset,  radius, is_clockwise );
+    return this->append_arc(gcode, target, offset,  radius, is_clockwise, delta_e );
 }
 
+// Append a cubic Bézier from the arc_milestone to the target in the XY plane, c1 and c2 are its control points.
+// The curve is cut into lines on board, the chord of a parameter step h is no further than h²/8 times the largest second
+// derivative over the step from the curve, and the second derivative changes linearly along it so is largest at one end
+// of the step. So the steps get shorter where the curve is tight and longer where it is straight.
+// Z, E and ABC move in proportion to the distance along the curve.
+bool Robot::append_spline(Gcode * gcode, const float target[], const float c1[2], const float c2[2], float delta_e)
+{
+    float rate_mm_s= this->feed_rate / seconds_per_minute;
+    // catch negative or zero feed rates and return the same error as GRBL does
+    if(rate_mm_s <= 0.0F) {
+        gcode->is_error= true;
+        gcode->txt_after_ok= (rate_mm_s == 0 ? "Undefined feed rate" : "feed rate < 0");
+        return false;
+    }
+
+    const float p0[2]{arc_milestone[X_AXIS], arc_milestone[Y_AXIS]};
+    const float p3[2]{target[X_AXIS], target[Y_AXIS]};
+
+    // second derivative at each end
+    float dd0[2], dd1[2];
+    for (int i = 0; i < 2; ++i) {
+        dd0[i]= 6 * (p0[i] - 2 * c1[i] + c2[i]);
+        dd1[i]= 6 * (c1[i] - 2 * c2[i] + p3[i]);
+    }
+
+    auto point= [&](float t, float *xy) {
+        float u= 1 - t;
+        for (int i = 0; i < 2; ++i) {
+            xy[i]= u * u * u * p0[i] + 3 * u * u * t * c1[i] + 3 * u * t * t * c2[i] + t * t * t * p3[i];
+        }
+    };
+    auto curvature= [&](float t) {
+        return hypotf((1 - t) * dd0[0] + t * dd1[0], (1 - t) * dd0[1] + t * dd1[1]);
+    };
+    auto speed= [&](float t) {
+        float u= 1 - t;
+        float d[2];
+        for (int i = 0; i < 2; ++i) {
+            d[i]= 3 * (u * u * (c1[i] - p0[i]) + 2 * u * t * (c2[i] - c1[i]) + t * t * (p3[i] - c2[i]));
+        }
+        return hypotf(d[0], d[1]);
+    };
+
+    // the next point along the curve, segments are never shorter than mm_per_arc_segment, the same as arcs
+    float min_segment= (this->mm_max_arc_error <= 0 && this->mm_per_arc_segment < 0.0001F) ? 0.5F : this->mm_per_arc_segment;
+    auto next_t= [&](float t) {
+        float h= (this->mm_max_arc_error > 0) ? 1 : 0;
+        if(this->mm_max_arc_error > 0) {
+            float a= curvature(t);
+            if(a > 0) h= sqrtf(8 * this->mm_max_arc_error / a);
+            if(t + h < 1) {
+                float b= curvature(t + h);
+                if(b > a) h= sqrtf(8 * this->mm_max_arc_error / b);
+            }
+        }
+        float v= speed(t);
+        if(min_segment > 0 && v > 0 && min_segment / v > h) h= min_segment / v;
+        if(h < 0.0001F) h= 0.0001F; // no more than 10000 segments
+        return std::min(t + h, 1.0F);
+    };
+
+    // the length along the points we will use
+    float length= 0;
+    float prev[2]{p0[0], p0[1]};
+    for (float t = next_t(0); ; t = next_t(t)) {
+        float xy[2];
+        point(t, xy);
+        length += hypotf(xy[0] - prev[0], xy[1] - prev[1]);
+        prev[0]= xy[0]; prev[1]= xy[1];
+        if(t >= 1) break;
+    }
+
+    float millimeters_of_travel = hypotf(length, target[Z_AXIS] - arc_milestone[Z_AXIS]);
+    if( millimeters_of_travel < 0.000001F ) {
+        return false;
+    }
+
+    // limit the extrusion rate the same as for lines
+    if(!isnan(delta_e)) {
+        float data[2]= {delta_e, rate_mm_s / millimeters_of_travel};
+        if(PublicData::set_value(extruder_checksum, target_checksum, data)) {
+            rate_mm_s *= data[1]; // adjust the feedrate
+        }
+    }
+
+    float segment_target[n_motors];
+    memcpy(segment_target, machine_position, n_motors*sizeof(float));
+    float s= 0;
+    prev[0]= p0[0]; prev[1]= p0[1];
+    bool moved= false;
+    for (float t = next_t(0); t < 1; t = next_t(t)) {
+        if(THEKERNEL->is_halted()) return false; // don't queue any more segments
+
+        float xy[2];
+        point(t, xy);
+        s += hypotf(xy[0] - prev[0], xy[1] - prev[1]);
+        prev[0]= xy[0]; prev[1]= xy[1];
+
+        segment_target[X_AXIS]= xy[0];
+        segment_target[Y_AXIS]= xy[1];
+        float f= (length > 0) ? s / length : t;
+        for (int a = Z_AXIS; a < n_motors; ++a) {
+            segment_target[a]= machine_position[a] + (target[a] - machine_position[a]) * f;
+        }
+
+        if(this->append_milestone(segment_target, rate_mm_s)) moved= true;
+    }
+
+    // Ensure last segment arrives at target location.
+    if(this->append_milestone(target, rate_mm_s)) moved= true;
+
+    return moved;
+}
+
+// Work out the control points for a G5 or G5.1 and add the curve to the queue
+bool Robot::compute_spline(Gcode * gcode, const float offset[], const float target[], enum MOTION_MODE_T motion_mode, float delta_e)
+{
+    if(this->plane_axis_2 != Z_AXIS) {
+        gcode->is_error= true;
+        gcode->txt_after_ok= "G5 is only supported in the XY plane";
+        return false;
+    }
+
+    float c1[2], c2[2];
+    if(motion_mode == QUADRATIC_SPLINE) {
+        // G5.1 I J is the control point relative to the start, as a cubic the control points are 2/3 of the way from each end to it
+        if(!gcode->has_letter('I') || !gcode->has_letter('J')) {
+            gcode->is_error= true;
+            gcode->txt_after_ok= "G5.1 requires I and J";
+            return false;
+        }
+        for (int i = 0; i < 2; ++i) {
+            float q= arc_milestone[i] + offset[i];
+            c1[i]= arc_milestone[i] + (q - arc_milestone[i]) * 2 / 3;
+            c2[i]= target[i] + (q - target[i]) * 2 / 3;
+        }
+
+    } else {
+        // G5 I J is the first control point relative to the start, P Q the second one relative to the end,
+        // without I J the first one is the last G5's second one reflected so the curves join smoothly
+        if(!gcode->has_letter('P') || !gcode->has_letter('Q')) {
+            gcode->is_error= true;
+            gcode->txt_after_ok= "G5 requires P and Q";
+            return false;
+        }
+        bool has_ij= gcode->has_letter('I') || gcode->has_letter('J');
+        if(!has_ij && !spline_continues) {
+            gcode->is_error= true;
+            gcode->txt_after_ok= "G5 requires I and J";
+            return false;
+        }
+        for (int i = 0; i < 2; ++i) {
+            c1[i]= arc_milestone[i] + (has_ij ? offset[i] : -spline_control[i]);
+        }
+        spline_control[0]= this->to_millimeters(gcode->get_value('P'));
+        spline_control[1]= this->to_millimeters(gcode->get_value('Q'));
+        for (int i = 0; i < 2; ++i) {
+            c2[i]= target[i] + spline_control[i];
+        }
+    }
+
+    return this->append_spline(gcode, target, c1, c2, delta_e);
+}
 
 float Robot::theta(float x, float y)
 {
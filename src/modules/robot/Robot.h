@@ -22,6 +22,7 @@ using std::string;
 class Gcode;
 class BaseSolution;
 class StepperMotor;
+class StreamOutput;
 
 // 9 WCS offsets
 #define MAX_WCS 9UL
@@ -32,12 +33,16 @@ class Robot : public Module {
         Robot();
         void on_module_loaded();
         void on_gcode_received(void* argument);
+        void on_idle(void* argument);
+        void on_halt(void* argument);
 
         void reset_axis_position(float position, int axis);
         void reset_axis_position(float x, float y, float z);
         void reset_actuator_position(const ActuatorCoordinates &ac);
         void reset_position_from_current_actuator_position();
         float get_seconds_per_minute() const { return seconds_per_minute; }
+        float get_feed_override() const { return feed_override; }
+        void set_feed_override(float factor);
         float get_z_maxfeedrate() const { return this->max_speeds[Z_AXIS]; }
         float get_default_acceleration() const { return default_acceleration; }
         void setToolOffset(const float offset[N_PRIMARY_AXIS]);
@@ -59,6 +64,8 @@ class Robot : public Module {
         std::tuple<float, float, float, uint8_t> get_last_probe_position() const { return last_probe_position; }
         void set_last_probe_position(std::tuple<float, float, float, uint8_t> p) { last_probe_position = p; }
         bool delta_move(const float delta[], float rate_mm_s, uint8_t naxis);
+        bool jog(const std::string &line, StreamOutput *stream, std::string &error);
+        void flush_coalesced();
         uint8_t register_motor(StepperMotor*);
         uint8_t get_number_registered_motors() const {return n_motors; }
 
@@ -89,6 +96,10 @@ class Robot : public Module {
             bool is_g123:1;
             bool soft_endstop_enabled:1;
             bool soft_endstop_halt:1;
+            bool spline_continues:1;                          // the last move was a G5, a G5 without I J carries on smoothly from it
+            bool in_jog:1;                                    // jog() is queuing a jog
+            bool jog_cancelled:1;                             // the jog being queued was cancelled, no more of it is queued
+            bool cartesian_actuators:1;                       // the first two actuators move X and Y, input shaping needs it
             uint8_t plane_axis_0:2;                           // Current plane ( XY, XZ, YZ )
             uint8_t plane_axis_1:2;
             uint8_t plane_axis_2:2;
@@ -100,16 +111,36 @@ class Robot : public Module {
             SEEK, // G0
             LINEAR, // G1
             CW_ARC, // G2
-            CCW_ARC // G3
+            CCW_ARC, // G3
+            CUBIC_SPLINE, // G5
+            QUADRATIC_SPLINE // G5.1
+        };
+
+        // backlash take up for an XYZ actuator, see plan_backlash()
+        struct backlash_t {
+            float offset;                                    // how far the actuator is past where machine_position puts it
+            float target;                                    // where offset is heading, it moves by the backlash on each reversal
+            int8_t dir;                                      // last direction moved, 0 until the first move
         };
 
         void load_config();
-        bool append_milestone(const float target[], float rate_mm_s);
+        bool append_milestone(const float target[], float rate_mm_s, const ActuatorCoordinates *actuator_xyz= nullptr);
+        bool coalesce_milestone(const float target[], float rate_mm_s);
+        bool can_coalesce(const float target[], float rate_mm_s) const;
+        void blend_corner(const float target[], float rate_mm_s);
+        void append_held(const float target[], float rate_mm_s);
         bool append_line( Gcode* gcode, const float target[], float rate_mm_s, float delta_e);
-        bool append_arc( Gcode* gcode, const float target[], const float offset[], float radius, bool is_clockwise );
-        bool compute_arc(Gcode* gcode, const float offset[], const float target[], enum MOTION_MODE_T motion_mode);
+        bool append_kinematic_segments(const float target[], float rate_mm_s, float millimeters_of_travel);
+        bool append_arc( Gcode* gcode, const float target[], const float offset[], float radius, bool is_clockwise, float delta_e );
+        bool compute_arc(Gcode* gcode, const float offset[], const float target[], enum MOTION_MODE_T motion_mode, float delta_e);
+        bool append_spline(Gcode* gcode, const float target[], const float c1[2], const float c2[2], float delta_e);
+        bool compute_spline(Gcode* gcode, const float offset[], const float target[], enum MOTION_MODE_T motion_mode, float delta_e);
         void process_move(Gcode *gcode, enum MOTION_MODE_T);
+        void cancel_jog();
         bool is_homed(uint8_t i) const;
+        bool plan_backlash(ActuatorCoordinates &actuator_pos, backlash_t next[], float correction[]) const;
+        bool append_backlash(const float correction[], const float offset[], float rate_mm_s);
+        void clear_backlash(int i);
 
         float theta(float x, float y);
         void select_plane(uint8_t axis_0, uint8_t axis_1, uint8_t axis_2);
@@ -134,10 +165,17 @@ class Robot : public Module {
         float mm_per_arc_segment;                            // Setting : Used to split arcs into segments
         float mm_max_arc_error;                              // Setting : Used to limit total arc segments to max error
         float delta_segments_per_second;                     // Setting : Used to split lines into segments for delta based on speed
+        float mm_max_line_error;                             // Setting : Used to split lines into segments where the arm solution bends them
         float seconds_per_minute;                            // for realtime speed change
+        float feed_override;                                 // M220 percentage
+        float rapid_override;                                // realtime rapid override percentage for seeks
+        uint32_t jog_queue_us;                               // how far ahead jogs can be queued
+        uint32_t jog_queued_until;                           // us_ticker_read() time the queued jogs should be done by
         float default_acceleration;                          // the defualt accleration if not set for each axis
         float s_value;                                       // modal S value
+        uint8_t input_shaper_type;                           // Setting : InputShaper::TYPE used when M593 turns shaping on
         float arc_milestone[3];                              // used as start of an arc command
+        float spline_control[2];                             // second control point of the last G5 relative to its end
 
         // Number of arc generation iterations by small angle approximation before exact arc trajectory
         // correction. This parameter may be decreased if there are issues with the accuracy of the arc
@@ -150,6 +188,27 @@ class Robot : public Module {
 
         float soft_endstop_min[3], soft_endstop_max[3];
 
+        backlash_t backlash_state[3];
+        float backlash[3];                                   // Setting : backlash of each actuator in mm, 0 disables
+        float backlash_smoothing;                            // Setting : mm of travel a take up is spread over, 0 moves it as a block of its own
+
+        // short lines held back to be merged into one block, see coalesce_milestone()
+        static const uint8_t coalesce_max_points= 16;
+        float coalesce_deviation;                            // Setting : max distance of a merged point from the line, 0 disables
+        float coalesce_cos_angle;                            // Setting : cosine of the max direction change between merged lines
+        float coalesce_max_length;                           // Setting : max length of a merged line
+        float blend_tolerance;                               // G64 P, max distance of a blended corner from the path, 0 for G61
+        float default_blend_tolerance;                       // Setting : used by G64 without P
+        struct {
+            float target[k_max_actuators];
+            float points[coalesce_max_points][3];            // XYZ of the ends of the merged lines before the last one
+            float rate;
+            float s_value;
+            uint8_t n_points;
+            bool pending:1;
+            bool is_g123:1;
+        } coalesced;
+
         uint8_t n_motors;                                    //count of the motors/axis registered
 
         // Used by Planner
@@ -3,6 +3,7 @@
 #define BASESOLUTION_H
 
 #include <map>
+#include <stddef.h>
 #include "ActuatorCoordinates.h"
 
 class Config;
@@ -14,6 +15,22 @@ class BaseSolution {
         virtual ~BaseSolution() {};
         virtual void cartesian_to_actuator(const float[], ActuatorCoordinates &) const = 0;
         virtual void actuator_to_cartesian(const ActuatorCoordinates &, float[]) const = 0;
+
+        // convert n points in one call, solutions can override these to share the work between the points
+        virtual void cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) const
+        {
+            for (size_t i = 0; i < n; ++i) cartesian_to_actuator(cartesian_mm[i], actuator_mm[i]);
+        }
+        // n points evenly spaced along the line from start to end, not including start, the last one is end
+        virtual void line_to_actuators(const float start[], const float end[], ActuatorCoordinates actuator_mm[], size_t n) const
+        {
+            for (size_t i = 0; i < n; ++i) {
+                float t= (float)(i + 1) / n;
+                float p[3]{start[0] + (end[0] - start[0]) * t, start[1] + (end[1] - start[1]) * t, start[2] + (end[2] - start[2]) * t};
+                cartesian_to_actuator(p, actuator_mm[i]);
+            }
+        }
+
         typedef std::map<char, float> arm_options_t;
         virtual bool set_optional(const arm_options_t& options) { return false; };
         virtual bool get_optional(arm_options_t& options, bool force_all= false) const { return false; };
@@ -73,6 +73,33 @@ void LinearDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], Actu
                                       ) + cartesian_mm[Z_AXIS];
 }
 
+// Along a line p = start + t*(end - start) what is under the square root for each tower is a quadratic in t,
+// so it is worked out once per line and each point only costs the square root
+void LinearDeltaSolution::line_to_actuators(const float start[], const float end[], ActuatorCoordinates actuator_mm[], size_t n) const
+{
+    const float tower_x[3]{delta_tower1_x, delta_tower2_x, delta_tower3_x};
+    const float tower_y[3]{delta_tower1_y, delta_tower2_y, delta_tower3_y};
+    float dx= end[X_AXIS] - start[X_AXIS];
+    float dy= end[Y_AXIS] - start[Y_AXIS];
+    float dz= end[Z_AXIS] - start[Z_AXIS];
+    float c0[3], c1[3];
+    float c2= -(dx * dx + dy * dy);
+    for (int k = 0; k < 3; ++k) {
+        float ux= tower_x[k] - start[X_AXIS];
+        float uy= tower_y[k] - start[Y_AXIS];
+        c0[k]= this->arm_length_squared - ux * ux - uy * uy;
+        c1[k]= 2 * (ux * dx + uy * dy);
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        float t= (float)(i + 1) / n;
+        float z= start[Z_AXIS] + dz * t;
+        for (int k = 0; k < 3; ++k) {
+            actuator_mm[i][ALPHA_STEPPER + k]= sqrtf(c0[k] + t * (c1[k] + t * c2)) + z;
+        }
+    }
+}
+
 void LinearDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ) const
 {
     // from http://en.wikipedia.org/wiki/Circumscribed_circle#Barycentric_coordinates_from_cross-_and_dot-products
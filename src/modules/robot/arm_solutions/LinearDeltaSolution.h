@@ -10,6 +10,7 @@ class LinearDeltaSolution : public BaseSolution {
         LinearDeltaSolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) const override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) const override;
+        void line_to_actuators(const float start[], const float end[], ActuatorCoordinates actuator_mm[], size_t n) const override;
 
         bool set_optional(const arm_options_t& options) override;
         bool get_optional(arm_options_t& options, bool force_all) const override;
@@ -50,7 +50,9 @@ MorganSCARASolution::MorganSCARASolution(Config* config)
 
 void MorganSCARASolution::init()
 {
-
+    // the same as 2 * arm1² when the arms are the same length
+    c2_offset = SQ(this->arm1_length) + SQ(this->arm2_length);
+    c2_scale = 1.0F / (2.0f * SQ(this->arm1_length));
 }
 
 float MorganSCARASolution::to_degrees(float radians) const
@@ -73,10 +75,7 @@ void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], Actu
     SCARA_pos[Y_AXIS] = (cartesian_mm[Y_AXIS]  * this->morgan_scaling_y - this->morgan_offset_y);  // morgan_offset not to be confused with home offset. This makes the SCARA math work.
     // Y has to be scaled before subtracting offset to ensure position on bed.
 
-    if (this->arm1_length == this->arm2_length)
-        SCARA_C2 = (SQ(SCARA_pos[X_AXIS]) + SQ(SCARA_pos[Y_AXIS]) - 2.0f * SQ(this->arm1_length)) / (2.0f * SQ(this->arm1_length));
-    else
-        SCARA_C2 = (SQ(SCARA_pos[X_AXIS]) + SQ(SCARA_pos[Y_AXIS]) - SQ(this->arm1_length) - SQ(this->arm2_length)) / (2.0f * SQ(this->arm1_length));
+    SCARA_C2 = (SQ(SCARA_pos[X_AXIS]) + SQ(SCARA_pos[Y_AXIS]) - c2_offset) * c2_scale;
 
     // SCARA position is undefined if abs(SCARA_C2) >=1
     // In reality abs(SCARA_C2) >0.95 can be problematic.
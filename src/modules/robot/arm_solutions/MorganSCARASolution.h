@@ -27,6 +27,8 @@ class MorganSCARASolution : public BaseSolution {
         float morgan_undefined_min;
         float morgan_undefined_max;
         float slow_rate;
+        float c2_offset;        // worked out by init() for the inverse kinematics
+        float c2_scale;
         bool real_scara;
 };
 
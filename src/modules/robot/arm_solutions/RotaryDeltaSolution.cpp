@@ -64,19 +64,19 @@ RotaryDeltaSolution::RotaryDeltaSolution(Config *config)
 // helper functions, calculates angle theta1 (for YZ-pane)
 int RotaryDeltaSolution::delta_calcAngleYZ(float x0, float y0, float z0, float &theta) const
 {
-    float y1 = -0.5F * tan30 * delta_f; // f/2 * tan 30
-    y0      -=  0.5F * tan30 * delta_e; // shift center to edge
+    float y1 = base_y;                  // f/2 * tan 30
+    y0      -= effector_y;              // shift center to edge
     // z = a + b*y
-    float a = (x0 * x0 + y0 * y0 + z0 * z0 + delta_rf * delta_rf - delta_re * delta_re - y1 * y1) / (2.0F * z0);
+    float a = (x0 * x0 + y0 * y0 + z0 * z0 + rf_re_base) / (2.0F * z0);
     float b = (y1 - y0) / z0;
 
-    float d = -(a + b * y1) * (a + b * y1) + delta_rf * (b * b * delta_rf + delta_rf); // discriminant
+    float d = -(a + b * y1) * (a + b * y1) + rf_squared * (b * b + 1.0F); // discriminant
     if (d < 0.0F) return -1;                                            // non-existing point
 
     float yj = (y1 - a * b - sqrtf(d)) / (b * b + 1.0F);               // choosing outer point
     float zj = a + b * yj;
 
-    theta = 180.0F * atanf(-zj / (y1 - yj)) / pi + ((yj > y1) ? 180.0F : 0.0F);
+    theta = atanf(-zj / (y1 - yj)) * (180.0F / pi) + ((yj > y1) ? 180.0F : 0.0F);
     return 0;
 }
 
@@ -138,6 +138,12 @@ void RotaryDeltaSolution::init()
 {
     //these are calculated here and not in the config() as these variables can be fine tuned by the user.
     z_calc_offset  = -(delta_z_offset - tool_offset - delta_ee_offs);
+
+    // the parts of the inverse kinematics that only depend on the geometry
+    base_y = -0.5F * tan30 * delta_f;
+    effector_y = 0.5F * tan30 * delta_e;
+    rf_squared = delta_rf * delta_rf;
+    rf_re_base = rf_squared - delta_re * delta_re - base_y * base_y;
 }
 
 void RotaryDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoordinates &actuator_mm ) const
@@ -30,6 +30,12 @@ class RotaryDeltaSolution : public BaseSolution {
         float tool_offset;		// Distance between end effector ball joint plane and tip of tool
         float z_calc_offset;
 
+        // worked out by init() from the above for the inverse kinematics
+        float base_y;           // y of the servo axes
+        float effector_y;       // y of the ball joints from the effector center
+        float rf_re_base;       // rf² - re² - base_y²
+        float rf_squared;
+
         struct {
             bool debug_flag:1;
             bool mirror_xy:1;
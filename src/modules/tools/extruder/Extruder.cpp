@@ -45,6 +45,7 @@
 #define retract_recover_feedrate_checksum    CHECKSUM("retract_recover_feedrate")
 #define retract_zlift_length_checksum        CHECKSUM("retract_zlift_length")
 #define retract_zlift_feedrate_checksum      CHECKSUM("retract_zlift_feedrate")
+#define pressure_advance_checksum            CHECKSUM("pressure_advance")
 
 #define PI 3.14159265358979F
 
@@ -79,9 +80,14 @@ void Extruder::on_module_loaded()
     this->config_load();
 
     // We work on the same Block as Stepper, so we need to know when it gets a new one and drops one
-    this->register_for_event(ON_GCODE_RECEIVED);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
+
+    // G0 and G1 for lifting Z while retracted
+    static const uint16_t gcodes[]= { 0, 1, 10, 11, 92 };
+    static const uint16_t mcodes[]= { 92, 114, 200, 203, 204, 207, 208, 221, 500, 503, 900 };
+    for (auto g : gcodes) this->register_for_gcode('G', g);
+    for (auto m : mcodes) this->register_for_gcode('M', m);
 }
 
 // Get config
@@ -121,6 +127,7 @@ void Extruder::config_load()
     stepper_motor->change_steps_per_mm(steps_per_millimeter);
     stepper_motor->set_selected(false); // not selected by default
     stepper_motor->set_extruder(true);  // indicates it is an extruder
+    stepper_motor->set_pressure_advance(THEKERNEL->config->value(extruder_checksum, this->identifier, pressure_advance_checksum)->by_default(0)->as_number()); // seconds
 }
 
 void Extruder::select()
@@ -312,6 +319,16 @@ void Extruder::on_gcode_received(void *argument)
             if(gcode->has_letter('S')) retract_recover_length = gcode->get_value('S');
             if(gcode->has_letter('F')) retract_recover_feedrate = gcode->get_value('F') / 60.0F; // specified in mm/min converted to mm/sec
 
+        } else if (gcode->m == 900 && ( (this->selected && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+            // M900 Kn set the pressure advance in seconds, 0 turns it off, it applies to blocks planned after this
+            if(gcode->has_letter('K')) {
+                float k = gcode->get_value('K');
+                if(k >= 0) stepper_motor->set_pressure_advance(k);
+            } else {
+                gcode->stream->printf("K:%g", stepper_motor->get_pressure_advance());
+                gcode->add_nl = true;
+            }
+
         } else if (gcode->m == 221 && this->selected) { // M221 S100 change flow rate by percentage
             if(gcode->has_letter('S')) {
                 float last_scale = this->extruder_multiplier;
@@ -334,6 +351,7 @@ void Extruder::on_gcode_received(void *argument)
             gcode->stream->printf(";E retract recover length, feedrate:\nM208 S%1.4f F%1.4f P%d\n", this->retract_recover_length, this->retract_recover_feedrate * 60.0F, this->identifier);
             gcode->stream->printf(";E acceleration mm/sec²:\nM204 E%1.4f P%d\n", stepper_motor->get_acceleration(), this->identifier);
             gcode->stream->printf(";E max feed rate mm/sec:\nM203 E%1.4f P%d\n", stepper_motor->get_max_rate(), this->identifier);
+            gcode->stream->printf(";E pressure advance seconds:\nM900 K%1.4f P%d\n", stepper_motor->get_pressure_advance(), this->identifier);
             if(this->max_volumetric_rate > 0) {
                 gcode->stream->printf(";E max volumetric rate mm³/sec:\nM203 V%1.4f P%d\n", this->max_volumetric_rate, this->identifier);
             }
@@ -95,7 +95,7 @@ void FilamentDetector::on_module_loaded()
     }
 
     register_for_event(ON_MAIN_LOOP);
-    register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    register_for_command("resume", &FilamentDetector::resume_command);
     this->register_for_event(ON_GCODE_RECEIVED);
 }
 
@@ -108,19 +108,14 @@ void FilamentDetector::send_command(std::string msg, StreamOutput *stream)
     THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
 }
 
-// needed to detect when we resume
-void FilamentDetector::on_console_line_received( void *argument )
+// needed to detect when we resume, with resume or M601
+void FilamentDetector::resume_command( string parameters, StreamOutput *stream )
 {
     if(!suspended) return;
 
-    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
-    string possible_command = new_message.message;
-    string cmd = shift_parameter(possible_command);
-    if(cmd == "resume" || cmd == "M601") {
-        this->pulses= 0;
-        e_last_moved= NAN;
-        suspended= false;
-    }
+    this->pulses= 0;
+    e_last_moved= NAN;
+    suspended= false;
 }
 
 float FilamentDetector::get_emove()
@@ -163,6 +158,9 @@ void FilamentDetector::on_gcode_received(void *argument)
             gcode->stream->printf("Encoder pulses: %u\n", pulses.load());
             if(this->suspended) gcode->stream->printf("Filament detector triggered\n");
             gcode->stream->printf("Filament detector is %s\n", active?"enabled":"disabled");
+
+        }else if (gcode->m == 601) { // resume print
+            resume_command("", gcode->stream);
         }
     }
 }
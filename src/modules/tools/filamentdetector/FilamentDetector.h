@@ -21,13 +21,13 @@ public:
     void on_module_loaded();
     void on_main_loop(void* argument);
     void on_second_tick(void* argument);
-    void on_console_line_received( void *argument );
     void on_gcode_received(void *argument);
 
 private:
     void on_pin_rise();
     void check_encoder();
     void send_command(std::string msg, StreamOutput *stream);
+    void resume_command(std::string parameters, StreamOutput *stream);
     uint32_t button_tick(uint32_t dummy);
     float get_emove();
 
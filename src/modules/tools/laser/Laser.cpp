@@ -11,7 +11,6 @@
 #include "nuts_bolts.h"
 #include "Config.h"
 #include "StreamOutputPool.h"
-#include "SerialMessage.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
 #include "StepTicker.h"
@@ -109,70 +108,58 @@ void Laser::on_module_loaded()
 
     //register for events
     this->register_for_event(ON_HALT);
-    this->register_for_event(ON_GCODE_RECEIVED);
-    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    this->register_for_gcode('M', 221);
+    this->register_for_command("fire", &Laser::fire_command);
     this->register_for_event(ON_GET_PUBLIC_DATA);
 
     // no point in updating the power more than the PWM frequency, but not faster than 1KHz
-    ms_per_tick = 1000 / std::min(1000UL, 1000000 / period);
-    THEKERNEL->slow_ticker->attach(std::min(1000UL, 1000000 / period), this, &Laser::set_proportional_power);
+    ms_per_tick = 1000 / std::min<uint32_t>(1000, 1000000 / period);
+    THEKERNEL->slow_ticker->attach(std::min<uint32_t>(1000, 1000000 / period), this, &Laser::set_proportional_power);
 }
 
-void Laser::on_console_line_received( void *argument )
+// fire power% [durationms]|off|status
+void Laser::fire_command( string parameters, StreamOutput *stream )
 {
     if(THEKERNEL->is_halted()) return; // if in halted state ignore any commands
 
-    SerialMessage *msgp = static_cast<SerialMessage *>(argument);
-    string possible_command = msgp->message;
-
-    // ignore anything that is not lowercase or a letter
-    if(possible_command.empty() || !islower(possible_command[0]) || !isalpha(possible_command[0])) {
+    string power = shift_parameter(parameters);
+    if(power.empty()) {
+        stream->printf("Usage: fire power%% [durationms]|off|status\n");
         return;
     }
 
-    string cmd = shift_parameter(possible_command);
-
-    // Act depending on command
-    if (cmd == "fire") {
-        string power = shift_parameter(possible_command);
-        if(power.empty()) {
-            msgp->stream->printf("Usage: fire power%% [durationms]|off|status\n");
-            return;
-        }
-
-        float p;
-        fire_duration = 0; // By default unlimited
-        if(power == "status") {
-            msgp->stream->printf("laser manual state: %s\n", manual_fire ? "on" : "off");
-            return;
-        }
-        if(power == "off" || power == "0") {
-            p = 0;
-            msgp->stream->printf("turning laser off and returning to auto mode\n");
-        } else {
-            p = strtof(power.c_str(), NULL);
-            p = confine(p, 0.0F, 100.0F);
-            string duration = shift_parameter(possible_command);
-            if(!duration.empty()) {
-                fire_duration = atoi(duration.c_str());
-                // Avoid negative values, its just incorrect
-                if (fire_duration < ms_per_tick) {
-                    msgp->stream->printf("WARNING: Minimal duration is %ld ms, not firing\n", ms_per_tick);
-                    return;
-                }
-                // rounding to minimal value
-                if (fire_duration % ms_per_tick != 0) {
-                    fire_duration = (fire_duration / ms_per_tick) * ms_per_tick;
-                }
-                msgp->stream->printf("WARNING: Firing laser at %1.2f%% power, for %ld ms, use fire off to stop test fire earlier\n", p, fire_duration);
-            } else {
-                msgp->stream->printf("WARNING: Firing laser at %1.2f%% power, entering manual mode use fire off to return to auto mode\n", p);
+    float p;
+    fire_duration = 0; // By default unlimited
+    if(power == "status") {
+        stream->printf("laser manual state: %s\n", manual_fire ? "on" : "off");
+        return;
+    }
+    if(power == "off" || power == "0") {
+        p = 0;
+        stream->printf("turning laser off and returning to auto mode\n");
+    } else {
+        p = strtof(power.c_str(), NULL);
+        p = confine(p, 0.0F, 100.0F);
+        string duration = shift_parameter(parameters);
+        if(!duration.empty()) {
+            fire_duration = atoi(duration.c_str());
+            // Avoid negative values, its just incorrect
+            if (fire_duration < ms_per_tick) {
+                stream->printf("WARNING: Minimal duration is %ld ms, not firing\n", (long)ms_per_tick);
+                return;
+            }
+            // rounding to minimal value
+            if (fire_duration % ms_per_tick != 0) {
+                fire_duration = (fire_duration / ms_per_tick) * ms_per_tick;
             }
+            stream->printf("WARNING: Firing laser at %1.2f%% power, for %ld ms, use fire off to stop test fire earlier\n", p, (long)fire_duration);
+        } else {
+            stream->printf("WARNING: Firing laser at %1.2f%% power, entering manual mode use fire off to return to auto mode\n", p);
         }
-
-        p = p / 100.0F;
-        manual_fire = set_laser_power(p);
     }
+
+    p = p / 100.0F;
+    manual_fire = set_laser_power(p);
 }
 
 // returns instance
@@ -219,7 +206,8 @@ float Laser::current_speed_ratio(const Block *block) const
 
     // figure out the ratio of its speed, from 0 to 1 based on where it is on the trapezoid,
     // this is based on the fraction it is of the requested rate (nominal rate)
-    float ratio = block->get_trapezoid_rate(pm) / block->nominal_rate;
+    // and the feed override and a feed hold slow down the block being stepped
+    float ratio = StepTicker::getInstance()->get_trapezoid_rate(pm) / block->nominal_rate * StepTicker::getInstance()->get_time_scale();
 
     return ratio;
 }
@@ -231,7 +219,8 @@ bool Laser::get_laser_power(float& power) const
 
     // Note to avoid a race condition where the block is being cleared we check the is_ready flag which gets cleared first,
     // as this is an interrupt if that flag is not clear then it cannot be cleared while this is running and the block will still be valid (albeit it may have finished)
-    if(block != nullptr && block->is_ready && block->is_g123) {
+    // a feed hold turns the laser off as soon as it starts slowing down so it does not burn a hole where the head stops
+    if(block != nullptr && block->is_ready && block->is_g123 && !StepTicker::getInstance()->is_holding()) {
         float requested_power = ((float)block->s_value / (1 << 11)) / this->laser_maximum_s_value; // s_value is 1.11 Fixed point
         float ratio = current_speed_ratio(block);
         power = requested_power * ratio * scale;
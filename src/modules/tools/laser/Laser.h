@@ -10,12 +10,14 @@
 #include "libs/Module.h"
 
 #include <stdint.h>
+#include <string>
 
 namespace mbed {
     class PwmOut;
 }
 class Pin;
 class Block;
+class StreamOutput;
 
 class Laser : public Module{
     public:
@@ -24,7 +26,6 @@ class Laser : public Module{
         void on_module_loaded();
         void on_halt(void* argument);
         void on_gcode_received(void *argument);
-        void on_console_line_received(void *argument);
         void on_get_public_data(void* argument);
 
         void set_scale(float s) { scale= s/100; }
@@ -33,6 +34,7 @@ class Laser : public Module{
         float get_current_power() const;
 
     private:
+        void fire_command(std::string parameters, StreamOutput *stream);
         uint32_t set_proportional_power(uint32_t dummy);
         bool get_laser_power(float& power) const;
         float current_speed_ratio(const Block *block) const;
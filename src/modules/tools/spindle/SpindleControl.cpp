@@ -10,6 +10,7 @@
 #include "Gcode.h"
 #include "Conveyor.h"
 #include "SpindleControl.h"
+#include "RealtimeCommands.h"
 
 void SpindleControl::on_gcode_received(void *argument) 
 {
@@ -48,7 +49,8 @@ void SpindleControl::on_gcode_received(void *argument)
             // M3 with S value provided: set speed
             if (gcode->has_letter('S'))
             {
-                set_speed(gcode->get_value('S'));
+                commanded_speed = gcode->get_value('S');
+                set_overridden_speed();
             }
         }
         else if (gcode->m == 5)
@@ -69,5 +71,44 @@ void SpindleControl::on_halt(void *argument)
         if(spindle_on) {
             turn_off();
         }
+        if(stopped_in_hold) {
+            stopped_in_hold = false;
+            THEKERNEL->realtime->hold_resume(false);
+        }
+    }
+}
+
+// the realtime spindle commands, these are taken here as they can not be done from the receive interrupt
+void SpindleControl::on_idle(void *argument)
+{
+    RealtimeCommands *rt = THEKERNEL->realtime;
+
+    if (rt->take(RealtimeCommands::SPINDLE_OVERRIDE) && commanded_speed >= 0) {
+        set_overridden_speed();
     }
+
+    if (rt->take(RealtimeCommands::SPINDLE_STOP)) {
+        if (spindle_on && THEKERNEL->get_feed_hold()) {
+            // the cycle start has to come here to turn it back on before the motion carries on
+            turn_off();
+            stopped_in_hold = true;
+            rt->hold_resume(true);
+        } else if (stopped_in_hold) {
+            turn_on();
+            stopped_in_hold = false;
+            rt->hold_resume(false);
+        }
+    }
+
+    if (rt->take(RealtimeCommands::RESUME) && stopped_in_hold) {
+        turn_on();
+        stopped_in_hold = false;
+        rt->hold_resume(false);
+        THEKERNEL->set_feed_hold(false);
+    }
+}
+
+void SpindleControl::set_overridden_speed()
+{
+    set_speed(commanded_speed * THEKERNEL->realtime->get_spindle_override() / 100);
 }
@@ -22,6 +22,11 @@ class SpindleControl: public Module {
     private:
         void on_gcode_received(void *argument);
         void on_halt(void *argument);
+        void on_idle(void *argument);
+        void set_overridden_speed();
+
+        int commanded_speed{-1};         // last M3 S, the realtime spindle override is a percentage of it
+        bool stopped_in_hold{false};     // the realtime spindle stop turned it off during a feed hold
         
         virtual void turn_on(void) {};
         virtual void turn_off(void) {};
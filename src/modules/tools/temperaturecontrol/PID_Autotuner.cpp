@@ -29,7 +29,7 @@ void PID_Autotuner::on_module_loaded()
     tick = false;
     THEKERNEL->slow_ticker->attach(20, this, &PID_Autotuner::on_tick );
     register_for_event(ON_IDLE);
-    register_for_event(ON_GCODE_RECEIVED);
+    register_for_gcode('M', 303, 304);
 }
 
 void PID_Autotuner::begin(float target, int ncycles)
@@ -136,7 +136,7 @@ TemperatureSwitch* TemperatureSwitch::load_config(uint16_t modcs)
     ts->register_for_event(ON_SECOND_TICK);
 
     if(ts->arm_mcode != 0) {
-        ts->register_for_event(ON_GCODE_RECEIVED);
+        ts->register_for_gcode('M', ts->arm_mcode);
     }
     return ts;
 }
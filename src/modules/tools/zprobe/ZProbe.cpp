@@ -68,8 +68,11 @@ void ZProbe::on_module_loaded()
 
     // load settings
     this->config_load();
-    // register event-handlers
-    register_for_event(ON_GCODE_RECEIVED);
+    // register event-handlers, the M codes include the ones the leveling strategies handle
+    register_for_gcode('G', 29, 32);
+    register_for_gcode('G', 38);
+    static const uint16_t mcodes[]= { 119, 370, 374, 375, 500, 503, 557, 561, 565, 670, 9999 };
+    for (auto m : mcodes) register_for_gcode('M', m);
 
     // we read the probe in this timer
     probing= false;
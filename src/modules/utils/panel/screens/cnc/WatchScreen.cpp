@@ -153,7 +153,7 @@ void WatchScreen::get_current_status()
 float WatchScreen::get_current_speed()
 {
     // in percent
-    return 6000.0F / THEROBOT->get_seconds_per_minute();
+    return THEROBOT->get_feed_override();
 }
 
 void WatchScreen::get_sd_play_info()
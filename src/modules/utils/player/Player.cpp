@@ -57,7 +57,11 @@ Player::Player()
 
 void Player::on_module_loaded()
 {
-    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    this->register_for_command("play", &Player::play_command);
+    this->register_for_command("progress", &Player::progress_command);
+    this->register_for_command("abort", &Player::abort_command);
+    this->register_for_command("suspend", &Player::suspend_command);
+    this->register_for_command("resume", &Player::resume_command);
     this->register_for_event(ON_MAIN_LOOP);
     this->register_for_event(ON_SECOND_TICK);
     this->register_for_event(ON_GET_PUBLIC_DATA);
@@ -242,40 +246,11 @@ void Player::on_gcode_received(void *argument)
 }
 
 // When a new line is received, check if it is a command, and if it is, act upon it
-void Player::on_console_line_received( void *argument )
-{
-    if(THEKERNEL->is_halted()) return; // if in halted state ignore any commands
-
-    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
-
-    string possible_command = new_message.message;
-
-    // ignore anything that is not lowercase or a letter
-    if(possible_command.empty() || !islower(possible_command[0]) || !isalpha(possible_command[0])) {
-        return;
-    }
-
-    string cmd = shift_parameter(possible_command);
-
-    //new_message.stream->printf("Received %s\r\n", possible_command.c_str());
-
-    // Act depending on command
-    if (cmd == "play"){
-        this->play_command( possible_command, new_message.stream );
-    }else if (cmd == "progress"){
-        this->progress_command( possible_command, new_message.stream );
-    }else if (cmd == "abort") {
-        this->abort_command( possible_command, new_message.stream );
-    }else if (cmd == "suspend") {
-        this->suspend_command( possible_command, new_message.stream );
-    }else if (cmd == "resume") {
-        this->resume_command( possible_command, new_message.stream );
-    }
-}
-
 // Play a gcode file by considering each line as if it was received on the serial console
 void Player::play_command( string parameters, StreamOutput *stream )
 {
+    if(THEKERNEL->is_halted()) return; // if in halted state ignore any commands
+
     // extract any options from the line and terminate the line there
     string options= extract_options(parameters);
     // Get filename which is the entire parameter line upto any options found or entire line
@@ -516,6 +491,8 @@ User may jog or remove and insert filament at this point, extruding or retractin
 */
 void Player::suspend_command(string parameters, StreamOutput *stream )
 {
+    if(THEKERNEL->is_halted()) return; // if in halted state ignore any commands
+
     if(suspended) {
         stream->printf("Already suspended\n");
         return;
@@ -610,6 +587,8 @@ resume the suspended print
 */
 void Player::resume_command(string parameters, StreamOutput *stream )
 {
+    if(THEKERNEL->is_halted()) return; // if in halted state ignore any commands
+
     if(!suspended) {
         stream->printf("Not suspended\n");
         return;
@@ -23,7 +23,6 @@ class Player : public Module {
         Player();
 
         void on_module_loaded();
-        void on_console_line_received( void* argument );
         void on_main_loop( void* argument );
         void on_second_tick(void* argument);
         void on_get_public_data(void* argument);
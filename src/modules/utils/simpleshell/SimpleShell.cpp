@@ -152,6 +152,10 @@ static uint32_t heapWalk(StreamOutput *stream, bool verbose)
 
 void SimpleShell::on_module_loaded()
 {
+    // the table commands go straight to their functions, the rest of the lowercase and $ lines come here
+    for (const ptentry_t *p = commands_table; p->command != NULL; ++p) {
+        THEKERNEL->register_for_command(p->command, p->func);
+    }
     this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
     this->register_for_event(ON_GCODE_RECEIVED);
     this->register_for_event(ON_SECOND_TICK);
@@ -202,14 +206,16 @@ bool SimpleShell::parse_command(const char *cmd, string args, StreamOutput *stre
 // When a new line is received, check if it is a command, and if it is, act upon it
 void SimpleShell::on_console_line_received( void *argument )
 {
-    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
-    string possible_command = new_message.message;
+    SerialMessage *msgp = static_cast<SerialMessage *>(argument);
 
-    // ignore anything that is not lowercase or a $ as it is not a command
-    if(possible_command.size() == 0 || (!islower(possible_command[0]) && possible_command[0] != '$')) {
+    // ignore anything that is not lowercase or a $ as it is not a command, before taking a copy of it
+    if(msgp->message.size() == 0 || (!islower(msgp->message[0]) && msgp->message[0] != '$')) {
         return;
     }
 
+    SerialMessage new_message = *msgp;
+    string possible_command = new_message.message;
+
     // it is a grbl compatible command
     if(possible_command[0] == '$' && possible_command.size() >= 2) {
         switch(possible_command[1]) {
@@ -254,8 +260,18 @@ void SimpleShell::on_console_line_received( void *argument )
                 break;
 
             case 'J':
-                // instant jog command
-                jog(possible_command, new_message.stream);
+                if(possible_command.size() > 2 && possible_command[2] == '=') {
+                    // grbl jog, cancellable with the realtime jog cancel
+                    string error;
+                    if(THEROBOT->jog(possible_command.substr(3), new_message.stream, error)) {
+                        new_message.stream->printf("ok\n");
+                    } else {
+                        new_message.stream->printf("error:%s\n", error.c_str());
+                    }
+                } else {
+                    // instant jog command
+                    jog(possible_command, new_message.stream);
+                }
                 break;
 
             default:
@@ -278,12 +294,6 @@ void SimpleShell::on_console_line_received( void *argument )
         } else if (cmd == "config-load"){
             THEKERNEL->configurator->config_load_command(  possible_command, new_message.stream );
 
-        } else if (cmd == "play" || cmd == "progress" || cmd == "abort" || cmd == "suspend" || cmd == "resume") {
-            // these are handled by Player module
-
-        } else if (cmd == "fire") {
-            // these are handled by Laser module
-
         } else if (cmd.substr(0, 2) == "ok") {
             // probably an echo so ignore the whole line
             //new_message.stream->printf("ok\n");
@@ -858,7 +868,11 @@ void SimpleShell::get_command( string parameters, StreamOutput *stream)
 
     } else if (what == "status") {
         // also ? on serial and usb
-        stream->printf("%s\n", THEKERNEL->get_query_string().c_str());
+        stream->printf("%s\n", THEKERNEL->get_query_string(stream).c_str());
+
+    } else if (what == "buffer") {
+        // free planner blocks and receive buffer bytes, as Bf: in the status, -1 if the stream does not know
+        stream->printf("Bf:%u,%d\n", THECONVEYOR->get_queue_free(), stream->rx_free());
 
     } else {
         stream->printf("error:unknown option %s\n", what.c_str());
@@ -1235,7 +1249,7 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("break - break into debugger\r\n");
     stream->printf("config-get [<configuration_source>] <configuration_setting>\r\n");
     stream->printf("config-set [<configuration_source>] <configuration_setting> <value>\r\n");
-    stream->printf("get [pos|wcs|state|status|fk|ik]\r\n");
+    stream->printf("get [pos|wcs|state|status|buffer|fk|ik]\r\n");
     stream->printf("get temp [bed|hotend]\r\n");
     stream->printf("set_temp bed|hotend 185\r\n");
     stream->printf("switch name [value]\r\n");
@@ -0,0 +1,68 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Simulated peripherals and the bits of mbed/MRI/shell the motion code links against
+ */
+
+#include "mbed.h"
+#include "MRI_Hooks.h"
+#include "Simulator.h"
+#include "SimpleShell.h"
+#include "StreamOutput.h"
+
+#include <bitset>
+
+LPC_GPIO_TypeDef   sim_gpio[5];
+LPC_PINCON_TypeDef sim_pincon;
+LPC_TIM_TypeDef    sim_tim[4];
+LPC_SC_TypeDef     sim_sc;
+LPC_WDT_TypeDef    sim_wdt;
+SCB_Type           sim_scb;
+
+uint32_t SystemCoreClock = 100000000;
+
+static std::bitset<64> enabled_irqs;
+
+bool sim_irq_enabled(IRQn_Type irq)
+{
+    return irq >= 0 && enabled_irqs[irq];
+}
+
+extern "C" {
+
+void NVIC_SetPriorityGrouping(uint32_t PriorityGroup) {}
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) {}
+uint32_t NVIC_GetPriority(IRQn_Type IRQn) { return 0; }
+void NVIC_EnableIRQ(IRQn_Type IRQn) { if(IRQn >= 0) enabled_irqs.set(IRQn); }
+void NVIC_DisableIRQ(IRQn_Type IRQn) { if(IRQn >= 0) enabled_irqs.reset(IRQn); }
+void NVIC_SetPendingIRQ(IRQn_Type IRQn) {}
+void NVIC_SystemReset(void) { exit(1); }
+
+// the microsecond clock follows the simulated step ticker
+uint32_t us_ticker_read(void)
+{
+    return Simulator::instance != nullptr ? Simulator::instance->get_us() : 0;
+}
+
+// the step ticker keeps running while the main loop waits
+void wait_us(int us) { if(Simulator::instance != nullptr) Simulator::instance->advance_us(us); }
+void wait_ms(int ms) { wait_us(ms * 1000); }
+void wait(float s) { wait_us(s * 1000000.0F); }
+
+void __mriPlatform_EnteringDebuggerHook() {}
+void __mriPlatform_LeavingDebuggerHook() {}
+void set_high_on_debug(int port, int pin) {}
+void set_low_on_debug(int port, int pin) {}
+
+}
+
+// there is no shell in the simulator
+bool SimpleShell::parse_command(const char *cmd, string args, StreamOutput *stream)
+{
+    return false;
+}
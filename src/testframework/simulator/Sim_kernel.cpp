@@ -0,0 +1,219 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+This is part of the Smoothie simulator, it replaces the Kernel with one that only loads the motion modules
+and drives the simulated step ticker from ON_IDLE
+*/
+
+#include "libs/Kernel.h"
+#include "libs/Module.h"
+#include "libs/Config.h"
+#include "libs/nuts_bolts.h"
+#include "libs/StreamOutputPool.h"
+#include "checksumm.h"
+#include "ConfigValue.h"
+#include "ConfigSource.h"
+
+#include "libs/StepTicker.h"
+#include "libs/RealtimeCommands.h"
+#include "libs/GcodeRoutes.h"
+#include "libs/ConsoleCommands.h"
+#include "modules/communication/GcodeDispatch.h"
+#include "modules/robot/Planner.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/Conveyor.h"
+#include "modules/tools/laser/Laser.h"
+#include "SlowTicker.h"
+
+#include "Simulator.h"
+
+#define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
+#define microseconds_per_step_pulse_checksum        CHECKSUM("microseconds_per_step_pulse")
+#define step_segments_enable_checksum               CHECKSUM("step_segments_enable")
+#define step_segment_time_ms_checksum               CHECKSUM("step_segment_time_ms")
+#define step_multiplier_max_checksum                CHECKSUM("step_multiplier_max")
+#define step_multiplier_threshold_checksum          CHECKSUM("step_multiplier_threshold")
+#define step_events_enable_checksum                 CHECKSUM("step_events_enable")
+#define feed_override_ramp_time_checksum            CHECKSUM("feed_override_ramp_time")
+#define grbl_mode_checksum                          CHECKSUM("grbl_mode")
+#define feed_hold_enable_checksum                   CHECKSUM("enable_feed_hold")
+#define ok_per_line_checksum                        CHECKSUM("ok_per_line")
+
+Kernel* Kernel::instance;
+
+// set by Simulator::boot() before the Kernel is created
+ConfigSource *sim_config_source;
+
+Kernel::Kernel()
+{
+    halted = false;
+    feed_hold = false;
+    enable_feed_hold = false;
+    use_leds = false;
+
+    instance = this; // setup the Singleton instance of the kernel
+
+    // the serial interrupts can get realtime commands before the rest is set up
+    this->step_ticker = nullptr;
+    this->realtime = new RealtimeCommands();
+    this->gcode_routes = new GcodeRoutes();
+    this->console_commands = new ConsoleCommands();
+
+    this->serial = nullptr;
+    this->slow_ticker = new SlowTicker();
+    this->adc = nullptr;
+    this->simpleshell = nullptr;
+    this->configurator = nullptr;
+
+    this->config = new Config(sim_config_source);
+    this->config->config_cache_load();
+
+    this->streams = new StreamOutputPool();
+    this->current_path = "/";
+
+    this->grbl_mode = this->config->value( grbl_mode_checksum )->by_default(false)->as_bool();
+    this->enable_feed_hold = this->config->value( feed_hold_enable_checksum )->by_default(this->grbl_mode)->as_bool();
+    this->ok_per_line = this->config->value( ok_per_line_checksum )->by_default(true)->as_bool();
+
+    this->step_ticker = new StepTicker();
+
+    // Configure the step ticker
+    this->base_stepping_frequency = this->config->value(base_stepping_frequency_checksum)->by_default(100000)->as_number();
+    float microseconds_per_step_pulse = this->config->value(microseconds_per_step_pulse_checksum)->by_default(1)->as_number();
+
+    this->step_ticker->set_frequency( this->base_stepping_frequency );
+    this->step_ticker->set_unstep_time( microseconds_per_step_pulse );
+
+    // optionally prepare constant rate segments outside of the step interrupt
+    if(this->config->value(step_segments_enable_checksum)->by_default(false)->as_bool()) {
+        this->step_ticker->enable_segments(this->config->value(step_segment_time_ms_checksum)->by_default(1.0F)->as_number());
+    }
+
+    // optionally only interrupt on the ticks that have something to do
+    if(this->config->value(step_events_enable_checksum)->by_default(false)->as_bool()) {
+        this->step_ticker->enable_events();
+    }
+
+    // how long the feed override takes to go from 0 to 100%
+    this->step_ticker->set_speed_ramp(this->config->value(feed_override_ramp_time_checksum)->by_default(0.2F)->as_number());
+
+    // optionally issue 2 or 4 steps per tick for blocks faster than the threshold (steps/sec)
+    uint8_t step_multiplier_max = this->config->value(step_multiplier_max_checksum)->by_default(1)->as_int();
+    if(step_multiplier_max > 1) {
+        this->step_ticker->enable_multistep(step_multiplier_max, this->config->value(step_multiplier_threshold_checksum)->by_default((float)this->base_stepping_frequency)->as_number());
+    }
+
+    // Core modules
+    this->add_module( this->conveyor       = new Conveyor()      );
+    this->add_module( this->gcode_dispatch = new GcodeDispatch() );
+    this->add_module( this->robot          = new Robot()         );
+
+    // only stays loaded if laser_module_enable is set
+    this->add_module( new Laser() );
+
+    this->planner = new Planner();
+}
+
+std::string Kernel::get_query_string(StreamOutput *stream)
+{
+    return "<Sim>\n";
+}
+
+// the step ticker brings the current move to a stop, the robot stops queuing more until it is released
+void Kernel::set_feed_hold(bool f)
+{
+    feed_hold= f;
+    if(step_ticker != nullptr) step_ticker->set_feed_hold(f);
+}
+
+// Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
+void Kernel::add_module(Module* module)
+{
+    module->on_module_loaded();
+}
+
+// Adds a hook for a given module and event
+void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+    this->hooks[id_event].push_back(mod);
+    if(id_event == ON_GCODE_RECEIVED) this->gcode_routes->add(mod);
+}
+
+void Kernel::register_for_gcode(char letter, uint16_t first, uint16_t last, Module *mod)
+{
+    if(!this->gcode_routes->has(mod)) this->hooks[ON_GCODE_RECEIVED].push_back(mod);
+    this->gcode_routes->add(mod, letter, first, last);
+}
+
+void Kernel::register_for_command(const char *name, Module *mod, ModuleCommand method)
+{
+    this->console_commands->add(name, mod, method);
+}
+
+void Kernel::register_for_command(const char *name, ConsoleFunction function)
+{
+    this->console_commands->add(name, function);
+}
+
+// Call a specific event with an argument
+void Kernel::call_event(_EVENT_ENUM id_event, void * argument)
+{
+    // a console command goes to just the handlers for it
+    if(id_event == ON_CONSOLE_LINE_RECEIVED && this->console_commands->call(static_cast<SerialMessage*>(argument))) return;
+
+    bool was_idle = true;
+    if(id_event == ON_HALT) {
+        this->halted = (argument == nullptr);
+        if(!this->halted && this->feed_hold) set_feed_hold(false); // also clear feed hold
+        was_idle = conveyor->is_idle(); // see if we were doing anything like printing
+    }
+
+    // the step ticker interrupts would have been running while the main loop went round
+    if(id_event == ON_IDLE && Simulator::instance != nullptr) {
+        Simulator::instance->advance(Simulator::instance->ticks_per_idle);
+    }
+
+    if(id_event == ON_GCODE_RECEIVED) {
+        // only to the modules that handle this code
+        this->gcode_routes->call(static_cast<Gcode*>(argument));
+
+    } else {
+        // send to all registered modules
+        for (auto m : hooks[id_event]) {
+            (m->*kernel_callback_functions[id_event])(argument);
+        }
+    }
+
+    if(id_event == ON_HALT) {
+        if(!this->halted || !was_idle) {
+            // fix up the current positions in case they got out of sync due to backed up commands
+            this->robot->reset_position_from_current_actuator_position();
+        }
+    }
+}
+
+// These are used by tests to test for various things. basically mocks
+bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
+{
+    for (auto m : hooks[id_event]) {
+        if(m == mod) return true;
+    }
+    return false;
+}
+
+void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+    if(id_event == ON_GCODE_RECEIVED) this->gcode_routes->remove(mod);
+    if(id_event == ON_CONSOLE_LINE_RECEIVED) this->console_commands->remove(mod);
+    for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
+        if(*i == mod) {
+            hooks[id_event].erase(i);
+            return;
+        }
+    }
+}
@@ -0,0 +1,244 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "BaseSolution.h"
+#include "StreamOutput.h"
+#include "StreamOutputPool.h"
+#include "platform_memory.h"
+#include "Gcode.h"
+
+#include "easyunit/testharness.h"
+#include "easyunit/test.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+// stands in for the AHB SRAM banks
+static uint8_t ahb0_ram[0xFFF0] __attribute__ ((aligned (8)));
+static uint8_t ahb1_ram[0xFFF0] __attribute__ ((aligned (8)));
+
+class StdoutStream : public StreamOutput {
+    public:
+        int puts(const char *s) { return fputs(s, stdout); }
+};
+
+// plans the same dense path (short segments round a wobbly circle) with increasing queue sizes
+// and reports the time spent outside the step ticker per block
+static void planner_benchmark(Simulator &sim, StreamOutput *out)
+{
+    static const int queue_sizes[] = { 8, 16, 32, 64, 128 };
+    const int n_blocks = 5000;
+
+    out->printf("queue size, us per block\n");
+    for(int qs : queue_sizes) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "planner_queue_size %d\nacceleration 1000\n", qs);
+        sim.boot(buf);
+        sim.reset_stats();
+
+        for (int i = 0; i < n_blocks; ++i) {
+            float a = i * 0.01F;
+            float r = 20 + 5 * sinf(i * 0.002F);
+            snprintf(buf, sizeof(buf), "G1 X%1.3f Y%1.3f F6000", r * cosf(a), r * sinf(a));
+            sim.send_line(buf);
+        }
+        sim.finish();
+
+        out->printf("%d, %1.2f\n", qs, (float)sim.get_plan_us() / n_blocks);
+    }
+}
+
+static uint64_t now_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// converts points round a circle one at a time and then as 8 segment lines with each arm solution
+// and reports conversions per second, an upper bound on the segments per second the solution can plan
+static void arm_solution_benchmark(Simulator &sim, StreamOutput *out)
+{
+    static const char *solutions[] = { "cartesian", "hbot", "corexz", "rotatable_cartesian", "linear_delta", "rotary_delta", "morgan" };
+    const int n_points = 400000;
+    const int batch = 8;
+
+    out->printf("arm solution, single conversions/s, line conversions/s\n");
+    for(const char *name : solutions) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "arm_solution %s\n", name);
+        sim.boot(buf);
+        BaseSolution *solution = THEROBOT->arm_solution;
+        volatile float sink = 0;
+
+        ActuatorCoordinates a[batch];
+        uint64_t st = now_us();
+        for (int i = 0; i < n_points; ++i) {
+            float p[3]{ 40 * cosf(i * 0.001F), 40 * sinf(i * 0.001F), 10 };
+            solution->cartesian_to_actuator(p, a[0]);
+            sink += a[0][0];
+        }
+        uint64_t single_us = now_us() - st;
+
+        st = now_us();
+        for (int i = 0; i < n_points; i += batch) {
+            float p0[3]{ 40 * cosf(i * 0.001F), 40 * sinf(i * 0.001F), 10 };
+            float p1[3]{ 40 * cosf((i + batch) * 0.001F), 40 * sinf((i + batch) * 0.001F), 10 };
+            solution->line_to_actuators(p0, p1, a, batch);
+            sink += a[batch - 1][0];
+        }
+        uint64_t line_us = now_us() - st;
+
+        out->printf("%s, %1.0f, %1.0f\n", name, n_points * 1e6F / (single_us ? single_us : 1), n_points * 1e6F / (line_us ? line_us : 1));
+    }
+}
+
+// parses a mix of streamed lines and looks up their words the way Robot does for each one
+// and reports the lines per second, no planning is done
+static void gcode_benchmark(StreamOutput *out)
+{
+    static const char *lines[] = {
+        "G1 X12.345 Y-23.456 E0.04512 F2400",
+        "G1 X12.412 Y-23.398 E0.00311",
+        "G0 X100 Y100 Z0.3 F9000",
+        "G2 X10.5 Y3.25 I-1.5 J2.75 F1200",
+        "G1 Z0.6",
+        "M106 S255",
+        "M3 S12000",
+        "G92 E0",
+    };
+    const int n_lines = 1000000;
+    const int n = sizeof(lines) / sizeof(lines[0]);
+    std::string strings[n];
+    for (int i = 0; i < n; ++i) strings[i] = lines[i];
+
+    volatile float sink = 0;
+    uint64_t st = now_us();
+    for (int i = 0; i < n_lines; ++i) {
+        Gcode gc(strings[i % n], &StreamOutput::NullStream);
+        if(gc.has_g) {
+            for (char c : { 'X', 'Y', 'Z', 'A', 'B', 'C' }) {
+                if(gc.has_letter(c)) sink += gc.get_value(c);
+            }
+            for (char c : { 'E', 'F', 'I', 'J', 'K', 'R', 'P', 'S' }) {
+                if(gc.has_letter(c)) sink += gc.get_value(c);
+            }
+        } else if(gc.has_m) {
+            if(gc.has_letter('S')) sink += gc.get_value('S');
+            if(gc.has_letter('P')) sink += gc.get_int('P');
+            sink += gc.get_num_args();
+        }
+    }
+    uint64_t us = now_us() - st;
+
+    out->printf("Gcode size: %u bytes\n", (unsigned)sizeof(Gcode));
+    out->printf("lines parsed/s: %1.0f\n", n_lines * 1e6F / (us ? us : 1));
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-t timeline.csv] [-i ticks_per_idle] [-v] [-T] [-b] [-k] [-g] [file.gcode]\n", prog);
+    fprintf(stderr, "  -c  config file to load, the firmware defaults are used otherwise\n");
+    fprintf(stderr, "  -t  write every step issued to the given file as tick,motor,position\n");
+    fprintf(stderr, "  -i  step ticks simulated per main loop iteration (default 10)\n");
+    fprintf(stderr, "  -v  print the gcode replies\n");
+    fprintf(stderr, "  -T  run the unit tests and exit\n");
+    fprintf(stderr, "  -b  run the planner queue size benchmark and exit\n");
+    fprintf(stderr, "  -k  run the arm solution conversion benchmark and exit\n");
+    fprintf(stderr, "  -g  run the gcode parsing benchmark and exit\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *config_file = nullptr;
+    const char *timeline_file = nullptr;
+    bool verbose = false;
+    bool run_tests = false;
+    bool run_benchmark = false;
+    bool run_kinematics_benchmark = false;
+    bool run_gcode_benchmark = false;
+    int ticks_per_idle = 0;
+
+    int c;
+    while((c = getopt(argc, argv, "c:t:i:vTbkgh")) != -1) {
+        switch(c) {
+            case 'c': config_file = optarg; break;
+            case 't': timeline_file = optarg; break;
+            case 'i': ticks_per_idle = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            case 'T': run_tests = true; break;
+            case 'b': run_benchmark = true; break;
+            case 'k': run_kinematics_benchmark = true; break;
+            case 'g': run_gcode_benchmark = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    _AHB0 = new MemoryPool(ahb0_ram, sizeof(ahb0_ram));
+    _AHB1 = new MemoryPool(ahb1_ram, sizeof(ahb1_ram));
+
+    Simulator sim;
+    StdoutStream out;
+
+    if(run_tests) {
+        // each test boots its own kernel
+        const TestResult *res = TestRegistry::runAndPrint();
+        return (res->getErrors() > 0 || res->getFailures() > 0) ? 1 : 0;
+    }
+
+    if(run_benchmark) {
+        planner_benchmark(sim, &out);
+        return 0;
+    }
+
+    if(run_kinematics_benchmark) {
+        arm_solution_benchmark(sim, &out);
+        return 0;
+    }
+
+    if(run_gcode_benchmark) {
+        gcode_benchmark(&out);
+        return 0;
+    }
+
+    if(optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sim.boot(config_file, config_file != nullptr);
+    if(ticks_per_idle > 0) sim.ticks_per_idle = ticks_per_idle;
+    if(verbose) {
+        THEKERNEL->streams->append_stream(&out);
+        sim.echo = &out;
+    }
+
+    if(timeline_file != nullptr && !sim.open_timeline(timeline_file)) {
+        fprintf(stderr, "Could not open %s\n", timeline_file);
+        return 1;
+    }
+
+    sim.reset_stats();
+    if(!sim.run_file(argv[optind])) {
+        fprintf(stderr, "Could not open %s\n", argv[optind]);
+        return 1;
+    }
+    sim.finish();
+    sim.close_timeline();
+
+    sim.print_stats(&out);
+
+    return 0;
+}
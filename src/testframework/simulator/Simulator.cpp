@@ -0,0 +1,279 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+#include "StepperMotor.h"
+#include "Robot.h"
+#include "Conveyor.h"
+#include "SlowTicker.h"
+#include "SerialMessage.h"
+#include "StreamOutput.h"
+#include "StreamOutputPool.h"
+#include "FileConfigSource.h"
+#include "FirmConfigSource.h"
+
+#include "mbed.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <sys/time.h>
+
+extern "C" void TIMER0_IRQHandler(void);
+extern "C" void TIMER1_IRQHandler(void);
+extern "C" void PendSV_Handler(void);
+extern bool sim_irq_enabled(IRQn_Type irq);
+extern ConfigSource *sim_config_source;
+
+Simulator *Simulator::instance;
+
+const char *Simulator::default_config =
+    "alpha_step_pin   2.0\n"
+    "alpha_dir_pin    0.5\n"
+    "alpha_en_pin     0.4\n"
+    "beta_step_pin    2.1\n"
+    "beta_dir_pin     0.11\n"
+    "beta_en_pin      0.10\n"
+    "gamma_step_pin   2.2\n"
+    "gamma_dir_pin    0.20\n"
+    "gamma_en_pin     0.19\n";
+
+// collects the replies to a line so callers can check them
+class StringStream : public StreamOutput {
+    public:
+        StringStream(std::string *s) : str(s) {}
+        int puts(const char *s) { if(str != nullptr) str->append(s); return strlen(s); }
+
+    private:
+        std::string *str;
+};
+
+static uint64_t wall_us()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+Simulator::Simulator()
+{
+    instance = this;
+    timeline = nullptr;
+    step_log = nullptr;
+    step_log_motor = 0;
+    ticks = 0;
+    tim0_count = 0;
+    ms_count = 0;
+    ticks_per_ms = 100;
+    ticks_per_idle = 10;
+    echo = nullptr;
+    reset_stats();
+}
+
+Simulator::~Simulator()
+{
+    close_timeline();
+    instance = nullptr;
+}
+
+void Simulator::boot(const char *config, bool from_file)
+{
+    if(THEKERNEL != nullptr) {
+        // give the block queue back to the pool, the rest of the old kernel is simply abandoned
+        delete THECONVEYOR;
+    }
+
+    if(from_file) {
+        sim_config_source = new FileConfigSource(config, "sim");
+    } else {
+        config_text = default_config;
+        if(config != nullptr) config_text.append(config);
+        sim_config_source = new FirmConfigSource("sim", config_text.data(), config_text.data() + config_text.size());
+    }
+
+    new Kernel();
+
+    // start the timers and interrupts
+    THECONVEYOR->start(THEROBOT->get_number_registered_motors());
+    THEKERNEL->step_ticker->start();
+
+    ticks = 0;
+    tim0_count = 0;
+    ms_count = 0;
+    ticks_per_ms = std::max(1, (int)(THEKERNEL->step_ticker->get_frequency() / 1000));
+    last_steps.clear();
+    sample_motors();
+    reset_stats();
+}
+
+bool Simulator::open_timeline(const char *fn)
+{
+    close_timeline();
+    timeline = fopen(fn, "w");
+    if(timeline == nullptr) return false;
+    fprintf(timeline, "tick,motor,position\n");
+    return true;
+}
+
+void Simulator::close_timeline()
+{
+    if(timeline != nullptr) {
+        fclose(timeline);
+        timeline = nullptr;
+    }
+}
+
+uint32_t Simulator::get_us() const
+{
+    float f = THEKERNEL->step_ticker != nullptr ? THEKERNEL->step_ticker->get_frequency() : 100000;
+    return (uint32_t)(ticks * 1000000 / (uint64_t)f);
+}
+
+// record any motor that moved since the last tick
+void Simulator::sample_motors()
+{
+    if(THEROBOT == nullptr) return;
+
+    size_t n = THEROBOT->actuators.size();
+    if(last_steps.size() != n) last_steps.resize(n, 0);
+
+    for (size_t m = 0; m < n; ++m) {
+        int32_t pos = (int32_t)THEROBOT->actuators[m]->get_current_step();
+        if(pos != last_steps[m]) {
+            if(timeline != nullptr) fprintf(timeline, "%llu,%u,%d\n", (unsigned long long)ticks, (unsigned)m, pos);
+            if(step_log != nullptr && (int)m == step_log_motor) step_log->push_back(ticks);
+            last_steps[m] = pos;
+        }
+    }
+}
+
+void Simulator::tick()
+{
+    // the step interrupt fires when the timer reaches the match register, every tick unless the step ticker skips some
+    tim0_count += THEKERNEL->step_ticker->get_period();
+    if(tim0_count >= LPC_TIM0->MR0 && sim_irq_enabled(TIMER0_IRQn)) {
+        // the timer restarts from what it has counted past the match, which matters when the period is not a whole tick
+        tim0_count -= LPC_TIM0->MR0;
+        if(tim0_count >= LPC_TIM0->MR0) tim0_count = 0; // it was disabled
+        ++interrupts;
+        TIMER0_IRQHandler();
+
+        // the unstep timer is started by step_tick, it always expires before the next tick,
+        // for multi step ticks it restarts itself for each of the extra pulses
+        while(LPC_TIM1->TCR == 1) {
+            LPC_TIM1->TCR = 0;
+            if(sim_irq_enabled(TIMER1_IRQn)) TIMER1_IRQHandler();
+        }
+
+        // PendSV has a lower priority than the timers so it runs once they return
+        if(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) {
+            SCB->ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+            ++pendsvs;
+            PendSV_Handler();
+        }
+
+        const void *b = THEKERNEL->step_ticker->get_current_block();
+        if(b != nullptr && b != last_block) ++blocks;
+        last_block = b;
+    }
+
+    // the slow ticker runs every millisecond
+    if(++ms_count >= ticks_per_ms) {
+        ms_count = 0;
+        THEKERNEL->slow_ticker->tick();
+    }
+
+    ++ticks;
+    sample_motors();
+}
+
+void Simulator::advance(uint32_t n)
+{
+    uint64_t st = wall_us();
+    for (uint32_t i = 0; i < n; ++i) {
+        tick();
+    }
+    wall_tick_us += wall_us() - st;
+}
+
+void Simulator::advance_us(uint32_t us)
+{
+    float f = THEKERNEL->step_ticker != nullptr ? THEKERNEL->step_ticker->get_frequency() : 100000;
+    advance((uint32_t)ceilf(us * f / 1000000.0F));
+}
+
+void Simulator::send_line(const char *line, std::string *reply)
+{
+    StringStream ss(reply);
+    SerialMessage message;
+    message.message = line;
+    message.stream = (reply == nullptr && echo != nullptr) ? echo : &ss;
+    THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+    ++lines;
+}
+
+bool Simulator::run_file(const char *fn)
+{
+    FILE *fp = fopen(fn, "r");
+    if(fp == nullptr) return false;
+
+    char buf[256];
+    while(fgets(buf, sizeof(buf), fp) != nullptr) {
+        size_t n = strlen(buf);
+        while(n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == '\r')) buf[--n] = '\0';
+        if(n == 0) continue;
+        send_line(buf);
+        THEKERNEL->call_event(ON_MAIN_LOOP);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+void Simulator::finish()
+{
+    THECONVEYOR->wait_for_idle();
+}
+
+void Simulator::reset_stats()
+{
+    blocks = 0;
+    lines = 0;
+    interrupts = 0;
+    pendsvs = 0;
+    last_block = nullptr;
+    wall_tick_us = 0;
+    ticks_at_reset = ticks;
+    wall_start_us = wall_us();
+}
+
+uint64_t Simulator::get_plan_us() const
+{
+    uint64_t total_us = wall_us() - wall_start_us;
+    return total_us > wall_tick_us ? total_us - wall_tick_us : 1;
+}
+
+void Simulator::print_stats(StreamOutput *stream)
+{
+    uint64_t plan_us = get_plan_us();
+    uint64_t tick_us = wall_tick_us > 0 ? wall_tick_us : 1;
+    uint64_t nticks = ticks - ticks_at_reset;
+    float f = THEKERNEL->step_ticker->get_frequency();
+
+    stream->printf("lines: %lu, blocks: %lu, ticks: %llu, simulated time: %1.4f s\n",
+                   (unsigned long)lines, (unsigned long)blocks, (unsigned long long)nticks, nticks / f);
+    stream->printf("parse+plan: %1.3f ms, %1.0f blocks/s\n", plan_us / 1000.0F, blocks * 1000000.0 / plan_us);
+    stream->printf("stepping: %1.3f ms, %1.0f ticks/s (%1.2fx realtime)\n", tick_us / 1000.0F, nticks * 1000000.0 / tick_us, (nticks * 1000000.0 / tick_us) / f);
+    stream->printf("step interrupts: %llu (%1.1f%% of ticks)\n", (unsigned long long)interrupts, nticks > 0 ? interrupts * 100.0F / nticks : 0.0F);
+    stream->printf("PendSV: %llu\n", (unsigned long long)pendsvs);
+    for (size_t m = 0; m < last_steps.size(); ++m) {
+        stream->printf("motor %u: %ld steps\n", (unsigned)m, (long)last_steps[m]);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+class StreamOutput;
+
+/*
+ * Host side stand-in for the step timers.
+ *
+ * Time only advances when the firmware would be waiting for the timers (ON_IDLE),
+ * each advance runs the real TIMER0/TIMER1 handlers a fixed number of times so a
+ * run is fully deterministic. Every step issued is optionally written to a
+ * timeline file as "tick,motor,position".
+ */
+class Simulator {
+    public:
+        Simulator();
+        ~Simulator();
+
+        static Simulator *instance;
+
+        // create a fresh kernel with the motion modules, config is either a config file name
+        // or config text that is appended to default_config, later settings override earlier ones
+        void boot(const char *config, bool from_file= false);
+
+        // step and dir pins for XYZ so the motors exist, everything else is the firmware default
+        static const char *default_config;
+
+        bool open_timeline(const char *fn);
+        void close_timeline();
+        // also collect the tick of every step of the given motor in memory, nullptr stops collecting
+        void log_steps(int motor, std::vector<uint64_t> *log) { step_log_motor = motor; step_log = log; }
+
+        // run one step ticker period
+        void tick();
+        // run n step ticker periods
+        void advance(uint32_t n);
+        // convert a delay to ticks and run them
+        void advance_us(uint32_t us);
+
+        // feed one line to the gcode dispatcher, returns the gcode output in reply
+        void send_line(const char *line, std::string *reply= nullptr);
+        // send every line of a file, returns false if it could not be opened
+        bool run_file(const char *fn);
+        // wait for the queue to empty and all motors to stop
+        void finish();
+
+        void reset_stats();
+        void print_stats(StreamOutput *stream);
+
+        uint64_t get_ticks() const { return ticks; }
+        uint32_t get_us() const;
+        uint32_t get_blocks() const { return blocks; }
+        // step interrupts run since reset_stats()
+        uint64_t get_interrupts() const { return interrupts; }
+        // PendSV interrupts run since reset_stats(), the segment preparation in segment mode
+        uint64_t get_pendsvs() const { return pendsvs; }
+        // wall clock time spent outside the step ticker since reset_stats()
+        uint64_t get_plan_us() const;
+        int32_t get_steps(int motor) const { return motor < (int)last_steps.size() ? last_steps[motor] : 0; }
+
+        // number of ticks run on each ON_IDLE, ie how long the main loop takes
+        uint32_t ticks_per_idle;
+        // if set the replies to lines sent are printed here
+        StreamOutput *echo;
+
+    private:
+        void sample_motors();
+
+        std::string config_text;
+        FILE *timeline;
+        std::vector<uint64_t> *step_log;
+        int step_log_motor;
+        uint64_t ticks;
+        uint32_t tim0_count;
+        uint32_t ms_count;
+        uint32_t ticks_per_ms;
+        uint32_t blocks;
+        uint64_t interrupts;
+        uint64_t pendsvs;
+        const void *last_block;
+        std::vector<int32_t> last_steps;
+
+        // wall clock accounting, ticking is timed separately from everything else (parsing and planning)
+        uint64_t wall_start_us;
+        uint64_t wall_tick_us;
+        uint64_t ticks_at_reset;
+        uint32_t lines;
+};
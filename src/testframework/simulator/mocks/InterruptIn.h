@@ -0,0 +1,16 @@
+#pragma once
+#include "PinNames.h"
+
+namespace mbed {
+
+// pin interrupts never fire in the simulator
+class InterruptIn {
+public:
+    InterruptIn(PinName pin) {}
+    template<typename T> void rise(T*, void (T::*)(void)) {}
+    template<typename T> void fall(T*, void (T::*)(void)) {}
+    void rise(void (*)(void)) {}
+    void fall(void (*)(void)) {}
+};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+typedef enum {
+    PortName_0 = 0, Port0 = 0,
+    Port1 = 1,
+    Port2 = 2,
+    Port3 = 3,
+    Port4 = 4
+} PortName;
+
+#define LPC_PIN(port, pin) ((port) << 5 | (pin))
+
+typedef enum {
+    P0_0 = LPC_PIN(0, 0), P0_9 = LPC_PIN(0, 9), P0_8 = LPC_PIN(0, 8), P0_7 = LPC_PIN(0, 7), P0_6 = LPC_PIN(0, 6),
+    P1_18 = LPC_PIN(1, 18), P1_19 = LPC_PIN(1, 19), P1_20 = LPC_PIN(1, 20), P1_21 = LPC_PIN(1, 21),
+    P1_23 = LPC_PIN(1, 23), P1_24 = LPC_PIN(1, 24), P1_26 = LPC_PIN(1, 26),
+    P2_0 = LPC_PIN(2, 0), P2_1 = LPC_PIN(2, 1), P2_2 = LPC_PIN(2, 2), P2_3 = LPC_PIN(2, 3),
+    P2_4 = LPC_PIN(2, 4), P2_5 = LPC_PIN(2, 5),
+    P3_25 = LPC_PIN(3, 25), P3_26 = LPC_PIN(3, 26),
+    P4_28 = LPC_PIN(4, 28),
+    USBTX = LPC_PIN(0, 2), USBRX = LPC_PIN(0, 3),
+    NC = (int)0xFFFFFFFF
+} PinName;
@@ -0,0 +1,20 @@
+#pragma once
+#include "PinNames.h"
+
+namespace mbed {
+
+// hardware PWM is not simulated, writes are remembered and ignored
+class PwmOut {
+public:
+    PwmOut(PinName pin) : value(0) {}
+    void write(float v) { value = v; }
+    float read() { return value; }
+    void period(float) {}
+    void period_us(int) {}
+    void pulsewidth_us(int) {}
+
+private:
+    float value;
+};
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// the slow timer is not simulated, the simulator calls tick() every simulated millisecond
+// and each hook is run every 1000/frequency ticks
+class SlowTicker {
+public:
+    template<typename T> void attach(uint32_t frequency, T *optr, uint32_t (T::*fptr)(uint32_t)) {
+        uint32_t interval = frequency >= 1000 ? 1 : 1000 / frequency;
+        hooks.push_back({interval, interval, [optr, fptr]() { (optr->*fptr)(0); }});
+    }
+
+    void tick() {
+        for(auto& h : hooks) {
+            if(--h.countdown == 0) {
+                h.countdown = h.interval;
+                h.fnc();
+            }
+        }
+    }
+
+private:
+    struct hook_t {
+        uint32_t interval;
+        uint32_t countdown;
+        std::function<void()> fnc;
+    };
+    std::vector<hook_t> hooks;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+extern "C" uint32_t us_ticker_read(void);
+
+namespace mbed {
+
+// simulated time Timer, reads the same clock as us_ticker_read()
+class Timer {
+public:
+    Timer() : running(false), start_us(0), elapsed_us(0) {}
+    void start() { if(!running) { start_us = us_ticker_read(); running = true; } }
+    void stop() { elapsed_us = read_us(); running = false; }
+    void reset() { start_us = us_ticker_read(); elapsed_us = 0; }
+    float read() { return read_us() / 1000000.0F; }
+    int read_ms() { return read_us() / 1000; }
+    int read_us() { return running ? elapsed_us + (us_ticker_read() - start_us) : elapsed_us; }
+    operator float() { return read(); }
+
+private:
+    bool running;
+    uint32_t start_us;
+    uint32_t elapsed_us;
+};
+
+}
+
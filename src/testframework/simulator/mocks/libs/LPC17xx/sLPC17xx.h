@@ -0,0 +1,2 @@
+// Host simulator: the smoothed LPC17xx header is the same as the mocked device header
+#include "LPC17xx.h"
@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+ * Host simulator replacement for the parts of mbed.h the motion code uses.
+ * Time is simulated: us_ticker_read() follows the simulated step ticker, and
+ * waiting advances the simulation instead of spinning.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LPC17xx.h"
+#include "system_LPC17xx.h"
+#include "PinNames.h"
+#include "wait_api.h"
+#include "Timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t us_ticker_read(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+// as mbed.h does
+using namespace std;
+using namespace mbed;
+#endif
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdio.h>
+
+// on the host a debug break aborts the simulation so the failure is visible
+static inline void __debugbreak(void) { fprintf(stderr, "__debugbreak() hit\n"); abort(); }
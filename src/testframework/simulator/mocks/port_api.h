@@ -0,0 +1,4 @@
+#pragma once
+#include "PinNames.h"
+
+static inline PinName port_pin(PortName port, int pin_n) { return (PinName)(((int)port << 5) | pin_n); }
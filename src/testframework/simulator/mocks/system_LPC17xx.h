@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// fixed at the LPC1769 core clock so timer periods match the board
+extern uint32_t SystemCoreClock;
+
+#ifdef __cplusplus
+}
+#endif
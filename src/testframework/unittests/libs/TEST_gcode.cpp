@@ -60,3 +60,57 @@ TEST(GCodeTest,subcode)
     ASSERT_EQUALS_DELTA_V(2.3, gc4.get_value('Y'), 0.001);
 
 }
+
+TEST(GCodeTest,words)
+{
+    Gcode gc1("G1 X-12.345 Y.5 Z+3 E1e2 F3000 S0", nullptr);
+    ASSERT_EQUALS_V(6, gc1.get_num_args());
+    ASSERT_EQUALS_DELTA_V(-12.345F, gc1.get_value('X'), 0.00001F);
+    ASSERT_EQUALS_DELTA_V(0.5F, gc1.get_value('Y'), 0.00001F);
+    ASSERT_EQUALS_DELTA_V(3.0F, gc1.get_value('Z'), 0.00001F);
+    ASSERT_EQUALS_DELTA_V(100.0F, gc1.get_value('E'), 0.00001F);
+    ASSERT_EQUALS_V(3000, gc1.get_int('F'));
+    ASSERT_TRUE(gc1.has_letter('S'));
+    ASSERT_TRUE(!gc1.has_letter('G'));
+    ASSERT_TRUE(!gc1.has_letter('A'));
+    ASSERT_EQUALS_DELTA_V(0.0F, gc1.get_value('A'), 0.00001F);
+
+    // a letter with no number is still there, the first one with a number is its value
+    Gcode gc2("G28 X Y2 X5", nullptr);
+    ASSERT_TRUE(gc2.has_letter('X'));
+    ASSERT_EQUALS_DELTA_V(5.0F, gc2.get_value('X'), 0.00001F);
+    ASSERT_EQUALS_DELTA_V(2.0F, gc2.get_value('Y'), 0.00001F);
+    ASSERT_EQUALS_V(3, gc2.get_num_args());
+
+    // not stripped the line number and checksum are there
+    Gcode gc3("N123 G1 X1*57", nullptr, false);
+    ASSERT_EQUALS_V(123, gc3.get_int('N'));
+    ASSERT_EQUALS_V(57, (int)gc3.get_value('*'));
+    ASSERT_TRUE(gc3.has_g);
+    ASSERT_EQUALS_V(1, gc3.g);
+    ASSERT_EQUALS_V(2, gc3.get_num_args());
+}
+
+TEST(GCodeTest,long_lines)
+{
+    // more than fits inline and more letters than the table holds
+    const char *line= "M92 A1 B2 C3 D4 E5 F6 H7 I8 J9 K10 L11 O12 P13 Q14 R15 U16 V17 W18 X19 Y20 Z21";
+    Gcode gc1(line, nullptr);
+    ASSERT_TRUE(gc1.has_m);
+    ASSERT_EQUALS_V(92, gc1.m);
+    ASSERT_EQUALS_V(21, gc1.get_num_args());
+    for (int i = 0; i < 21; ++i) {
+        const char *l= "ABCDEFHIJKLOPQRUVWXYZ";
+        ASSERT_TRUE(gc1.has_letter(l[i]));
+        ASSERT_EQUALS_V(i + 1, gc1.get_int(l[i]));
+    }
+    ASSERT_TRUE(!gc1.has_letter('G'));
+    ASSERT_TRUE(strcmp(gc1.get_command(), line + 3) == 0);
+
+    Gcode gc2(gc1);
+    ASSERT_EQUALS_DELTA_V(21.0F, gc2.get_value('Z'), 0.00001F);
+    ASSERT_TRUE(strcmp(gc2.get_command(), line + 3) == 0);
+    gc2= Gcode("M23 file.g", nullptr);
+    ASSERT_TRUE(strcmp(gc2.get_command(), " file.g") == 0);
+    ASSERT_EQUALS_V(23, gc2.m);
+}
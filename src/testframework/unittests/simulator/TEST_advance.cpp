@@ -0,0 +1,106 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+
+#include <vector>
+#include <algorithm>
+
+#include "easyunit/test.h"
+
+// the fourth actuator is made an extruder, the Extruder module is not part of the simulator
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "delta_step_pin 2.3\n"
+    "delta_dir_pin 0.22\n"
+    "delta_en_pin 0.21\n"
+    "delta_steps_per_mm 100\n";
+
+// X and E positions every idle call through the move, and the one after it if there is one
+static void run_move(const char *move, float k, std::vector<int32_t> &x, std::vector<int32_t> &e, const char *then= nullptr)
+{
+    Simulator::instance->boot(config);
+    StepperMotor *extruder= THEROBOT->actuators[3];
+    extruder->set_extruder(true);
+    extruder->set_selected(true);
+    extruder->set_pressure_advance(k);
+
+    Simulator::instance->send_line(move);
+    if(then != nullptr) Simulator::instance->send_line(then);
+    THECONVEYOR->force_queue();
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        x.push_back(THEROBOT->actuators[0]->get_current_step());
+        e.push_back(extruder->get_current_step());
+    }
+}
+
+TEST(Advance,leads_and_returns)
+{
+    // 5mm/s of E at 100 steps/mm, with K 0.05 the extruder is 25 steps ahead while cruising
+    std::vector<int32_t> x0, e0, xk, ek;
+    run_move("G1 X20 E2 F3000", 0, x0, e0);
+    run_move("G1 X20 E2 F3000", 0.05F, xk, ek);
+
+    ASSERT_EQUALS_V(200, e0.back());
+    ASSERT_EQUALS_V(200, ek.back());
+    ASSERT_EQUALS_V(1600, xk.back());
+    // the extruder runs to the planned end of the block, X can take its last step up to a millisecond before that
+    ASSERT_TRUE((int)xk.size() >= (int)x0.size() && (int)xk.size() - (int)x0.size() <= 10);
+
+    int lead= 0, lag= 0;
+    bool backwards= false;
+    for (size_t i = 0; i < std::min(e0.size(), ek.size()); ++i) {
+        // X is not touched
+        ASSERT_EQUALS_V(x0[i], xk[i]);
+        lead= std::max(lead, ek[i] - e0[i]);
+        lag= std::min(lag, ek[i] - e0[i]);
+        if(i > 0 && ek[i] < ek[i - 1]) backwards= true;
+    }
+    ASSERT_EQUALS_DELTA_V(25, lead, 2);
+    ASSERT_TRUE(lag >= -2);
+    // the deceleration of 100mm/s² times K is as fast as the extruder ever goes so it pulls back the whole time
+    ASSERT_TRUE(backwards);
+    // 12.5 steps from the end when it starts decelerating
+    ASSERT_EQUALS_DELTA_V(212, *std::max_element(ek.begin(), ek.end()), 2);
+
+    for (size_t i = 1; i < e0.size(); ++i) {
+        ASSERT_TRUE(e0[i] >= e0[i - 1]);
+    }
+}
+
+TEST(Advance,not_for_extruder_only_moves)
+{
+    std::vector<int32_t> x, e;
+    run_move("G1 E5 F600", 0.05F, x, e);
+    ASSERT_EQUALS_V(500, e.back());
+    for (size_t i = 1; i < e.size(); ++i) {
+        ASSERT_TRUE(e[i] >= e[i - 1]);
+    }
+}
+
+TEST(Advance,no_lead_left_over_a_travel_move)
+{
+    // the junction is at full speed, the extruder would be 25 steps ahead going into the travel move
+    std::vector<int32_t> x, e;
+    run_move("G1 X20 E2 F3000", 0.05F, x, e, "G1 X40");
+    ASSERT_EQUALS_V(3200, x.back());
+    ASSERT_EQUALS_V(200, e.back());
+    // all paid back by the end of the extruding move
+    for (size_t i = 0; i < x.size(); ++i) {
+        if(x[i] >= 1600) ASSERT_EQUALS_V(200, e[i]);
+    }
+
+    // and the other way it starts from no lead
+    std::vector<int32_t> x2, e2;
+    run_move("G1 X20 F3000", 0.05F, x2, e2, "G1 X40 E2");
+    ASSERT_EQUALS_V(3200, x2.back());
+    ASSERT_EQUALS_V(200, e2.back());
+    for (size_t i = 0; i < x2.size(); ++i) {
+        if(x2[i] <= 1600) ASSERT_EQUALS_V(0, e2[i]);
+    }
+}
@@ -0,0 +1,75 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+
+#include <math.h>
+#include <vector>
+
+#include "easyunit/test.h"
+
+// the fourth actuator is made an extruder, the Extruder module is not part of the simulator
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "mm_max_arc_error 0.01\n"
+    "delta_step_pin 2.3\n"
+    "delta_dir_pin 0.22\n"
+    "delta_en_pin 0.21\n"
+    "delta_steps_per_mm 100\n";
+
+// half a circle of the given radius from X0 to X2r, returns the number of blocks
+static int half_circle(float r)
+{
+    char buf[64];
+    Simulator::instance->boot(config);
+    snprintf(buf, sizeof(buf), "G2 X%1.3f Y0 I%1.3f J0 F3000", 2 * r, r);
+    Simulator::instance->send_line(buf);
+    Simulator::instance->finish();
+    return Simulator::instance->get_blocks();
+}
+
+TEST(Arc,segments_follow_chord_error)
+{
+    // 2*acos(1 - e/r) per segment
+    ASSERT_EQUALS_V(36, half_circle(10));
+    ASSERT_EQUALS_V(12, half_circle(1));
+    ASSERT_EQUALS_V(4, half_circle(0.1F));
+    ASSERT_EQUALS_V(3, half_circle(0.05F));
+}
+
+TEST(Arc,extrudes_along_the_arc)
+{
+    Simulator::instance->boot(config);
+    StepperMotor *extruder= THEROBOT->actuators[3];
+    extruder->set_extruder(true);
+    extruder->set_selected(true);
+
+    // a quarter circle about X0 Y0
+    Simulator::instance->send_line("G0 X10 Y0 F6000");
+    Simulator::instance->finish();
+    Simulator::instance->send_line("G3 X0 Y10 I-10 J0 E2 F3000");
+
+    std::vector<float> angle, e;
+    THECONVEYOR->force_queue();
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        float x= THEROBOT->actuators[0]->get_current_position();
+        float y= THEROBOT->actuators[1]->get_current_position();
+        angle.push_back(atan2f(y, x));
+        e.push_back(extruder->get_current_position());
+    }
+
+    ASSERT_EQUALS_DELTA_V(2.0F, e.back(), 0.001F);
+    float worst= 0;
+    for (size_t i = 1; i < e.size(); ++i) {
+        ASSERT_TRUE(e[i] >= e[i - 1]);
+        // 2mm of E over 90 degrees
+        worst= fmaxf(worst, fabsf(e[i] - angle[i] * 2 / (float)M_PI_2));
+    }
+    // off by a step of X or Y and a step of E at most
+    ASSERT_TRUE(worst < 0.05F);
+}
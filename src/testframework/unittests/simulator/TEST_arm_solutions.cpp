@@ -0,0 +1,62 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "BaseSolution.h"
+
+#include <math.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+static const char *solutions[]= { "cartesian", "linear_delta", "rotary_delta", "morgan", "hbot", "corexz", "rotatable_cartesian" };
+
+// the furthest line_to_actuators is from converting each point on its own
+static float line_difference(const char *solution, const float start[3], const float end[3])
+{
+    Simulator::instance->boot((std::string("arm_solution ") + solution + "\n").c_str());
+    const int n= 7;
+    ActuatorCoordinates batch[n];
+    THEROBOT->arm_solution->line_to_actuators(start, end, batch, n);
+
+    float worst= 0;
+    for (int i = 0; i < n; ++i) {
+        float t= (float)(i + 1) / n;
+        float p[3];
+        for (int j = 0; j < 3; ++j) p[j]= start[j] + (end[j] - start[j]) * t;
+        ActuatorCoordinates single;
+        THEROBOT->arm_solution->cartesian_to_actuator(p, single);
+        for (int j = 0; j < 3; ++j) worst= fmaxf(worst, fabsf(single[j] - batch[i][j]));
+    }
+    return worst;
+}
+
+TEST(ArmSolutions,line_matches_single_points)
+{
+    const float start[3]{-20, 10, 5}, end[3]{30, -15, 2};
+    for (const char *s : solutions) {
+        ASSERT_TRUE(line_difference(s, start, end) < 0.0005F);
+    }
+}
+
+TEST(ArmSolutions,segmented_delta_moves_end_in_place)
+{
+    const char *config=
+        "arm_solution linear_delta\n"
+        "delta_segments_per_second 100\n"
+        "alpha_steps_per_mm 100\n"
+        "beta_steps_per_mm 100\n"
+        "gamma_steps_per_mm 100\n";
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G1 X50 Y30 Z-10 F3000");
+    Simulator::instance->send_line("G1 X0 Y0 Z0");
+    Simulator::instance->finish();
+    ASSERT_TRUE(Simulator::instance->get_blocks() > 20);
+    // back where it started
+    const float origin[3]{0, 0, 0};
+    ActuatorCoordinates a;
+    THEROBOT->arm_solution->cartesian_to_actuator(origin, a);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQUALS_V((int)lroundf(a[i] * 100), Simulator::instance->get_steps(i));
+    }
+}
@@ -0,0 +1,120 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+#include "RealtimeCommands.h"
+#include "StreamOutput.h"
+
+#include <math.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+// 0.1mm is 8 steps
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "alpha_backlash 0.1\n";
+
+TEST(Backlash,taken_up_on_reversal)
+{
+    Simulator::instance->boot(config);
+    // the first move only finds out which way the slack is
+    Simulator::instance->send_line("G1 X10 Y10 F6000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+
+    // X reverses and gets a block of its own first, Y does not have any
+    Simulator::instance->reset_stats();
+    Simulator::instance->send_line("G1 X0 Y0");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(2, (int)Simulator::instance->get_blocks());
+    ASSERT_EQUALS_V(-8, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+
+    // the machine position does not include it
+    ASSERT_EQUALS_DELTA_V(0.0F, THEROBOT->get_axis_position(X_AXIS), 0.0001F);
+    std::string reply;
+    Simulator::instance->send_line("M114.2", &reply);
+    ASSERT_TRUE(reply.find("X:0.0000") != std::string::npos);
+
+    // carrying on the same way there is nothing more to take up
+    Simulator::instance->reset_stats();
+    Simulator::instance->send_line("G1 X-5");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(1, (int)Simulator::instance->get_blocks());
+    ASSERT_EQUALS_V(-408, Simulator::instance->get_steps(0));
+
+    // and back again
+    Simulator::instance->send_line("G1 X5");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(400, Simulator::instance->get_steps(0));
+}
+
+TEST(Backlash,smoothed_over_the_next_moves)
+{
+    Simulator::instance->boot((std::string(config) + "backlash_smoothing_mm 1\n").c_str());
+    Simulator::instance->send_line("G1 X10 F6000");
+    Simulator::instance->finish();
+
+    // 0.2mm after the reversal takes up a fifth of it
+    Simulator::instance->reset_stats();
+    Simulator::instance->send_line("G1 X9.8");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(1, (int)Simulator::instance->get_blocks());
+    ASSERT_EQUALS_V(782, Simulator::instance->get_steps(0));
+
+    // and the next move the rest
+    Simulator::instance->send_line("G1 X0");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(-8, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_DELTA_V(0.0F, THEROBOT->get_axis_position(X_AXIS), 0.0001F);
+}
+
+TEST(Backlash,set_with_m425)
+{
+    Simulator::instance->boot(config);
+    std::string reply;
+    Simulator::instance->send_line("M425 X0 Y0.05", &reply);
+    reply.clear();
+    Simulator::instance->send_line("M425", &reply);
+    ASSERT_TRUE(reply.find("X:0.0000 Y:0.0500") != std::string::npos);
+
+    Simulator::instance->send_line("G1 X10 Y10 F6000");
+    Simulator::instance->send_line("G1 X0 Y0");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(-4, Simulator::instance->get_steps(1));
+}
+
+TEST(Backlash,cancelled_jog_keeps_the_position)
+{
+    // both jogs are queued straight away
+    Simulator::instance->boot((std::string(config) + "enable_feed_hold true\njog_queue_time_ms 10000\n").c_str());
+    std::string error;
+    ASSERT_TRUE(THEROBOT->jog("G91 X200 F6000", &StreamOutput::NullStream, error));
+    ASSERT_TRUE(THEROBOT->jog("G91 X-10 F6000", &StreamOutput::NullStream, error));
+    THECONVEYOR->force_queue();
+    while(Simulator::instance->get_ticks() < 50000) THEKERNEL->call_event(ON_IDLE);
+
+    // the take up for the reversal is queued but not stepped
+    float mpos[3];
+    THEROBOT->get_current_machine_position(mpos);
+    ASSERT_EQUALS_DELTA_V(THEROBOT->actuators[X_AXIS]->get_current_position(), mpos[X_AXIS], 0.0001F);
+
+    // cancelled before the reversal, so there is still nothing taken up
+    THEKERNEL->realtime->receive(RealtimeCommands::JOG_CANCEL);
+    Simulator::instance->finish();
+    int32_t x= Simulator::instance->get_steps(0);
+    ASSERT_TRUE(x > 45 * 80 && x < 55 * 80);
+    ASSERT_EQUALS_DELTA_V(x / 80.0F, THEROBOT->get_axis_position(X_AXIS), 0.0001F);
+
+    // and the reversal is taken up when it does happen
+    ASSERT_TRUE(THEROBOT->jog("G91 X-10 F6000", &StreamOutput::NullStream, error));
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(x - 808, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_DELTA_V(((x - 808) / 80.0F + 0.1F), THEROBOT->get_axis_position(X_AXIS), 0.0001F);
+}
@@ -0,0 +1,204 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "Conveyor.h"
+#include "BinaryProtocol.h"
+#include "StreamOutput.h"
+#include "Module.h"
+#include "Gcode.h"
+
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+class ReplyStream : public StreamOutput {
+    public:
+        int puts(const char *s) { reply.append(s); return strlen(s); }
+        std::string reply;
+};
+
+typedef std::vector<uint8_t> bytes;
+
+// as a host would make them
+static bytes frame(uint8_t seq, uint8_t type, const bytes& payload)
+{
+    bytes f;
+    f.reserve(payload.size() + 6);
+    f.push_back(BinaryProtocol::sync);
+    f.push_back(payload.size());
+    f.push_back(seq);
+    f.push_back(type);
+    for (auto c : payload) f.push_back(c);
+    uint16_t crc= BinaryProtocol::crc16(f.data() + 1, f.size() - 1);
+    f.push_back(crc & 0xFF);
+    f.push_back(crc >> 8);
+    return f;
+}
+
+static void add_float(bytes& b, float v)
+{
+    uint8_t p[4];
+    memcpy(p, &v, 4);
+    b.insert(b.end(), p, p + 4);
+}
+
+static void add_varint(bytes& b, int32_t v)
+{
+    uint32_t u= ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    while(u >= 0x80) {
+        b.push_back((u & 0x7F) | 0x80);
+        u >>= 7;
+    }
+    b.push_back(u);
+}
+
+// through the receive interrupt, true if all of it was taken
+static bool send(BinaryProtocol& bp, const bytes& b)
+{
+    bool taken= true;
+    for (auto c : b) taken= bp.receive(c) && taken;
+    return taken;
+}
+
+TEST(Binary,moves_and_acks)
+{
+    Simulator::instance->boot(config);
+    ReplyStream out;
+    BinaryProtocol bp(&out);
+
+    // float32 X Y F, then 1mm steps back in X as microns
+    bytes m{BinaryProtocol::X | BinaryProtocol::Y | BinaryProtocol::F};
+    add_float(m, 10);
+    add_float(m, 5);
+    add_float(m, 6000);
+    ASSERT_TRUE(send(bp, frame(0, BinaryProtocol::MOVE, m)));
+    for (int i = 1; i <= 3; ++i) {
+        bytes d{BinaryProtocol::X | BinaryProtocol::DELTAS};
+        add_varint(d, -1000);
+        ASSERT_TRUE(send(bp, frame(i, BinaryProtocol::MOVE, d)));
+    }
+    // realtime commands are still seen between frames
+    ASSERT_TRUE(!bp.receive('?'));
+
+    ASSERT_TRUE(bp.process());
+    ASSERT_TRUE(out.reply == "ack 3\n");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(560, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(400, Simulator::instance->get_steps(1));
+
+    // a text line in a frame, then a rapid back in relative mode
+    out.reply.clear();
+    std::string g91("G91");
+    send(bp, frame(4, BinaryProtocol::LINE, bytes(g91.begin(), g91.end())));
+    bytes r{BinaryProtocol::X | BinaryProtocol::RAPID | BinaryProtocol::DELTAS};
+    add_varint(r, -7000 - 7000);
+    send(bp, frame(5, BinaryProtocol::MOVE, r));
+    send(bp, frame(6, BinaryProtocol::END, {}));
+    ASSERT_TRUE(!bp.process());
+    ASSERT_TRUE(out.reply.find("ack 6\n") != std::string::npos);
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(0));
+}
+
+TEST(Binary,bad_frames_are_sent_again)
+{
+    Simulator::instance->boot(config);
+    ReplyStream out;
+    BinaryProtocol bp(&out);
+
+    bytes m{BinaryProtocol::X | BinaryProtocol::F};
+    add_float(m, 1);
+    add_float(m, 6000);
+    bytes f0= frame(0, BinaryProtocol::MOVE, m);
+    m[1] ^= 0x40;
+    bytes f1= frame(1, BinaryProtocol::MOVE, m);
+    bytes bad= f1;
+    bad[6] ^= 0x01;
+
+    // the one with the bad CRC and the one after it get a single nak
+    send(bp, f0);
+    send(bp, bad);
+    send(bp, frame(2, BinaryProtocol::MOVE, m));
+    bp.process();
+    ASSERT_TRUE(out.reply == "ack 0\nnak 1 crc\n");
+
+    out.reply.clear();
+    send(bp, f1);
+    bp.process();
+    ASSERT_TRUE(out.reply == "ack 1\n");
+
+    // a missing one
+    out.reply.clear();
+    send(bp, frame(3, BinaryProtocol::MOVE, m));
+    bp.process();
+    ASSERT_TRUE(out.reply == "nak 2 seq\n");
+
+    // nothing moves while halted, a line still gets through to clear it
+    out.reply.clear();
+    THEKERNEL->call_event(ON_HALT, nullptr);
+    send(bp, frame(2, BinaryProtocol::MOVE, m));
+    bp.process();
+    ASSERT_TRUE(out.reply == "nak 2 halted\n");
+    std::string m999("M999");
+    send(bp, frame(2, BinaryProtocol::LINE, bytes(m999.begin(), m999.end())));
+    bp.process();
+    ASSERT_TRUE(!THEKERNEL->is_halted());
+    Simulator::instance->finish();
+}
+
+// keeps the arguments of the last G1 it saw, as a module reading them with get_args() would
+class ArgsHandler : public Module {
+    public:
+        void on_gcode_received(void *argument)
+        {
+            Gcode *gcode= static_cast<Gcode *>(argument);
+            args= gcode->get_args();
+            args_int= gcode->get_args_int();
+        }
+        std::map<char,float> args;
+        std::map<char,int> args_int;
+};
+
+TEST(Binary,moves_have_their_args)
+{
+    Simulator::instance->boot(config);
+    ReplyStream out;
+    BinaryProtocol bp(&out);
+    ArgsHandler h;
+    h.register_for_gcode('G', 1);
+
+    bytes m{BinaryProtocol::X | BinaryProtocol::Y | BinaryProtocol::F};
+    add_float(m, 10.5F);
+    add_float(m, -5);
+    add_float(m, 6000);
+    send(bp, frame(0, BinaryProtocol::MOVE, m));
+    bp.process();
+    ASSERT_TRUE(out.reply == "ack 0\n");
+
+    ASSERT_EQUALS_V(3, (int)h.args.size());
+    ASSERT_EQUALS_DELTA_V(10.5F, h.args['X'], 0.0001F);
+    ASSERT_EQUALS_DELTA_V(-5.0F, h.args['Y'], 0.0001F);
+    ASSERT_EQUALS_DELTA_V(6000.0F, h.args['F'], 0.0001F);
+    ASSERT_EQUALS_V(3, (int)h.args_int.size());
+    ASSERT_EQUALS_V(10, h.args_int['X']);
+    ASSERT_EQUALS_V(-5, h.args_int['Y']);
+    ASSERT_EQUALS_V(6000, h.args_int['F']);
+
+    // the same as the text line gives
+    Simulator::instance->send_line("G1 X10.5 Y-5 F6000");
+    ASSERT_EQUALS_V(3, (int)h.args.size());
+    ASSERT_EQUALS_DELTA_V(10.5F, h.args['X'], 0.0001F);
+    ASSERT_EQUALS_V(-5, h.args_int['Y']);
+
+    Simulator::instance->finish();
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &h);
+}
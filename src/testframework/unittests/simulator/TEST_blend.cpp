@@ -0,0 +1,96 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+// a staircase of 2mm steps, every corner is 90 degrees
+static std::vector<std::pair<float, float>> staircase()
+{
+    std::vector<std::pair<float, float>> path{{0, 0}};
+    for (int i = 0; i < 10; ++i) {
+        path.push_back({path.back().first + 2, path.back().second});
+        path.push_back({path.back().first, path.back().second + 2});
+    }
+    return path;
+}
+
+static float distance_to_path(const std::vector<std::pair<float, float>> &path, float x, float y)
+{
+    float best= 1e9F;
+    for (size_t i = 1; i < path.size(); ++i) {
+        float ax= path[i - 1].first, ay= path[i - 1].second;
+        float dx= path[i].first - ax, dy= path[i].second - ay;
+        float t= ((x - ax) * dx + (y - ay) * dy) / (dx * dx + dy * dy);
+        t= t < 0 ? 0 : t > 1 ? 1 : t;
+        best= fminf(best, hypotf(x - (ax + t * dx), y - (ay + t * dy)));
+    }
+    return best;
+}
+
+// runs the staircase after the given mode line, returns the ticks taken and the furthest the head got from the path
+static uint64_t run_staircase(const char *mode, float &deviation)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line(mode);
+
+    auto path= staircase();
+    char buf[64];
+    for (size_t i = 1; i < path.size(); ++i) {
+        snprintf(buf, sizeof(buf), "G1 X%1.3f Y%1.3f F6000", path[i].first, path[i].second);
+        Simulator::instance->send_line(buf);
+    }
+
+    // the last line is held until something else comes along
+    THEROBOT->flush_coalesced();
+    THECONVEYOR->force_queue();
+    deviation= 0;
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        float x= THEROBOT->actuators[0]->get_current_position();
+        float y= THEROBOT->actuators[1]->get_current_position();
+        deviation= fmaxf(deviation, distance_to_path(path, x, y));
+    }
+    return Simulator::instance->get_ticks();
+}
+
+TEST(Blend,faster_within_tolerance)
+{
+    float exact_deviation, blend_deviation;
+    uint64_t exact= run_staircase("G61", exact_deviation);
+    uint64_t blended= run_staircase("G64 P0.2", blend_deviation);
+
+    // both end up at the end of the path
+    ASSERT_EQUALS_V(1600, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(1600, Simulator::instance->get_steps(1));
+
+    // one step is 0.0125mm
+    ASSERT_TRUE(exact_deviation < 0.02F);
+    ASSERT_TRUE(blend_deviation > 0.1F);
+    ASSERT_TRUE(blend_deviation < 0.2F + 0.02F);
+    ASSERT_TRUE(blended * 10 < exact * 8);
+}
+
+TEST(Blend,g61_turns_it_off)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G64 P0.2");
+    Simulator::instance->send_line("G1 X2 F6000");
+    Simulator::instance->send_line("G61");
+    Simulator::instance->send_line("G1 X2 Y2");
+    Simulator::instance->finish();
+    // nothing was inserted at the corner
+    ASSERT_EQUALS_V(2, (int)Simulator::instance->get_blocks());
+}
@@ -0,0 +1,96 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "easyunit/test.h"
+
+static const char *coalesce_config=
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "coalesce_deviation 0.01\n";
+
+// 0.05mm lines along X, every other point 0.002mm off the line, then the same along Y
+static void send_segments()
+{
+    char buf[64];
+    for (int i = 1; i <= 400; ++i) {
+        snprintf(buf, sizeof(buf), "G1 X%1.3f Y%1.3f F3000", i * 0.05F, (i % 2) * 0.002F);
+        Simulator::instance->send_line(buf);
+    }
+    for (int i = 1; i <= 400; ++i) {
+        snprintf(buf, sizeof(buf), "G1 X20 Y%1.3f", i * 0.05F);
+        Simulator::instance->send_line(buf);
+    }
+}
+
+TEST(Coalesce,merges_short_lines)
+{
+    Simulator::instance->boot("alpha_steps_per_mm 80\nbeta_steps_per_mm 80\n");
+    send_segments();
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(800, (int)Simulator::instance->get_blocks());
+    uint64_t ticks= Simulator::instance->get_ticks();
+
+    Simulator::instance->boot(coalesce_config);
+    send_segments();
+    Simulator::instance->finish();
+
+    // 17 lines per block, the corner is not merged
+    ASSERT_TRUE(Simulator::instance->get_blocks() <= 800 / 17 + 2);
+    ASSERT_EQUALS_V(1600, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(1600, Simulator::instance->get_steps(1));
+    // a queue of 32 0.05mm blocks only looks 1.6mm ahead, too short to reach the feed rate
+    ASSERT_TRUE(Simulator::instance->get_ticks() < ticks * 3 / 4);
+}
+
+TEST(Coalesce,keeps_corners_and_order)
+{
+    Simulator::instance->boot(coalesce_config);
+
+    // a 10 degree turn is more than the default 5
+    Simulator::instance->send_line("G1 X1 Y0 F3000");
+    Simulator::instance->send_line("G1 X1.985 Y0.174");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(2, (int)Simulator::instance->get_blocks());
+
+    // a different feed rate is a new block, and M114 sees the position of the held line
+    Simulator::instance->boot(coalesce_config);
+    Simulator::instance->send_line("G1 X0.1 F3000");
+    Simulator::instance->send_line("G1 X0.2 F3000");
+    Simulator::instance->send_line("G1 X0.3 F1000");
+    std::string reply;
+    Simulator::instance->send_line("M114", &reply);
+    ASSERT_TRUE(reply.find("X:0.3000") != std::string::npos);
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(2, (int)Simulator::instance->get_blocks());
+    ASSERT_EQUALS_V(24, Simulator::instance->get_steps(0));
+}
+
+TEST(Coalesce,held_line_does_not_stop_the_moves)
+{
+    // the long line is queued straight away and the short one after it is held, nothing else comes for a while
+    Simulator::instance->boot(coalesce_config);
+    std::vector<uint64_t> log;
+    Simulator::instance->log_steps(0, &log);
+    Simulator::instance->send_line("G1 X10 F3000");
+    Simulator::instance->send_line("G1 X10.05");
+    for (int i = 0; i < 100000 && log.size() < 804; ++i) THEKERNEL->call_event(ON_IDLE);
+    Simulator::instance->finish();
+    Simulator::instance->log_steps(0, nullptr);
+    ASSERT_EQUALS_V(804, (int)log.size());
+
+    // it is queued while it can still be planned with the long line, which slows into it without stopping, a stop at
+    // the end of the long line spaces its last steps out to over 1000 ticks
+    uint64_t worst= 0;
+    for (size_t i = 790; i < log.size(); ++i) {
+        worst= std::max(worst, log[i] - log[i - 1]);
+    }
+    ASSERT_TRUE(worst < 600);
+}
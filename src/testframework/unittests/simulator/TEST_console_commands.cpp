@@ -0,0 +1,67 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Module.h"
+#include "Robot.h"
+#include "StreamOutput.h"
+
+#include <string>
+
+#include "easyunit/test.h"
+
+// remembers what each of them got
+static std::string calls;
+
+class Commands : public Module {
+    public:
+        Commands(char n) : name(n) {}
+        void hello(std::string parameters, StreamOutput *) { calls += name; calls += "hello(" + parameters + ")"; }
+        void help(std::string parameters, StreamOutput *) { calls += name; calls += "help(" + parameters + ")"; }
+        void on_console_line_received(void *) { calls += name; calls += "line"; }
+        char name;
+};
+
+static void bye(std::string parameters, StreamOutput *)
+{
+    calls += "bye(" + parameters + ")";
+}
+
+static void send(const char *line)
+{
+    calls.clear();
+    Simulator::instance->send_line(line);
+}
+
+TEST(ConsoleCommands,only_the_handlers_for_the_command)
+{
+    Simulator::instance->boot("alpha_steps_per_mm 80\n");
+    Commands a('a'), b('b'), c('c');
+    a.register_for_command("hello", &Commands::hello);
+    a.register_for_command("hel", &Commands::help);
+    b.register_for_command("hello", &Commands::hello);
+    THEKERNEL->register_for_command("bye", bye);
+    c.register_for_event(ON_CONSOLE_LINE_RECEIVED);
+
+    send("hello world and more");
+    ASSERT_TRUE(calls == "ahello(world and more)bhello(world and more)");
+    send("hel");
+    ASSERT_TRUE(calls == "ahelp()");
+    send("bye now");
+    ASSERT_TRUE(calls == "bye(now)");
+
+    // the rest still go to everyone that asked for them
+    send("hell");
+    ASSERT_TRUE(calls == "cline");
+    send("helloo");
+    ASSERT_TRUE(calls == "cline");
+    send("G1 X1 F6000");
+    ASSERT_TRUE(calls == "cline");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(80, Simulator::instance->get_steps(0));
+
+    THEKERNEL->unregister_for_event(ON_CONSOLE_LINE_RECEIVED, &a);
+    send("hello");
+    ASSERT_TRUE(calls == "bhello()");
+    THEKERNEL->unregister_for_event(ON_CONSOLE_LINE_RECEIVED, &b);
+    THEKERNEL->unregister_for_event(ON_CONSOLE_LINE_RECEIVED, &c);
+}
@@ -0,0 +1,74 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+
+#include <vector>
+
+#include "easyunit/test.h"
+
+static const char *fixed_config=
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+static const char *events_config=
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "step_events_enable true\n";
+
+// fast, slow, a long ramp that needs the 2.62 fixed point path and a 3 step Y move
+static const char *moves[]= {
+    "G1 X100 Y37 F6000",
+    "G1 X90 Y30 F300",
+    "M204 S100",
+    "G1 X0 Y30 F6000",
+    "G1 X20 Y30.04 F3000",
+};
+
+// tick of every step of the motor, counted from the first step
+static void run_moves(const char *config, int motor, std::vector<uint64_t> &log)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->log_steps(motor, &log);
+    for(auto m : moves) {
+        Simulator::instance->send_line(m);
+    }
+    Simulator::instance->finish();
+    Simulator::instance->log_steps(0, nullptr);
+
+    // the first block can start up to 1ms later when the step ticker is idling
+    for (size_t i = 1; i < log.size(); ++i) log[i] -= log[0];
+    if(!log.empty()) log[0]= 0;
+}
+
+TEST(Events,same_steps_as_fixed_ticks)
+{
+    for (int motor = 0; motor < 2; ++motor) {
+        std::vector<uint64_t> fixed, events;
+        run_moves(fixed_config, motor, fixed);
+        run_moves(events_config, motor, events);
+        ASSERT_TRUE(THEKERNEL->step_ticker->is_event_driven());
+
+        // skipping ticks moves the DDA exactly as ticking them does
+        ASSERT_EQUALS_V((int)fixed.size(), (int)events.size());
+        int different= 0;
+        for (size_t i = 0; i < fixed.size(); ++i) {
+            if(fixed[i] != events[i]) ++different;
+        }
+        ASSERT_EQUALS_V(0, different);
+    }
+}
+
+TEST(Events,fewer_interrupts)
+{
+    Simulator::instance->boot(events_config);
+    Simulator::instance->reset_stats();
+    Simulator::instance->send_line("G1 X10 F60");
+    Simulator::instance->finish();
+
+    // 800 steps over 10 seconds
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+    uint64_t ticks= Simulator::instance->get_ticks();
+    ASSERT_TRUE(ticks > 1000000);
+    ASSERT_TRUE(Simulator::instance->get_interrupts() < ticks / 20);
+}
@@ -0,0 +1,135 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "StepTicker.h"
+#include "Conveyor.h"
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+// runs the main loop until the given simulated time
+static void run_until(uint64_t tick)
+{
+    while(Simulator::instance->get_ticks() < tick && !THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+    }
+}
+
+static int32_t x_steps()
+{
+    return THEROBOT->actuators[0]->get_current_step();
+}
+
+// holds a 200mm move at 100mm/s half a second in, returns the seconds it took to stop and the largest change in speed
+// over 10ms while it did
+static void hold_move(const char *extra_config, float &stop_time, float &worst_decel)
+{
+    Simulator::instance->boot((std::string(config) + extra_config).c_str());
+    Simulator::instance->send_line("G1 X200 F6000");
+    THECONVEYOR->force_queue();
+    run_until(50000);
+
+    THEKERNEL->set_feed_hold(true);
+    uint64_t start= Simulator::instance->get_ticks();
+    float last_speed= 100;
+    worst_decel= 0;
+    while(!THEKERNEL->step_ticker->is_held() && Simulator::instance->get_ticks() < start + 100000) {
+        int32_t s= x_steps();
+        run_until(Simulator::instance->get_ticks() + 1000);
+        float speed= (x_steps() - s) / 80.0F / 0.01F;
+        worst_decel= fmaxf(worst_decel, last_speed - speed);
+        last_speed= speed;
+    }
+    stop_time= (Simulator::instance->get_ticks() - start) / 100000.0F;
+}
+
+TEST(FeedHold,stops_mid_move_and_resumes)
+{
+    const char *modes[]= { "", "step_segments_enable true\n", "step_events_enable true\n" };
+    for (const char *mode : modes) {
+        float stop_time, worst_decel;
+        hold_move(mode, stop_time, worst_decel);
+
+        // 100mm/s at 1000mm/s² stops in 0.1s, 10mm/s every 10ms plus a step either side
+        ASSERT_TRUE(THEKERNEL->step_ticker->is_held());
+        ASSERT_TRUE(stop_time < 0.12F);
+        ASSERT_TRUE(worst_decel < 10.0F + 2.5F);
+
+        // it stays where it stopped, about 5mm after the hold
+        int32_t held= x_steps();
+        run_until(Simulator::instance->get_ticks() + 100000);
+        ASSERT_EQUALS_V(held, x_steps());
+        ASSERT_TRUE(held > 45 * 80 && held < 55 * 80);
+        ASSERT_TRUE(!THECONVEYOR->is_idle());
+
+        // and finishes the move when released
+        THEKERNEL->set_feed_hold(false);
+        Simulator::instance->finish();
+        ASSERT_EQUALS_V(16000, Simulator::instance->get_steps(0));
+    }
+}
+
+TEST(FeedHold,resumes_at_the_acceleration)
+{
+    float stop_time, worst_decel;
+    hold_move("", stop_time, worst_decel);
+
+    THEKERNEL->set_feed_hold(false);
+    run_until(Simulator::instance->get_ticks() + 5000);
+    int32_t s= x_steps();
+    run_until(Simulator::instance->get_ticks() + 1000);
+    // 50ms in it is doing about half speed
+    ASSERT_EQUALS_DELTA_V(50.0F, (x_steps() - s) / 80.0F / 0.01F, 6.0F);
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(16000, Simulator::instance->get_steps(0));
+}
+
+// a hold just before a 10mm/s move runs into a 200mm/s one carries on into the fast move as it stops, the timer is
+// slowed for both so it has to slow down for the fast one
+TEST(FeedHold,slow_into_fast_move_stays_within_the_acceleration)
+{
+    const char *modes[]= { "", "step_segments_enable true\n", "step_events_enable true\n" };
+    for (const char *mode : modes) {
+        Simulator::instance->boot((std::string("acceleration 1000\nalpha_steps_per_mm 400\nbeta_steps_per_mm 400\n") + mode).c_str());
+        Simulator::instance->send_line("G1 X10 F600");
+        Simulator::instance->send_line("G1 X100 F12000");
+        THECONVEYOR->force_queue();
+        while(x_steps() < 9.97F * 400) THEKERNEL->call_event(ON_IDLE);
+
+        std::vector<uint64_t> log;
+        Simulator::instance->log_steps(0, &log);
+        THEKERNEL->set_feed_hold(true);
+        uint64_t start= Simulator::instance->get_ticks();
+        while(!THEKERNEL->step_ticker->is_held() && Simulator::instance->get_ticks() < start + 100000) {
+            THEKERNEL->call_event(ON_IDLE);
+        }
+        Simulator::instance->log_steps(0, nullptr);
+        ASSERT_TRUE(THEKERNEL->step_ticker->is_held());
+        ASSERT_TRUE(x_steps() > 10 * 400);
+
+        // speed over every 16 steps, the change between them at most the acceleration
+        float worst_decel= 0, last_speed= 0, last_time= 0;
+        for (size_t i = 0; i + 16 < log.size(); i += 16) {
+            float speed= 16 / 400.0F / ((log[i + 16] - log[i]) / 100000.0F);
+            float time= (log[i + 16] + log[i]) / 2 / 100000.0F;
+            if(i > 0) worst_decel= fmaxf(worst_decel, (last_speed - speed) / (time - last_time));
+            last_speed= speed;
+            last_time= time;
+        }
+        ASSERT_TRUE(worst_decel < 1100);
+
+        THEKERNEL->set_feed_hold(false);
+        Simulator::instance->finish();
+        ASSERT_EQUALS_V(40000, Simulator::instance->get_steps(0));
+    }
+}
@@ -0,0 +1,122 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "StepTicker.h"
+#include "Conveyor.h"
+
+#include <math.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+// runs the main loop until the given simulated time
+static void run_until(uint64_t tick)
+{
+    while(Simulator::instance->get_ticks() < tick && !THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+    }
+}
+
+// X speed in mm/s over the next 10ms
+static float x_speed()
+{
+    int32_t s= THEROBOT->actuators[0]->get_current_step();
+    uint64_t t= Simulator::instance->get_ticks();
+    run_until(t + 1000);
+    return (THEROBOT->actuators[0]->get_current_step() - s) / 80.0F / ((Simulator::instance->get_ticks() - t) / 100000.0F);
+}
+
+// a 200mm move at 100mm/s, slowed to 50% half a second in and back to 100% half a second later
+static void override_move(const char *extra_config, float &before, float &slowed, float &after)
+{
+    Simulator::instance->boot((std::string(config) + extra_config).c_str());
+    Simulator::instance->send_line("G1 X200 F6000");
+    THECONVEYOR->force_queue();
+
+    run_until(50000);
+    before= x_speed();
+    Simulator::instance->send_line("M220 S50");
+    // the ramp takes 0.1s for half the range
+    run_until(Simulator::instance->get_ticks() + 11000);
+    slowed= x_speed();
+    Simulator::instance->send_line("M220 S100");
+    run_until(Simulator::instance->get_ticks() + 11000);
+    after= x_speed();
+    Simulator::instance->finish();
+}
+
+TEST(FeedOverride,slows_the_running_move)
+{
+    float before, slowed, after;
+    override_move("", before, slowed, after);
+    ASSERT_EQUALS_DELTA_V(100.0F, before, 1.0F);
+    ASSERT_EQUALS_DELTA_V(50.0F, slowed, 1.0F);
+    ASSERT_EQUALS_DELTA_V(100.0F, after, 1.0F);
+    ASSERT_EQUALS_V(16000, Simulator::instance->get_steps(0));
+
+    // the same in segment mode
+    override_move("step_segments_enable true\n", before, slowed, after);
+    ASSERT_EQUALS_DELTA_V(100.0F, before, 1.0F);
+    ASSERT_EQUALS_DELTA_V(50.0F, slowed, 1.0F);
+    ASSERT_EQUALS_DELTA_V(100.0F, after, 1.0F);
+    ASSERT_EQUALS_V(16000, Simulator::instance->get_steps(0));
+}
+
+TEST(FeedOverride,ramps)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G1 X200 F6000");
+    THECONVEYOR->force_queue();
+    run_until(50000);
+
+    // 10ms in it has only gone down by 5%
+    Simulator::instance->send_line("M220 S10");
+    run_until(Simulator::instance->get_ticks() + 1000);
+    ASSERT_EQUALS_DELTA_V(0.95F, THEKERNEL->step_ticker->get_speed_factor(), 0.01F);
+    run_until(Simulator::instance->get_ticks() + 20000);
+    ASSERT_EQUALS_DELTA_V(0.1F, THEKERNEL->step_ticker->get_speed_factor(), 0.001F);
+    Simulator::instance->send_line("M220 S100");
+    Simulator::instance->finish();
+}
+
+TEST(FeedOverride,ramps_within_the_acceleration)
+{
+    Simulator::instance->boot("acceleration 100\nalpha_steps_per_mm 80\nbeta_steps_per_mm 80\n");
+    Simulator::instance->send_line("G1 X300 F6000");
+    THECONVEYOR->force_queue();
+    run_until(150000);
+
+    // at 100mm/s and 100mm/s² the factor can only go down by 1 a second, slower than the 0.2s ramp time lets it
+    Simulator::instance->send_line("M220 S10");
+    run_until(Simulator::instance->get_ticks() + 1000);
+    ASSERT_EQUALS_DELTA_V(0.99F, THEKERNEL->step_ticker->get_speed_factor(), 0.002F);
+    run_until(Simulator::instance->get_ticks() + 9000);
+    ASSERT_EQUALS_DELTA_V(0.9F, THEKERNEL->step_ticker->get_speed_factor(), 0.005F);
+    Simulator::instance->send_line("M220 S100");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(24000, Simulator::instance->get_steps(0));
+}
+
+TEST(FeedOverride,over_100_is_planned)
+{
+    Simulator::instance->boot(config);
+    std::string reply;
+    Simulator::instance->send_line("M220 S150");
+    Simulator::instance->send_line("M220", &reply);
+    ASSERT_TRUE(reply.find("150.00") != std::string::npos);
+    ASSERT_EQUALS_DELTA_V(1.0F, THEKERNEL->step_ticker->get_speed_factor(), 0.0001F);
+
+    Simulator::instance->send_line("G1 X200 F6000");
+    THECONVEYOR->force_queue();
+    run_until(50000);
+    ASSERT_EQUALS_DELTA_V(150.0F, x_speed(), 1.5F);
+    Simulator::instance->send_line("M220 S100");
+    Simulator::instance->finish();
+}
@@ -0,0 +1,99 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+#include "Block.h"
+#include "Conveyor.h"
+
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#include "easyunit/test.h"
+
+static const char *fp32_config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "gamma_steps_per_mm 400\n"
+    "stepticker_fp32_enable true\n";
+
+static const char *fp64_config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "gamma_steps_per_mm 400\n"
+    "stepticker_fp32_enable false\n";
+
+// diagonal, slow, short and a move where Y only makes a few steps
+static const char *moves[]= {
+    "G1 X100 Y37 F6000",
+    "G1 X3 Y2 F1000",
+    "G1 X50 Y2.5 Z1 F12000",
+    "G1 X0 Y0 Z0 F3000",
+};
+
+static uint64_t run_moves(const char *config, int motor, std::vector<uint64_t> &log)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->log_steps(motor, &log);
+    for(auto m : moves) {
+        Simulator::instance->send_line(m);
+    }
+    Simulator::instance->finish();
+    Simulator::instance->log_steps(0, nullptr);
+    return Simulator::instance->get_ticks();
+}
+
+// true if the block the step ticker started on is using the 32 bit path
+static bool first_block_fp32(const char *config, const char *move)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line(move);
+    THEKERNEL->conveyor->force_queue();
+    while(THEKERNEL->step_ticker->get_current_block() == nullptr) THEKERNEL->call_event(ON_IDLE);
+    bool fp32= THEKERNEL->step_ticker->get_current_block()->fp32;
+    Simulator::instance->finish();
+    return fp32;
+}
+
+TEST(FixedPoint,fp32_used_when_it_fits)
+{
+    ASSERT_TRUE(first_block_fp32(fp32_config, "G1 X100 F6000"));
+    ASSERT_TRUE(!first_block_fp32(fp64_config, "G1 X100 F6000"));
+    // off unless the config turns it on
+    ASSERT_TRUE(!first_block_fp32("", "G1 X100 F6000"));
+
+    // accelerating for a second is too long for 1.31 to stay within 0.1 step
+    ASSERT_TRUE(!first_block_fp32("acceleration 100\nstepticker_fp32_enable true\n", "G1 X100 F6000"));
+}
+
+TEST(FixedPoint,queued_blocks_keep_half_the_tick_info)
+{
+    // the queue holds 32 bit values for each motor, the step ticker only expands the block it is stepping
+    ASSERT_TRUE(sizeof(Block::tickplan_t) * 2 <= sizeof(StepTicker::tickinfo_t));
+}
+
+TEST(FixedPoint,same_steps_and_timing_as_fp64)
+{
+    for (int motor = 0; motor < 3; ++motor) {
+        std::vector<uint64_t> log32, log64;
+        uint64_t ticks32= run_moves(fp32_config, motor, log32);
+        uint64_t ticks64= run_moves(fp64_config, motor, log64);
+
+        ASSERT_EQUALS_DELTA_V((float)ticks64, (float)ticks32, ticks64 * 0.0001F);
+        ASSERT_EQUALS_V((int)log64.size(), (int)log32.size());
+
+        // the steps land within a few ticks of the 64 bit ones, this includes the drift from earlier blocks
+        // ending a tick or two apart, and the very slow last steps of a block where a tiny difference
+        // in rate moves the step a long way
+        uint64_t total= 0, worst= 0;
+        for (size_t i = 0; i < log32.size(); ++i) {
+            uint64_t d= log32[i] > log64[i] ? log32[i] - log64[i] : log64[i] - log32[i];
+            total += d;
+            if(d > worst) worst= d;
+        }
+        ASSERT_TRUE(total <= 10 * log32.size());
+        ASSERT_TRUE(worst <= 100);
+    }
+}
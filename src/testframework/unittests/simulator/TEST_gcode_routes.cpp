@@ -0,0 +1,90 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Module.h"
+#include "Gcode.h"
+#include "StreamOutput.h"
+
+#include <string>
+
+#include "easyunit/test.h"
+
+// remembers which of them got the gcode, in order
+static std::string calls;
+
+class Handler : public Module {
+    public:
+        Handler(char n) : name(n) {}
+        void on_gcode_received(void *) { calls += name; }
+        char name;
+};
+
+static void send(const char *line)
+{
+    calls.clear();
+    Simulator::instance->send_line(line);
+}
+
+TEST(GcodeRoutes,only_the_modules_for_the_code)
+{
+    Simulator::instance->boot("");
+    Handler a('a'), b('b'), c('c');
+    a.register_for_gcode('M', 104);
+    b.register_for_gcode('G', 29, 32);
+    c.register_for_gcode('M', 29);
+    ASSERT_TRUE(THEKERNEL->kernel_has_event(ON_GCODE_RECEIVED, &b));
+
+    send("M104 S200");
+    ASSERT_TRUE(calls == "a");
+    send("G30");
+    ASSERT_TRUE(calls == "b");
+    send("G33");
+    ASSERT_TRUE(calls == "");
+    // M29 is not G29
+    send("M29");
+    ASSERT_TRUE(calls == "c");
+    send("G1 X1");
+    ASSERT_TRUE(calls == "");
+
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &b);
+    send("G30");
+    ASSERT_TRUE(calls == "");
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &a);
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &c);
+}
+
+TEST(GcodeRoutes,in_the_order_they_registered)
+{
+    Simulator::instance->boot("");
+    Handler a('a'), b('b'), c('c'), d('d');
+    a.register_for_gcode('M', 104);
+    b.register_for_event(ON_GCODE_RECEIVED);
+    c.register_for_gcode('G', 1);
+    c.register_for_gcode('M', 104);
+    d.register_for_event(ON_GCODE_RECEIVED);
+    // a module that sees everything only gets it once
+    d.register_for_gcode('M', 104);
+
+    send("M104 S200");
+    ASSERT_TRUE(calls == "abcd");
+    // the dispatcher splits a line like this up, one that has both still goes to each module once
+    Gcode gc("G1 X1 M104", &StreamOutput::NullStream);
+    calls.clear();
+    THEKERNEL->call_event(ON_GCODE_RECEIVED, &gc);
+    ASSERT_TRUE(calls == "abcd");
+    send("G0 X1");
+    ASSERT_TRUE(calls == "bd");
+
+    // the ones after it keep their place
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &b);
+    send("M104 S200");
+    ASSERT_TRUE(calls == "acd");
+    b.register_for_gcode('M', 104);
+    send("M104 S200");
+    ASSERT_TRUE(calls == "acdb");
+
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &a);
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &b);
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &c);
+    THEKERNEL->unregister_for_event(ON_GCODE_RECEIVED, &d);
+}
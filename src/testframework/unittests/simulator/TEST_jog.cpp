@@ -0,0 +1,154 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Module.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "StepTicker.h"
+#include "Conveyor.h"
+#include "RealtimeCommands.h"
+#include "StreamOutput.h"
+
+#include <math.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+// the jog cancel is a realtime command, those are only looked for with enable_feed_hold or in grbl mode
+static const char *config=
+    "enable_feed_hold true\n"
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+static bool jog(const char *line, std::string &error)
+{
+    return THEROBOT->jog(line, &StreamOutput::NullStream, error);
+}
+
+// runs the main loop until the given simulated time
+static void run_until(uint64_t tick)
+{
+    while(Simulator::instance->get_ticks() < tick && !THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+    }
+}
+
+// sends the jog cancel from the main loop at the given time, as the receive interrupt would while the main loop is busy
+class CancelAt : public Module {
+    public:
+        CancelAt(uint64_t t) : tick(t) {}
+        void on_idle(void *) {
+            if(tick != 0 && Simulator::instance->get_ticks() >= tick) {
+                tick= 0;
+                THEKERNEL->realtime->receive(RealtimeCommands::JOG_CANCEL);
+            }
+        }
+        uint64_t tick;
+};
+
+TEST(Jog,does_not_change_modal_state)
+{
+    Simulator::instance->boot(config);
+    std::string error;
+    Simulator::instance->send_line("G90 G1 F3000");
+    ASSERT_TRUE(jog("G91 X10 F6000", error));
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+
+    // still absolute at the old feed rate
+    ASSERT_EQUALS_DELTA_V(3000.0F, THEROBOT->get_feed_rate(), 0.001F);
+    Simulator::instance->send_line("G1 X5");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(400, Simulator::instance->get_steps(0));
+
+    // inches and machine coordinates for this jog only
+    Simulator::instance->send_line("G10 L2 P1 X10");
+    ASSERT_TRUE(jog("G20 G53 X1 F100", error));
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(2032, Simulator::instance->get_steps(0));
+    ASSERT_TRUE(!THEROBOT->inch_mode);
+
+    ASSERT_TRUE(!jog("G91 X10", error));
+    ASSERT_TRUE(error == "Undefined feed rate");
+    ASSERT_TRUE(!jog("G2 X10 F100", error));
+    ASSERT_TRUE(error == "Invalid jog command");
+    ASSERT_TRUE(!jog("G91 F100", error));
+    ASSERT_TRUE(!jog("G91 X10 M3 F100", error));
+}
+
+TEST(Jog,cancel_stops_and_flushes)
+{
+    Simulator::instance->boot(config);
+    std::string error;
+    ASSERT_TRUE(jog("G91 X200 F6000", error));
+    // this one waits for the first to be nearly done, the cancel throws it away as well
+    CancelAt cancel(50000);
+    THEKERNEL->register_for_event(ON_IDLE, &cancel);
+    ASSERT_TRUE(jog("G91 Y200 F6000", error));
+    uint64_t start= Simulator::instance->get_ticks();
+    Simulator::instance->finish();
+    // stopped from 100mm/s at 1000mm/s² and nothing else ran
+    ASSERT_TRUE(start - 50000 < 12000);
+    ASSERT_TRUE(Simulator::instance->get_ticks() - start < 1000);
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+    int32_t x= Simulator::instance->get_steps(0);
+    ASSERT_TRUE(x > 45 * 80 && x < 55 * 80);
+    ASSERT_TRUE(!THEKERNEL->get_feed_hold());
+    ASSERT_TRUE(!THEKERNEL->realtime->is_jogging());
+
+    // the robot carries on from where it stopped
+    ASSERT_EQUALS_DELTA_V(x / 80.0F, THEROBOT->get_axis_position(X_AXIS), 0.0001F);
+    ASSERT_TRUE(jog("G91 X10 F6000", error));
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(x + 800, Simulator::instance->get_steps(0));
+
+    // outside a jog it does nothing
+    Simulator::instance->send_line("G1 X0 F6000");
+    THECONVEYOR->force_queue();
+    run_until(Simulator::instance->get_ticks() + 5000);
+    ASSERT_TRUE(THEKERNEL->realtime->receive(RealtimeCommands::JOG_CANCEL));
+    THEKERNEL->call_event(ON_IDLE);
+    ASSERT_TRUE(!THEKERNEL->get_feed_hold());
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(0));
+}
+
+TEST(Jog,cancel_while_queuing)
+{
+    // in both step modes as segment mode drops the prepared segments
+    const char *modes[]= { "", "step_segments_enable true\n" };
+    for (const char *mode : modes) {
+        // 1mm segments so the jog is still being queued when the cancel comes
+        Simulator::instance->boot((std::string(config) + "mm_per_line_segment 1\n" + mode).c_str());
+        CancelAt cancel(50000);
+        THEKERNEL->register_for_event(ON_IDLE, &cancel);
+
+        std::string error;
+        ASSERT_TRUE(jog("G91 X200 F6000", error));
+        ASSERT_EQUALS_V(0, (int)cancel.tick);
+        Simulator::instance->finish();
+
+        int32_t x= Simulator::instance->get_steps(0);
+        ASSERT_TRUE(x > 45 * 80 && x < 55 * 80);
+        ASSERT_EQUALS_DELTA_V(x / 80.0F, THEROBOT->get_axis_position(X_AXIS), 0.0001F);
+        ASSERT_TRUE(jog("G91 X-10 F6000", error));
+        Simulator::instance->finish();
+        ASSERT_EQUALS_V(x - 800, Simulator::instance->get_steps(0));
+    }
+}
+
+TEST(Jog,streamed_jogs_do_not_queue_up)
+{
+    // 2mm steps at 100mm/s, 50 a second
+    Simulator::instance->boot(config);
+    std::string error;
+    for (int i = 0; i < 50; ++i) {
+        ASSERT_TRUE(jog("G91 X2 F6000", error));
+    }
+    // no more than jog_queue_time_ms and the stop left
+    uint64_t start= Simulator::instance->get_ticks();
+    Simulator::instance->finish();
+    ASSERT_TRUE(Simulator::instance->get_ticks() - start < 25000);
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+}
@@ -0,0 +1,75 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+#include "BaseSolution.h"
+
+#include <math.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+static std::string delta_config(const char *segmentation)
+{
+    return std::string(
+        "arm_solution linear_delta\n"
+        "arm_length 250\n"
+        "arm_radius 124\n"
+        "acceleration 1000\n"
+        "alpha_steps_per_mm 100\n"
+        "beta_steps_per_mm 100\n"
+        "gamma_steps_per_mm 100\n") + segmentation;
+}
+
+// runs the move, returns the blocks it took and the furthest the head got from the straight line from 0,0,0 to x,y,z
+static int run_move(const std::string &config, float x, float y, float z, float &deviation)
+{
+    char buf[64];
+    Simulator::instance->boot(config.c_str());
+    snprintf(buf, sizeof(buf), "G1 X%1.3f Y%1.3f Z%1.3f F6000", x, y, z);
+    Simulator::instance->send_line(buf);
+
+    float len= sqrtf(x * x + y * y + z * z);
+    deviation= 0;
+    THECONVEYOR->force_queue();
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        ActuatorCoordinates a;
+        for (int i = 0; i < 3; ++i) a[i]= THEROBOT->actuators[i]->get_current_position();
+        float p[3];
+        THEROBOT->arm_solution->actuator_to_cartesian(a, p);
+        float t= (p[0] * x + p[1] * y + p[2] * z) / (len * len);
+        deviation= fmaxf(deviation, sqrtf(powf(p[0] - t * x, 2) + powf(p[1] - t * y, 2) + powf(p[2] - t * z, 2)));
+    }
+    return Simulator::instance->get_blocks();
+}
+
+TEST(KinematicSegments,only_where_needed)
+{
+    float deviation;
+    // a vertical move on a delta is straight for the arm solution
+    ASSERT_EQUALS_V(1, run_move(delta_config("mm_max_line_error 0.01\n"), 0, 0, -50, deviation));
+    ASSERT_TRUE(run_move(delta_config("delta_segments_per_second 100\n"), 0, 0, -50, deviation) >= 50);
+
+    // a move across the bed is not
+    int fixed= run_move(delta_config("delta_segments_per_second 100\n"), 80, 40, 0, deviation);
+    int adaptive= run_move(delta_config("mm_max_line_error 0.01\n"), 80, 40, 0, deviation);
+    ASSERT_TRUE(adaptive > 1);
+    ASSERT_TRUE(adaptive * 2 < fixed);
+    // within the error plus about a step
+    ASSERT_TRUE(deviation < 0.01F + 0.02F);
+
+    // mm_per_line_segment is the longest a segment can be
+    ASSERT_TRUE(run_move(delta_config("mm_max_line_error 0.01\nmm_per_line_segment 5\n"), 0, 0, -50, deviation) >= 10);
+}
+
+TEST(KinematicSegments,set_with_m665)
+{
+    Simulator::instance->boot(delta_config("delta_segments_per_second 100\n").c_str());
+    Simulator::instance->send_line("M665 V0.05");
+    Simulator::instance->send_line("G1 Z-50 F6000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(1, (int)Simulator::instance->get_blocks());
+}
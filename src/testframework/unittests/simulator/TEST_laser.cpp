@@ -0,0 +1,73 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+#include "Conveyor.h"
+#include "PublicData.h"
+#include "checksumm.h"
+#include "Laser.h"
+
+#include <string>
+
+#include "easyunit/test.h"
+
+#define laser_checksum CHECKSUM("laser")
+
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "laser_module_enable true\n"
+    "laser_module_pin 2.5\n";
+
+// runs the main loop until the given simulated time
+static void run_until(uint64_t tick)
+{
+    while(Simulator::instance->get_ticks() < tick && !THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+    }
+}
+
+static void run_ms(uint32_t ms)
+{
+    run_until(Simulator::instance->get_ticks() + ms * 100);
+}
+
+// a hold during a cut turns the laser off straight away and it comes back on with the speed when released
+TEST(Laser,off_while_held)
+{
+    const char *modes[]= { "", "step_segments_enable true\n", "step_events_enable true\n" };
+    for (const char *mode : modes) {
+        Simulator::instance->boot((std::string(config) + mode).c_str());
+        Laser *laser= nullptr;
+        ASSERT_TRUE(PublicData::get_value(laser_checksum, &laser) && laser != nullptr);
+
+        Simulator::instance->send_line("G1 X200 S1 F3000");
+        THECONVEYOR->force_queue();
+
+        // cruising at full speed, full power
+        run_ms(500);
+        ASSERT_EQUALS_DELTA_V(100.0F, laser->get_current_power(), 1.0F);
+
+        // off as soon as the hold starts slowing down
+        THEKERNEL->set_feed_hold(true);
+        run_ms(2);
+        ASSERT_TRUE(!THEKERNEL->step_ticker->is_held());
+        ASSERT_EQUALS_V(0.0F, laser->get_current_power());
+
+        // and stays off while stopped
+        while(!THEKERNEL->step_ticker->is_held()) run_ms(1);
+        run_ms(100);
+        ASSERT_EQUALS_V(0.0F, laser->get_current_power());
+
+        // 10ms after the release the head is at about a fifth of the speed, so is the power
+        THEKERNEL->set_feed_hold(false);
+        run_ms(10);
+        ASSERT_TRUE(laser->get_current_power() > 5.0F && laser->get_current_power() < 40.0F);
+
+        // and off once the move is done
+        Simulator::instance->finish();
+        Simulator::instance->advance(200);
+        ASSERT_EQUALS_V(0.0F, laser->get_current_power());
+    }
+}
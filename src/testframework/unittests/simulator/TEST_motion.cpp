@@ -0,0 +1,64 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+#include "easyunit/test.h"
+
+// default Robot settings are 80 steps/mm for X and Y, 100mm/sec² acceleration
+static const char *config=
+    "base_stepping_frequency 100000\n"
+    "acceleration 1000\n"
+    "junction_deviation 0.05\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "gamma_steps_per_mm 400\n";
+
+TEST(SimulatorMotion,single_move_steps)
+{
+    Simulator::instance->boot(config);
+
+    std::string reply;
+    Simulator::instance->send_line("G1 X10 F6000", &reply);
+    Simulator::instance->finish();
+
+    ASSERT_TRUE(reply.compare(0, 2, "ok") == 0);
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(2));
+    ASSERT_EQUALS_V(1, Simulator::instance->get_blocks());
+}
+
+TEST(SimulatorMotion,move_time)
+{
+    Simulator::instance->boot(config);
+
+    // 100mm at 100mm/sec with 1000mm/sec² takes 0.1s to accelerate and 0.1s to decelerate, 1.1s total
+    Simulator::instance->send_line("G1 X100 F6000");
+    Simulator::instance->finish();
+
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_DELTA_V(1.1F, Simulator::instance->get_ticks() / 100000.0F, 0.01F);
+}
+
+TEST(SimulatorMotion,multiple_moves_return_home)
+{
+    Simulator::instance->boot(config);
+
+    Simulator::instance->send_line("G1 X10 Y5 Z1 F3000");
+    Simulator::instance->send_line("G1 X20 Y-5");
+    Simulator::instance->send_line("G1 X0 Y0 Z0");
+    Simulator::instance->finish();
+
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(2));
+    ASSERT_EQUALS_V(3, Simulator::instance->get_blocks());
+    ASSERT_TRUE(THEKERNEL->conveyor->is_idle());
+}
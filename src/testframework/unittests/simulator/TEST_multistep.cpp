@@ -0,0 +1,76 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+#include "Block.h"
+#include "Conveyor.h"
+
+#include <string>
+
+#include "easyunit/test.h"
+
+// 1600 steps/mm at 200mm/s is 320000 steps/sec, more than three times the 100KHz step ticker
+static const char *single_config=
+    "acceleration 10000\n"
+    "alpha_steps_per_mm 1600\n";
+
+static const char *multi_config=
+    "acceleration 10000\n"
+    "alpha_steps_per_mm 1600\n"
+    "step_multiplier_max 4\n";
+
+// the multiplier used by the block the step ticker started on
+static int first_block_multiplier(const char *config, const char *move)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line(move);
+    THEKERNEL->conveyor->force_queue();
+    while(THEKERNEL->step_ticker->get_current_block() == nullptr) THEKERNEL->call_event(ON_IDLE);
+    int m= THEKERNEL->step_ticker->get_current_block()->step_multiplier;
+    Simulator::instance->finish();
+    return m;
+}
+
+TEST(MultiStep,multiplier_follows_rate)
+{
+    ASSERT_EQUALS_V(1, first_block_multiplier(single_config, "G1 X100 F12000"));
+    // 40000 steps/sec is below the step ticker frequency
+    ASSERT_EQUALS_V(1, first_block_multiplier(multi_config, "G1 X10 F1500"));
+    // 160000 steps/sec
+    ASSERT_EQUALS_V(2, first_block_multiplier(multi_config, "G1 X10 F6000"));
+    ASSERT_EQUALS_V(4, first_block_multiplier(multi_config, "G1 X100 F12000"));
+}
+
+TEST(MultiStep,reaches_higher_rate)
+{
+    Simulator::instance->boot(single_config);
+    Simulator::instance->send_line("G1 X100 F12000");
+    Simulator::instance->finish();
+    uint64_t single_ticks= Simulator::instance->get_ticks();
+    ASSERT_EQUALS_V(160000, Simulator::instance->get_steps(0));
+
+    Simulator::instance->boot(multi_config);
+    ASSERT_EQUALS_DELTA_V(400000.0F, THEKERNEL->step_ticker->get_max_step_rate(), 1.0F);
+    Simulator::instance->send_line("G1 X100 F12000");
+    Simulator::instance->finish();
+    uint64_t multi_ticks= Simulator::instance->get_ticks();
+
+    // every step is still issued, in about a third of the time
+    ASSERT_EQUALS_V(160000, Simulator::instance->get_steps(0));
+    ASSERT_TRUE(multi_ticks * 2 < single_ticks);
+
+    // and back to where it started with a remainder that is not a multiple of 4
+    Simulator::instance->send_line("G1 X0.0013 F12000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(2, Simulator::instance->get_steps(0));
+}
+
+TEST(MultiStep,limited_by_pulse_width)
+{
+    // 2us high and low for each pulse only fits two pulses in a 10us tick
+    Simulator::instance->boot("step_multiplier_max 4\nmicroseconds_per_step_pulse 2\n");
+    ASSERT_EQUALS_DELTA_V(200000.0F, THEKERNEL->step_ticker->get_max_step_rate(), 1.0F);
+
+    Simulator::instance->boot("step_multiplier_max 4\nmicroseconds_per_step_pulse 5\n");
+    ASSERT_EQUALS_DELTA_V(100000.0F, THEKERNEL->step_ticker->get_max_step_rate(), 1.0F);
+}
@@ -0,0 +1,82 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Conveyor.h"
+#include "StepTicker.h"
+#include "Block.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "base_stepping_frequency 100000\n"
+    "acceleration 1000\n"
+    "junction_deviation 0.05\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "gamma_steps_per_mm 400\n"
+    "planner_queue_size 64\n";
+
+TEST(Planner,short_segments_reach_full_speed)
+{
+    Simulator::instance->boot(config);
+
+    // 100 1mm segments on a line plan the same as one 100mm move, 1.1s
+    char buf[32];
+    for (int i = 1; i <= 100; ++i) {
+        snprintf(buf, sizeof(buf), "G1 X%d F6000", i);
+        Simulator::instance->send_line(buf);
+    }
+    Simulator::instance->finish();
+
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(100, Simulator::instance->get_blocks());
+    ASSERT_EQUALS_DELTA_V(1.1F, Simulator::instance->get_ticks() / 100000.0F, 0.011F);
+}
+
+TEST(Planner,reversals_stop_every_block)
+{
+    Simulator::instance->boot(config);
+
+    Simulator::instance->send_line("G1 X10 F6000");
+    Simulator::instance->finish();
+    uint64_t one_move = Simulator::instance->get_ticks();
+
+    // each reversal has to stop, so adding a block never speeds up the ones before it
+    Simulator::instance->boot(config);
+    for (int i = 0; i < 20; ++i) {
+        Simulator::instance->send_line((i & 1) ? "G1 X0" : "G1 X10 F6000");
+    }
+    Simulator::instance->finish();
+
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_DELTA_V(20.0F * one_move, (float)Simulator::instance->get_ticks(), 20.0F * one_move * 0.01F);
+}
+
+TEST(Planner,max_speed_ahead)
+{
+    Simulator::instance->boot(config);
+
+    const char *lines[]= { "G1 X10 F3000", "G1 Y10 F6000", "G1 X0 F1200", "G1 Y0 F2400", "G1 X10 F600", "G1 Y10 F600" };
+    for (const char *l : lines) Simulator::instance->send_line(l);
+    THECONVEYOR->force_queue();
+
+    // each block has the fastest speed from it to the end of the queue, that is all the step ticker looks at
+    std::vector<float> ahead;
+    const Block *last= nullptr;
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        const Block *b= THEKERNEL->step_ticker->get_current_block();
+        if(b != nullptr && b != last) ahead.push_back(b->max_speed_ahead);
+        last= b;
+    }
+
+    const float expected[]= { 100, 100, 40, 40, 10, 10 };
+    ASSERT_EQUALS_V(6, (int)ahead.size());
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_EQUALS_DELTA_V(expected[i], ahead[i], 0.001F);
+    }
+}
@@ -0,0 +1,132 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "StepTicker.h"
+#include "Conveyor.h"
+#include "RealtimeCommands.h"
+
+#include <math.h>
+#include <string>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "grbl_mode true\n"
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n";
+
+// runs the main loop until the given simulated time
+static void run_until(uint64_t tick)
+{
+    while(Simulator::instance->get_ticks() < tick && !THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+    }
+}
+
+// as the receive interrupt would
+static bool receive(uint8_t c)
+{
+    return THEKERNEL->realtime->receive(c);
+}
+
+TEST(Realtime,taken_out_of_the_stream)
+{
+    // none of them are realtime unless in grbl mode or with feed hold enabled, UTF-8 text goes through as it is
+    Simulator::instance->boot("");
+    ASSERT_TRUE(!receive('!'));
+    ASSERT_TRUE(!THEKERNEL->get_feed_hold());
+    ASSERT_TRUE(!receive(0x84));
+    ASSERT_TRUE(!THEKERNEL->get_feed_hold());
+    ASSERT_TRUE(!receive(0x92));
+    ASSERT_EQUALS_V(100, (int)THEKERNEL->realtime->get_feed_override());
+
+    Simulator::instance->boot(config);
+    ASSERT_TRUE(!receive('G'));
+    ASSERT_TRUE(!receive('\n'));
+    ASSERT_TRUE(receive('!'));
+    ASSERT_TRUE(THEKERNEL->get_feed_hold());
+    ASSERT_TRUE(receive('~'));
+    ASSERT_TRUE(!THEKERNEL->get_feed_hold());
+    ASSERT_TRUE(receive(0x91));
+    // the codes that mean nothing are left in the line
+    ASSERT_TRUE(!receive(0xA0));
+    ASSERT_TRUE(!receive(0xC3));
+
+    Simulator::instance->boot("enable_feed_hold true\n");
+    ASSERT_TRUE(receive(0x84));
+    ASSERT_TRUE(THEKERNEL->get_feed_hold());
+}
+
+TEST(Realtime,hold_and_resume_mid_move)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G1 X200 F6000");
+    THECONVEYOR->force_queue();
+    run_until(50000);
+
+    // nothing else gets a look in, the step ticker stops on its own
+    receive('!');
+    for (int i = 0; i < 20; ++i) Simulator::instance->advance(1000);
+    ASSERT_TRUE(THEKERNEL->step_ticker->is_held());
+    uint32_t held= THEROBOT->actuators[0]->get_current_step();
+    run_until(Simulator::instance->get_ticks() + 50000);
+    ASSERT_EQUALS_V(held, THEROBOT->actuators[0]->get_current_step());
+
+    receive('~');
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(16000, Simulator::instance->get_steps(0));
+}
+
+TEST(Realtime,feed_override_steps)
+{
+    Simulator::instance->boot(config);
+    // 10% at a time, slowing is straight away
+    for (int i = 0; i < 5; ++i) receive(0x92);
+    ASSERT_EQUALS_V(50, (int)THEKERNEL->realtime->get_feed_override());
+    for (int i = 0; i < 100; ++i) Simulator::instance->advance(1000);
+    ASSERT_EQUALS_DELTA_V(0.5F, THEKERNEL->step_ticker->get_speed_factor(), 0.001F);
+
+    // the robot catches up in on_idle
+    THEKERNEL->call_event(ON_IDLE);
+    ASSERT_EQUALS_DELTA_V(50.0F, THEROBOT->get_feed_override(), 0.001F);
+
+    // 1% steps, limited to 10% to 200%
+    receive(0x93);
+    ASSERT_EQUALS_V(51, (int)THEKERNEL->realtime->get_feed_override());
+    for (int i = 0; i < 30; ++i) receive(0x91);
+    ASSERT_EQUALS_V(200, (int)THEKERNEL->realtime->get_feed_override());
+    THEKERNEL->call_event(ON_IDLE);
+    ASSERT_EQUALS_DELTA_V(200.0F, THEROBOT->get_feed_override(), 0.001F);
+    receive(0x90);
+    ASSERT_EQUALS_V(100, (int)THEKERNEL->realtime->get_feed_override());
+
+    // M220 sets where the steps carry on from
+    Simulator::instance->send_line("M220 S70");
+    receive(0x91);
+    ASSERT_EQUALS_V(80, (int)THEKERNEL->realtime->get_feed_override());
+    THEKERNEL->call_event(ON_IDLE);
+    ASSERT_EQUALS_DELTA_V(80.0F, THEROBOT->get_feed_override(), 0.001F);
+}
+
+TEST(Realtime,rapid_override)
+{
+    // long enough to reach the seek rate
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G0 X100 F3000");
+    Simulator::instance->finish();
+    uint64_t full= Simulator::instance->get_ticks();
+
+    Simulator::instance->boot(config);
+    receive(0x97);
+    THEKERNEL->call_event(ON_IDLE);
+    Simulator::instance->send_line("G0 X100 F3000");
+    Simulator::instance->finish();
+    uint64_t quarter= Simulator::instance->get_ticks();
+
+    // 2s at 50mm/s against 8s at 12.5mm/s, the accelerations make a bit of difference
+    ASSERT_TRUE(quarter > full * 3.8F && quarter < full * 4.1F);
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+}
@@ -0,0 +1,123 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Block.h"
+#include "StepTicker.h"
+
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+#include "easyunit/test.h"
+
+static const char *trapezoid_config=
+    "base_stepping_frequency 100000\n"
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n";
+
+static const char *scurve_config=
+    "base_stepping_frequency 100000\n"
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "s_curve_jerk 100000\n";
+
+// run until the step ticker picks up a block, then run n more ticks and return the acceleration of motor 0
+static int64_t acceleration_after(uint32_t n)
+{
+    Simulator::instance->send_line("G1 X100 F6000");
+    Simulator::instance->ticks_per_idle= 1;
+    while(THEKERNEL->step_ticker->get_current_block() == nullptr) THEKERNEL->call_event(ON_IDLE);
+    Simulator::instance->ticks_per_idle= 10;
+    Simulator::instance->advance(n);
+    const Block *b= THEKERNEL->step_ticker->get_current_block();
+    int64_t acc= b == nullptr ? 0 : THEKERNEL->step_ticker->get_tick_info(0).acceleration_change;
+    Simulator::instance->finish();
+    return acc;
+}
+
+// run the moves tick by tick and return the largest acceleration of motor 0 either way
+static int64_t peak_acceleration(const char *line1, const char *line2= nullptr)
+{
+    Simulator::instance->send_line(line1);
+    if(line2 != nullptr) Simulator::instance->send_line(line2);
+    Simulator::instance->ticks_per_idle= 1;
+    while(THEKERNEL->step_ticker->get_current_block() == nullptr) THEKERNEL->call_event(ON_IDLE);
+    int64_t peak= 0;
+    for (int i = 0; i < 200000; ++i) {
+        Simulator::instance->tick();
+        const Block *b= THEKERNEL->step_ticker->get_current_block();
+        if(b == nullptr) continue;
+        int64_t acc= THEKERNEL->step_ticker->get_tick_info(0).acceleration_change;
+        if(acc < 0) acc= -acc;
+        if(acc > peak) peak= acc;
+    }
+    Simulator::instance->ticks_per_idle= 10;
+    Simulator::instance->finish();
+    return peak;
+}
+
+TEST(SCurve,same_steps_as_trapezoid_and_longer_by_the_jerk_ramp)
+{
+    Simulator::instance->boot(trapezoid_config);
+    Simulator::instance->send_line("G1 X100 F6000");
+    Simulator::instance->finish();
+    uint64_t trapezoid_ticks= Simulator::instance->get_ticks();
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+
+    Simulator::instance->boot(scurve_config);
+    Simulator::instance->send_line("G1 X100 F6000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+    // each phase takes the 10ms ramp at 100000mm/s³ to 1000mm/s² longer and the plateau is shorter by half of that,
+    // the S-curve creeps into the last step so it can finish a little early
+    ASSERT_TRUE(Simulator::instance->get_ticks() > trapezoid_ticks + 500);
+    ASSERT_TRUE(Simulator::instance->get_ticks() <= trapezoid_ticks + 1000);
+}
+
+TEST(SCurve,acceleration_ramps_up)
+{
+    Simulator::instance->boot(trapezoid_config);
+    int64_t trapezoid_acc= acceleration_after(10);
+    ASSERT_TRUE(trapezoid_acc > 0);
+
+    // the trapezoid applies full acceleration straight away, the S-curve starts from 0 and ramps up
+    Simulator::instance->boot(scurve_config);
+    int64_t scurve_acc= acceleration_after(10);
+    ASSERT_TRUE(scurve_acc > 0);
+    ASSERT_TRUE(scurve_acc < trapezoid_acc / 10);
+
+    // halfway through acceleration the S-curve holds at the acceleration, give or take the tick rounding
+    Simulator::instance->boot(scurve_config);
+    scurve_acc= acceleration_after(5000);
+    ASSERT_TRUE(scurve_acc < trapezoid_acc * 1.001);
+    ASSERT_TRUE(scurve_acc > trapezoid_acc * 0.99);
+}
+
+TEST(SCurve,peak_stays_within_the_acceleration)
+{
+    Simulator::instance->boot(trapezoid_config);
+    int64_t trapezoid_acc= acceleration_after(10);
+
+    // a long move, a move too short to reach the acceleration at the jerk and a short move entered fast enough that
+    // only the acceleration alone can stop it in time, the tick rounding is all that may go over
+    const char *moves[][2]= { {"G1 X100 F6000", nullptr}, {"G1 X2 F6000", nullptr}, {"G1 X50 F6000", "G1 X52 F6000"} };
+    for(auto& m : moves) {
+        Simulator::instance->boot(scurve_config);
+        int64_t peak= peak_acceleration(m[0], m[1]);
+        ASSERT_TRUE(peak > trapezoid_acc / 4);
+        ASSERT_TRUE(peak < trapezoid_acc * 1.001);
+    }
+}
+
+TEST(SCurve,set_jerk_with_m205)
+{
+    Simulator::instance->boot(trapezoid_config);
+    Simulator::instance->send_line("M205 J50000");
+    Simulator::instance->send_line("G1 X10 F6000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+
+    std::string reply;
+    Simulator::instance->send_line("M503", &reply);
+    ASSERT_TRUE(reply.find("J50000.0") != std::string::npos);
+}
@@ -0,0 +1,125 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Conveyor.h"
+#include "StepTicker.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Block.h"
+
+#include <string>
+#include <stdio.h>
+
+#include "easyunit/test.h"
+
+static const char *ticked_config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "gamma_steps_per_mm 400\n";
+
+static const char *segment_config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "gamma_steps_per_mm 400\n"
+    "step_segments_enable true\n"
+    "step_segment_time_ms 1\n";
+
+static const char *moves[]= {
+    "G1 X10 Y5 Z1 F3000",
+    "G1 X20 Y-5",
+    "G1 X25 Y-4.5 F6000",
+    "G1 X0 Y0 Z0",
+};
+
+static uint64_t run_moves(const char *config)
+{
+    Simulator::instance->boot(config);
+    for(auto m : moves) {
+        Simulator::instance->send_line(m);
+    }
+    Simulator::instance->finish();
+    return Simulator::instance->get_ticks();
+}
+
+TEST(Segments,mode_selected_by_config)
+{
+    Simulator::instance->boot(ticked_config);
+    ASSERT_TRUE(!THEKERNEL->step_ticker->is_segment_mode());
+
+    Simulator::instance->boot(segment_config);
+    ASSERT_TRUE(THEKERNEL->step_ticker->is_segment_mode());
+}
+
+TEST(Segments,move_time)
+{
+    Simulator::instance->boot(segment_config);
+
+    // 100mm at 100mm/sec with 1000mm/sec² takes 1.1s
+    Simulator::instance->send_line("G1 X100 F6000");
+    Simulator::instance->finish();
+
+    ASSERT_EQUALS_V(8000, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_DELTA_V(1.1F, Simulator::instance->get_ticks() / 100000.0F, 0.01F);
+    ASSERT_TRUE(!THEKERNEL->step_ticker->has_segments());
+}
+
+TEST(Segments,same_as_ticked)
+{
+    uint64_t ticked= run_moves(ticked_config);
+
+    uint64_t segmented= run_moves(segment_config);
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(2));
+    ASSERT_EQUALS_V(4, Simulator::instance->get_blocks());
+    ASSERT_TRUE(THEKERNEL->conveyor->is_idle());
+
+    // the last step of each block lands at the end of its final segment, slightly later than the ticked mode's
+    ASSERT_EQUALS_DELTA_V((float)ticked, (float)segmented, ticked * 0.01F);
+}
+
+TEST(Segments,current_block_is_the_one_stepping)
+{
+    // the blocks are prepared several segments ahead of the stepping, the laser has to see the one the motors are on
+    Simulator::instance->boot(segment_config);
+    Simulator::instance->send_line("G1 X10 F6000");
+    Simulator::instance->send_line("G1 Y10");
+    THECONVEYOR->force_queue();
+
+    int checked= 0;
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        const Block *b= THEKERNEL->step_ticker->get_current_block();
+        bool x= THEROBOT->actuators[0]->is_moving(), y= THEROBOT->actuators[1]->is_moving();
+        if(x == y) continue;
+        // still there, the conveyor has not cleared it
+        ASSERT_TRUE(b != nullptr && b->is_ready);
+        ASSERT_TRUE(x ? (b->steps[0] == 800 && b->steps[1] == 0) : (b->steps[0] == 0 && b->steps[1] == 800));
+        ++checked;
+    }
+    ASSERT_TRUE(checked > 100);
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_current_block() == nullptr);
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(1));
+}
+
+TEST(Segments,prepared_only_when_needed)
+{
+    Simulator::instance->boot(segment_config);
+
+    // nothing queued, nothing to prepare
+    Simulator::instance->advance(10000);
+    ASSERT_EQUALS_V(0, (int)Simulator::instance->get_pendsvs());
+
+    // about once per 1ms segment while moving, 1.1s
+    Simulator::instance->send_line("G1 X100 F6000");
+    Simulator::instance->finish();
+    ASSERT_TRUE(Simulator::instance->get_pendsvs() > 1000);
+    ASSERT_TRUE(Simulator::instance->get_pendsvs() < 1200);
+
+    // and none once it has stopped
+    Simulator::instance->reset_stats();
+    Simulator::instance->advance(10000);
+    ASSERT_EQUALS_V(0, (int)Simulator::instance->get_pendsvs());
+}
@@ -0,0 +1,103 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "StepTicker.h"
+#include "Conveyor.h"
+#include "InputShaper.h"
+
+#include <string>
+#include <math.h>
+
+#include "easyunit/test.h"
+
+#define PI 3.14159265358979323846F
+
+// a quick 10mm move on X, 1mm is 80 steps. At F3750 the acceleration lasts half the period of 40Hz which rings the most
+static const char *base_config=
+    "acceleration 5000\n"
+    "alpha_steps_per_mm 80\n"
+    "step_segments_enable true\n";
+
+// Moves X and drives an undamped oscillator at freq Hz with the motor position, returns how much it is still
+// ringing (in steps) once the move is over. This is the residual vibration the shaper is meant to cancel
+static float residual_vibration(const char *shaper, float freq, int &steps)
+{
+    std::string config(base_config);
+    config.append(shaper);
+    Simulator::instance->boot(config.c_str());
+    Simulator::instance->send_line("G1 X10 F3750");
+    THEKERNEL->conveyor->force_queue();
+
+    float w= 2 * PI * freq;
+    float dt= Simulator::instance->ticks_per_idle / THEKERNEL->step_ticker->get_frequency();
+    float x= 0, v= 0, u= 0;
+    uint32_t settle= 0;
+    // run until well after the move is done
+    while(settle < 2000) {
+        THEKERNEL->call_event(ON_IDLE);
+        u= Simulator::instance->get_steps(0);
+        v += -w * w * (x - u) * dt;
+        x += v * dt;
+        if(THEKERNEL->conveyor->is_idle()) ++settle;
+    }
+
+    steps= Simulator::instance->get_steps(0);
+    return sqrtf((x - u) * (x - u) + (v / w) * (v / w));
+}
+
+TEST(InputShaper,cancels_vibration_at_frequency)
+{
+    int steps;
+    float unshaped= residual_vibration("", 40, steps);
+    ASSERT_EQUALS_V(800, steps);
+    ASSERT_TRUE(unshaped > 5);
+
+    static const char *types[]= { "zv", "zvd", "mzv", "ei" };
+    for(auto t : types) {
+        std::string shaper("input_shaper_x_frequency 40\ninput_shaper_damping 0\ninput_shaper_type ");
+        shaper.append(t);
+        shaper.append("\n");
+        float shaped= residual_vibration(shaper.c_str(), 40, steps);
+        ASSERT_EQUALS_V(800, steps);
+        ASSERT_TRUE(shaped < unshaped * 0.1F);
+    }
+}
+
+TEST(InputShaper,set_with_m593)
+{
+    Simulator::instance->boot("input_shaper_type mzv\ninput_shaper_x_frequency 40\n");
+    ASSERT_TRUE(THEKERNEL->step_ticker->is_segment_mode());
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_input_shaper(0) != nullptr);
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_input_shaper(1) == nullptr);
+
+    Simulator::instance->send_line("M593 Y F55.5 D0.05");
+    const InputShaper *s= THEKERNEL->step_ticker->get_input_shaper(1);
+    ASSERT_TRUE(s != nullptr);
+    ASSERT_EQUALS_V(InputShaper::MZV, s->get_type());
+    ASSERT_EQUALS_DELTA_V(55.5F, s->get_frequency(), 0.001F);
+    ASSERT_EQUALS_DELTA_V(0.05F, s->get_damping(), 0.001F);
+    ASSERT_EQUALS_DELTA_V(40.0F, THEKERNEL->step_ticker->get_input_shaper(0)->get_frequency(), 0.001F);
+
+    // shaped moves still end up exactly where they were sent
+    Simulator::instance->send_line("G1 X10 Y-5 F6000");
+    Simulator::instance->send_line("G1 X3 Y2 F3000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(240, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(160, Simulator::instance->get_steps(1));
+
+    Simulator::instance->send_line("M593 F0");
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_input_shaper(0) == nullptr);
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_input_shaper(1) == nullptr);
+}
+
+TEST(InputShaper,cartesian_only)
+{
+    // the actuators of a corexy are not X and Y, shaping them on their own would bend the path
+    Simulator::instance->boot("arm_solution corexy\ninput_shaper_type mzv\ninput_shaper_x_frequency 40\n");
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_input_shaper(0) == nullptr);
+
+    std::string reply;
+    Simulator::instance->send_line("M593 X F40", &reply);
+    ASSERT_TRUE(reply.find("error:") != std::string::npos);
+    ASSERT_TRUE(THEKERNEL->step_ticker->get_input_shaper(0) == nullptr);
+}
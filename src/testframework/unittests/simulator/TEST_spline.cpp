@@ -0,0 +1,97 @@
+#include "Simulator.h"
+
+#include "Kernel.h"
+#include "Robot.h"
+#include "StepperMotor.h"
+#include "Conveyor.h"
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "easyunit/test.h"
+
+static const char *config=
+    "acceleration 1000\n"
+    "alpha_steps_per_mm 80\n"
+    "beta_steps_per_mm 80\n"
+    "mm_max_arc_error 0.01\n";
+
+// the cubic Bézier from 0,0 to 10,10 used below, close to a quarter circle of radius 10 about 10,0
+static const float c1[2]{0, 5.523F}, c2[2]{4.477F, 10}, p3[2]{10, 10};
+
+static float distance_to_curve(float x, float y)
+{
+    float best= 1e9F;
+    for (int i = 0; i <= 2000; ++i) {
+        float t= i / 2000.0F, u= 1 - t;
+        float bx= 3 * u * u * t * c1[0] + 3 * u * t * t * c2[0] + t * t * t * p3[0];
+        float by= 3 * u * u * t * c1[1] + 3 * u * t * t * c2[1] + t * t * t * p3[1];
+        best= fminf(best, hypotf(x - bx, y - by));
+    }
+    return best;
+}
+
+TEST(Spline,follows_the_curve)
+{
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G5 X10 Y10 I0 J5.523 P-5.523 Q0 F3000");
+
+    float deviation= 0;
+    THECONVEYOR->force_queue();
+    while(!THECONVEYOR->is_idle()) {
+        THEKERNEL->call_event(ON_IDLE);
+        deviation= fmaxf(deviation, distance_to_curve(THEROBOT->actuators[0]->get_current_position(), THEROBOT->actuators[1]->get_current_position()));
+    }
+
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(1));
+    // a chord error of 0.01 plus a step, about as many segments as the same arc (18)
+    ASSERT_TRUE(deviation < 0.01F + 0.0125F * 1.5F);
+    int blocks= Simulator::instance->get_blocks();
+    ASSERT_TRUE(blocks >= 12 && blocks <= 24);
+}
+
+TEST(Spline,tighter_curves_get_more_segments)
+{
+    // the same shape ten times smaller needs about sqrt(10) fewer segments not ten
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G5 X1 Y1 I0 J0.5523 P-0.5523 Q0 F3000");
+    Simulator::instance->finish();
+    int small= Simulator::instance->get_blocks();
+
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G5 X10 Y10 I0 J5.523 P-5.523 Q0 F3000");
+    Simulator::instance->finish();
+    int large= Simulator::instance->get_blocks();
+
+    ASSERT_TRUE(small > 2 && small * 2 < large && small * 5 > large);
+}
+
+TEST(Spline,quadratic_and_continued)
+{
+    // G5.1 ends at its target
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G5.1 X10 Y0 I5 J5 F3000");
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(800, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+    ASSERT_TRUE(Simulator::instance->get_blocks() > 4);
+
+    // a G5 without I J carries on from the last one
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G5 X10 Y10 I0 J5.523 P-5.523 Q0 F3000");
+    std::string reply;
+    Simulator::instance->send_line("G5 X20 Y0 P0 Q5.523", &reply);
+    ASSERT_TRUE(reply.find("Error") == std::string::npos);
+    Simulator::instance->finish();
+    ASSERT_EQUALS_V(1600, Simulator::instance->get_steps(0));
+    ASSERT_EQUALS_V(0, Simulator::instance->get_steps(1));
+
+    // but not from a line
+    Simulator::instance->boot(config);
+    Simulator::instance->send_line("G1 X1 F3000");
+    reply.clear();
+    Simulator::instance->send_line("G5 X20 Y0 P0 Q5.523", &reply);
+    ASSERT_TRUE(reply.find("G5 requires I and J") != std::string::npos);
+}
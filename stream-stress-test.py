@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+"""\
+Stress test fast-stream.py -c (character counting) against a stand-in of the Smoothie serial console on a PTY
+
+The stand-in takes the bytes as the receive interrupt does, into a receive buffer of the same size, and fails if the
+host ever sends more than fits. Its main loop runs one line at a time, taking a random time over each, and replies
+ok, so the host has to keep the buffer full without overrunning it. Every line has to arrive once and in order.
+
+needs pyserial, as fast-stream.py does
+"""
+
+from __future__ import print_function
+import sys
+import os
+import argparse
+import random
+import subprocess
+import tempfile
+import threading
+import time
+
+parser = argparse.ArgumentParser(description='Stress test character counting streaming against a PTY console.')
+parser.add_argument('-n','--lines',type=int, default=5000,
+        help='number of lines to stream')
+parser.add_argument('-s','--seed',type=int, default=1,
+        help='random seed, for the gcode and the timing')
+parser.add_argument('-r','--rx',type=int, default=254,
+        help='receive buffer the console reports, 254 is what the serial console has')
+parser.add_argument('-t','--timeout',type=float, default=120,
+        help='seconds before giving up on the host, it waits for ever for an ok to a line that was lost')
+args = parser.parse_args()
+
+random.seed(args.seed)
+
+
+class Console(object):
+    """as SerialConsole: a ring of rx + 1, the last place kept for the end of a line, ? taken out before it"""
+
+    def __init__(self, fd, rx):
+        self.fd= fd
+        self.rx= rx
+        self.buf= bytearray()
+        self.lines= []
+        self.peak= 0
+        self.overflow= None
+        self.running= True
+        self.lock= threading.Condition()
+        self.write_lock= threading.Lock()
+
+    def reply(self, s):
+        with self.write_lock:
+            os.write(self.fd, s.encode('ascii'))
+
+    def receive(self):
+        while self.running:
+            try:
+                data= bytearray(os.read(self.fd, 4096))
+            except OSError:
+                break
+            with self.lock:
+                for c in data:
+                    if c == ord('?'):
+                        self.reply("<Idle|MPos:0.0000,0.0000,0.0000|WPos:0.0000,0.0000,0.0000|Bf:15,%d>\n" % (self.rx - len(self.buf)))
+                        continue
+                    if len(self.buf) >= (self.rx + 1 if c == ord('\n') else self.rx):
+                        if self.overflow is None:
+                            self.overflow= "overflow after %d lines with %d bytes waiting" % (len(self.lines), len(self.buf))
+                        continue
+                    self.buf.append(c)
+                    self.peak= max(self.peak, len(self.buf))
+                self.lock.notify()
+
+    def main_loop(self):
+        while self.running:
+            with self.lock:
+                while self.running and b'\n' not in self.buf:
+                    self.lock.wait(0.1)
+                if not self.running:
+                    break
+                n= self.buf.index(b'\n')
+                line= bytes(self.buf[:n]).decode('ascii')
+                del self.buf[:n + 1]
+            # mostly short moves with the odd long one that lets the buffer fill up
+            time.sleep(random.random() * 0.001 if random.random() < 0.95 else 0.02)
+            self.lines.append(line)
+            self.reply("ok\n")
+
+
+# gcode of all lengths, with comments and blank lines that are not sent
+expected= []
+gcode= tempfile.NamedTemporaryFile(mode='w', suffix='.g', delete=False)
+for i in range(args.lines):
+    r= random.random()
+    if r < 0.05:
+        gcode.write("; comment %d\n" % i)
+        continue
+    if r < 0.07:
+        gcode.write("\n")
+        continue
+    l= "G1 X%.3f Y%.3f" % (random.uniform(-200, 200), random.uniform(-200, 200))
+    if random.random() < 0.2:
+        l += " Z%.4f E%.5f F%d" % (random.uniform(0, 10), random.uniform(0, 100), random.randint(100, 10000))
+    if random.random() < 0.05:
+        # long lines take up most of the buffer
+        l += " ".join(" S%.4f" % random.random() for j in range(random.randint(5, 15)))
+    expected.append(l)
+    gcode.write(l + (" ; the end" if random.random() < 0.1 else "") + "\n")
+gcode.close()
+
+master, slave= os.openpty()
+console= Console(master, args.rx)
+threads= [threading.Thread(target=console.receive), threading.Thread(target=console.main_loop)]
+for t in threads:
+    t.daemon= True
+    t.start()
+
+start= time.time()
+host= subprocess.Popen([sys.executable, os.path.join(os.path.dirname(os.path.abspath(__file__)), 'fast-stream.py'), '-c', '-q', gcode.name, os.ttyname(slave)],
+                       stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+watchdog= threading.Timer(args.timeout, host.kill)
+watchdog.start()
+out= host.communicate(b'\n')[0].decode('ascii', 'replace')
+watchdog.cancel()
+elapsed= time.time() - start
+
+console.running= False
+os.remove(gcode.name)
+
+failed= []
+if elapsed >= args.timeout:
+    failed.append("fast-stream.py did not finish in %1.0fs" % args.timeout)
+elif host.returncode != 0 or "halted" in out:
+    failed.append("fast-stream.py failed:\n" + out)
+if console.overflow is not None:
+    failed.append(console.overflow)
+if console.lines != expected:
+    n= next((i for i, (a, b) in enumerate(zip(console.lines, expected)) if a != b), min(len(console.lines), len(expected)))
+    failed.append("got %d lines of %d, first difference at line %d" % (len(console.lines), len(expected), n + 1))
+
+print("%d lines in %1.2fs, %1.0f lines/s, the receive buffer had up to %d of %d bytes in it" % (len(console.lines), elapsed, len(console.lines) / elapsed, console.peak, args.rx))
+if failed:
+    print("FAILED\n" + "\n".join(failed))
+    sys.exit(1)
+print("PASSED")